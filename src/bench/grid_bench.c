@@ -0,0 +1,246 @@
+/* grid_bench.c */
+
+/*
+Los Alamos National Security, LLC (LANS) owns the copyright to gridder,
+which it identifies internally as LA-CC-15-082. The license is BSD with
+a "modifications must be indicated" clause.
+See LICENSE.md for the full text.
+*/
+
+/************************************************************************/
+/*  Benchmark of grid generation and the output formats.               */
+/*									*/
+/*  Builds grids of 1e3, 1e4, ... elements up to a maximum (1e7 by      */
+/*  default) along x, in xy and in xyz, with equal, geometric and log   */
+/*  spacing, in every output format, and writes one JSON object per     */
+/*  grid: elements, nodes, bytes, seconds, nodes/s, elements/s, MB/s    */
+/*  and the peak resident set size.  Each grid is built in its own      */
+/*  process so the peak RSS is that of the grid alone.                  */
+/*									*/
+/*     gcc -O3 -DGRIDDER_LIB -I.. grid_bench.c ../gridder.c \           */
+/*         -lm -lpthread -o grid_bench                                  */
+/*     grid_bench [-t threads] [-m max_elems] [-o file] [-M]            */
+/*         > results.json                                               */
+/*									*/
+/*  The grids are written to file (grid_bench.tmp by default), which is */
+/*  removed at the end.  Put it on the file system to be measured;      */
+/*  1e9 elements in text formats needs tens of GB.  -M writes through   */
+/*  mmap() (spec.map) instead of stdio and pwrite().                    */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "gridder.h"
+
+static const char *output_name[] = { "", "avs", "tracer3d", "vectors",
+	"fehm", "avs_binary", "raw", "vtr", "vtu" };
+static const char *spacing_name[] = { "", "equal", "geometric", "log" };
+static const int spacing_option[] = { 0, SPACING_EQUAL, SPACING_GEOMETRIC,
+	SPACING_LOG_SMALL };
+static int use_map = 0;
+
+/* What a child process reports back about its grid. */
+struct bench_result {
+	int error;
+	long long nodes, elems, bytes;
+	double seconds;
+};
+
+static double seconds(void)
+   {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+   }
+
+/******************************************************************************/
+/* FUNCTION: bench_spec()						      */
+/* PURPOSE:  Sets up a grid_spec of about num_elems elements over the unit   */
+/*           cube: the same number of divisions along each axis used, in    */
+/*           one region with the given spacing.                              */
+/******************************************************************************/
+static int bench_spec(struct grid_spec *spec, int dims, long long num_elems,
+		int spacing, int output, int num_threads)
+   {
+	const char *axes;
+	int a, n;
+
+	gridder_spec_init(spec);
+	spec->num_dimensions = dims;
+	spec->output = output;
+	spec->num_threads = num_threads;
+	n = (int) floor(pow((double) num_elems, 1.0 / dims) + 0.5);
+	if (n < 1)
+		n = 1;
+
+	axes = gridder_axes(dims);
+	for (a=0; axes[a] != '\0'; a++)
+	   {
+		struct grid_axis_spec *axis = &spec->axis[axes[a] - 'x'];
+
+		if (gridder_spec_regions(spec, axes[a] - 'x', 1) != GRID_OK)
+			return GRID_ERR_MEMORY;
+		axis->begin = 0.0;
+		axis->region[0].end = 1.0;
+		axis->region[0].num_divisions = n;
+		axis->region[0].spacing = spacing_option[spacing];
+		axis->region[0].geom_factor = 1.0 + 1.0 / n;
+	   }
+	return gridder_check_spec(spec);
+   }
+
+/******************************************************************************/
+/* FUNCTION: bench_child()						      */
+/* PURPOSE:  Builds one grid into path and writes a bench_result to fd.      */
+/******************************************************************************/
+static void bench_child(int fd, const char *path, int dims,
+		long long num_elems, int spacing, int output, int num_threads)
+   {
+	struct bench_result r;
+	struct grid_spec spec;
+	struct stat st;
+	char piece[4096];
+	FILE *fp;
+	double t;
+	int p;
+
+	memset(&r, 0, sizeof(r));
+	r.error = bench_spec(&spec, dims, num_elems, spacing, output,
+		num_threads);
+	if (r.error == GRID_OK)
+		r.error = gridder_spec_size(&spec, &r.nodes, &r.elems);
+	spec.map = use_map;
+	spec.piece_name = path;
+	if ((r.error == GRID_OK) && ((fp = fopen(path, "w+")) == NULL))
+		r.error = GRID_ERR_IO;
+	if (r.error == GRID_OK)
+	   {
+		t = seconds();
+		r.error = gridder_build(&spec, fp);
+		if (fclose(fp) != 0)
+			r.error = GRID_ERR_IO;
+		r.seconds = seconds() - t;
+		if (stat(path, &st) == 0)
+			r.bytes = st.st_size;
+
+		/* VTK pieces, path_0.vtu ..., count with the .pvtu. */
+		for (p=0; ; p++)
+		   {
+			snprintf(piece, sizeof(piece), "%s_%d.vtu", path, p);
+			if (stat(piece, &st) != 0)
+				break;
+			r.bytes = r.bytes + st.st_size;
+			unlink(piece);
+		   }
+	   }
+	gridder_spec_free(&spec);
+	if (write(fd, &r, sizeof(r)) != sizeof(r))
+		_exit(1);
+	_exit(0);
+   }
+
+/******************************************************************************/
+/* FUNCTION: bench_one()						      */
+/* PURPOSE:  Runs one grid in a child process and prints its JSON object.   */
+/*           Returns 0, or 1 if the grid could not be built.                 */
+/******************************************************************************/
+static int bench_one(const char *path, int dims, long long num_elems,
+		int spacing, int output, int num_threads, int *first)
+   {
+	struct bench_result r;
+	struct rusage ru;
+	int fd[2], status;
+	pid_t pid;
+	double t;
+
+	if (pipe(fd) != 0)
+		return 1;
+	fflush(stdout);
+	pid = fork();
+	if (pid == 0)
+	   {
+		close(fd[0]);
+		bench_child(fd[1], path, dims, num_elems, spacing, output,
+			num_threads);
+	   }
+	close(fd[1]);
+	if ((pid < 0) || (read(fd[0], &r, sizeof(r)) != sizeof(r)))
+		r.error = GRID_ERR_IO;
+	close(fd[0]);
+	if ((pid > 0) && (wait4(pid, &status, 0, &ru) < 0))
+		memset(&ru, 0, sizeof(ru));
+
+	t = (r.seconds > 0) ? r.seconds : 1e-9;
+	printf("%s  {\"dimensions\": %d, \"spacing\": \"%s\", "
+		"\"output\": \"%s\", \"threads\": %d, \"map\": %d,\n", 
+		*first ? "" : ",\n", dims, spacing_name[spacing], 
+		output_name[output], num_threads, use_map);
+	if (r.error != GRID_OK)
+		printf("   \"error\": \"%s\"}", gridder_error_string(r.error));
+	else
+		printf("   \"nodes\": %lld, \"elements\": %lld, \"bytes\": %lld, "
+			"\"seconds\": %.6f,\n   \"nodes_per_s\": %.0f, "
+			"\"elements_per_s\": %.0f, \"mb_per_s\": %.3f, "
+			"\"peak_rss_kb\": %ld}", r.nodes, r.elems, r.bytes,
+			r.seconds, r.nodes / t, r.elems / t, r.bytes / t / 1e6,
+			(long) ru.ru_maxrss);
+	*first = 0;
+
+	fprintf(stderr, "%dd %-9s %-10s %12lld elements %10.3f s\n", dims,
+		spacing_name[spacing], output_name[output], r.elems, r.seconds);
+	return ((r.error != GRID_OK) && (r.error != GRID_ERR_TOO_LARGE));
+   }
+
+int main(int argc, char **argv)
+   {
+	const char *path = "grid_bench.tmp";
+	long long max_elems = 10000000, num_elems;
+	int num_threads = 1;
+	int dims, spacing, output, c, first = 1, fail = 0;
+
+	while ((c = getopt(argc, argv, "t:m:o:M")) != -1)
+	   {
+		switch (c)
+		   {
+			case 't':
+				num_threads = atoi(optarg);
+				break;
+			case 'm':
+				max_elems = (long long) atof(optarg);
+				break;
+			case 'o':
+				path = optarg;
+				break;
+			case 'M':
+				use_map = 1;
+				break;
+			default:
+				fprintf(stderr, "usage: grid_bench [-t threads] "
+					"[-m max_elems] [-o file] [-M]\n");
+				return 2;
+		   }
+	   }
+
+	printf("[\n");
+	for (num_elems=1000; num_elems <= max_elems; num_elems *= 10)
+		for (dims=1; dims <= 3; dims++)
+			for (spacing=1; spacing <= 3; spacing++)
+				for (output=OUTPUT_AVS; output <= OUTPUT_LAST;
+						output++)
+					fail |= bench_one(path, dims, num_elems,
+						spacing, output, num_threads,
+						&first);
+	printf("\n]\n");
+	unlink(path);
+	return fail;
+   }
@@ -0,0 +1,190 @@
+/* spacing_bench.c */
+
+/*
+Los Alamos National Security, LLC (LANS) owns the copyright to gridder,
+which it identifies internally as LA-CC-15-082. The license is BSD with
+a "modifications must be indicated" clause.
+See LICENSE.md for the full text.
+*/
+
+/************************************************************************/
+/*  Micro-benchmark of the spacing kernels in gridder.c.               */
+/*									*/
+/*  Fills one region with equal(), geom() and log_it() and with the     */
+/*  scalar libm formulas they replace, reports the time per node of     */
+/*  each and the largest difference in units in the last place (ULP)    */
+/*  of the region's END coordinate, and exits 1 if that is more than    */
+/*  GRID_VEC_ULP.                                                       */
+/*									*/
+/*     gcc -O3 -DGRIDDER_LIB -I.. spacing_bench.c ../gridder.c \        */
+/*         -lm -lpthread -o spacing_bench                               */
+/*     spacing_bench [divisions [repeats]]                              */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "gridder.h"
+
+/* Kernels in gridder.c. */
+void equal(int num_div, double begin, double end, double *x);
+void geom(int num_divisions, double geom_factor, double begin, double end,
+		double *x);
+void log_it(int num_div, double begin, double end, double *x,
+		int direction);
+
+/* The scalar formulas: one libm call per node. */
+static void equal_scalar(int n, double begin, double end, double *x)
+   {
+	double dx = (end - begin) / n;
+	int i;
+
+	for (i=0; i <= n; i++)
+		x[i] = (i * dx) + begin;
+   }
+
+static void geom_scalar(int n, double r, double begin, double end,
+		double *x)
+   {
+	double length = end - begin, lr = log(r);
+	int i;
+
+	x[0] = begin;
+	for (i=1; i < n; i++)
+	   {
+		if (r == 1.0)
+			x[i] = begin + length * ((double) i / n);
+		else if (r > 1.0)
+			x[i] = begin + length * (exp((i - n) * lr) *
+				(expm1(-i * lr) / expm1(-n * lr)));
+		else
+			x[i] = begin + length * (expm1(i * lr) / 
+				expm1(n * lr));
+	   }
+	x[n] = end;
+   }
+
+static void log_scalar(int n, double begin, double end, double *x,
+		int direction)
+   {
+	int i;
+
+	for (i=0; i <= n; i++)
+	   {
+		if (direction == 0)
+			x[i] = begin + (log10(1 + ((9.0/n) * i)) * (end - begin));
+		else
+			x[n - i] = end - (log10(1 + ((9.0/n) * i)) * (end - begin));
+	   }
+   }
+
+/* Difference of two coordinates in ULP of the larger end of the region */
+/* they are in, so a node near 0 is held to the same absolute accuracy   */
+/* as the rest of the region.                                            */
+static double ulps(double a, double b, double scale)
+   {
+	int e;
+
+	frexp(scale, &e);
+	return fabs(a - b) / ldexp(1.0, e - 53);
+   }
+
+static double seconds(void)
+   {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+   }
+
+/* Which kernel a case runs; r is the geometric factor. */
+struct bench_case {
+	const char *name;
+	int kind;		/* 0 equal, 1 geom, 2 log small, 3 log large */
+	double r;
+};
+
+static void run_kernel(const struct bench_case *c, int scalar, int n,
+		double *x)
+   {
+	switch (c->kind)
+	   {
+		case 0:
+			(scalar ? equal_scalar : equal)(n, 1.0, 11.0, x);
+			break;
+		case 1:
+			(scalar ? geom_scalar : geom)(n, c->r, 1.0, 11.0, x);
+			break;
+		default:
+			(scalar ? log_scalar : log_it)(n, 1.0, 11.0, x,
+				c->kind - 2);
+			break;
+	   }
+   }
+
+int main(int argc, char **argv)
+   {
+	static const struct bench_case cases[] = {
+		{"equal", 0, 1.0},
+		{"geom r=1.05", 1, 1.05},
+		{"geom r=0.95", 1, 0.95},
+		{"geom r=1+1e-9", 1, 1.0 + 1e-9},
+		{"log small-large", 2, 1.0},
+		{"log large-small", 3, 1.0},
+	};
+	int n = (argc > 1) ? atoi(argv[1]) : 1000000;
+	int repeats = (argc > 2) ? atoi(argv[2]) : 20;
+	double *x, *ref, t, t_vec, t_ref, worst, d;
+	int c, i, k, fail = 0;
+
+	if (n < 1 || repeats < 1)
+	   {
+		fprintf(stderr, "usage: spacing_bench [divisions [repeats]]\n");
+		return 2;
+	   }
+	x = malloc((n + 1) * sizeof(double));
+	ref = malloc((n + 1) * sizeof(double));
+	if (x == NULL || ref == NULL)
+	   {
+		fprintf(stderr, "spacing_bench: out of memory\n");
+		return 2;
+	   }
+
+	printf("%-18s %12s %12s %8s %6s\n", "kernel", "ns/node",
+		"scalar", "speedup", "ulp");
+	for (c=0; c < (int) (sizeof(cases) / sizeof(cases[0])); c++)
+	   {
+		t = seconds();
+		for (k=0; k < repeats; k++)
+			run_kernel(&cases[c], 0, n, x);
+		t_vec = (seconds() - t) / repeats;
+
+		t = seconds();
+		for (k=0; k < repeats; k++)
+			run_kernel(&cases[c], 1, n, ref);
+		t_ref = (seconds() - t) / repeats;
+
+		worst = 0;
+		for (i=0; i <= n; i++)
+		   {
+			d = ulps(x[i], ref[i], 11.0);
+			if (d > worst)
+				worst = d;
+		   }
+		if (worst > GRID_VEC_ULP)
+			fail = 1;
+
+		printf("%-18s %12.3f %12.3f %8.2f %6.1f\n", cases[c].name,
+			1e9 * t_vec / (n + 1), 1e9 * t_ref / (n + 1),
+			t_ref / t_vec, worst);
+	   }
+	if (fail)
+		printf("FAIL: more than %d ulp from the scalar formulas\n",
+			GRID_VEC_ULP);
+
+	free(x);
+	free(ref);
+	return fail;
+   }
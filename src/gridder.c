@@ -29,10 +29,9 @@ See LICENSE.md for the full text.
 /* in an axis, the number of divisions in a zone, and the geometric     */
 /* factor must be greater than 0.  					*/ 
 /*									*/
-/* The maximum number of nodes per axis is MAXNODES = 16385             */
-/* changed simply by changing the constant named MAXNODES, and the 	*/
-/* maximum number of zones per axis MAXZONES = 500, and limits may be 	*/
-/* changed simply by changing the constants MAXNODES and MAXZONES.      */      
+/* The coordinate and region arrays are allocated as large as each    */
+/* grid needs.  MAXNODES (nodes per axis) and MAXZONES (regions per    */
+/* axis and zones in a grid) only keep the counts inside an int.       */      
 /*									*/
 /* The results are then written to a file called grid.inp.  This        */
 /* file is rewritten upon every run of the program, so save the results */
@@ -48,6 +47,166 @@ See LICENSE.md for the full text.
 /* MODIFICATIONS:
  *
  */
+/********************************************************************/
+ /* Version 4
+ *
+ * October 18, 2026
+ * Separated the keyboard prompts from the grid engine.  A grid is
+ * described by a struct grid_spec (see gridder.h) and is built by
+ * gridder_build() without any prompts or printing, so the engine can
+ * be linked into other programs (compile with -DGRIDDER_LIB).
+ * main() and assign_grid_coords_and_elements() are now a front end
+ * that fills in the grid_spec from the keyboard or an input file.
+ *
+ * Node coordinates for AVS and FEHM are no longer written with one
+ * fprintf per node.  Each axis value is converted with %20.12g once,
+ * and the node lines are put together from those strings in a large
+ * output buffer.  The output is byte for byte the same.
+ *
+ * assign_elements() no longer walks every node to find the ones that
+ * start an element.  The nodes of element (i,j,k) are fixed offsets
+ * from its first node and its zone comes from the region of i, j and
+ * k along each axis, so whole rows are written without branching and
+ * any range of elements can be written on its own.
+ *
+ * The node and element sections can be written by several threads
+ * (gridder -t N, or grid_spec.num_threads).  The byte size of every
+ * chunk of records is worked out first from the digit counts, then
+ * each thread formats its chunks into its own buffer and writes them
+ * in place with pwrite().  If the output is a pipe the chunks are
+ * written in order instead.  The file is the same for any number of
+ * threads.  Link with -lpthread.
+ *
+ * Added binary outputs: 5 = AVS binary UCD and 6 = raw little-endian
+ * arrays (float64 coordinates, int64 connectivity, int32 zones) that
+ * a reader can mmap.  The layout of the raw file is in gridder.h.
+ *
+ * Node and element numbers and counts are 64 bit (long long), so grids
+ * with more than 2^31 nodes or elements are numbered correctly in every
+ * format.  gridder_spec_size() works out the size of a grid_spec from
+ * its divisions before anything is calculated; gridder_check_spec()
+ * uses it to reject axes over MAXNODES and grids too large for the
+ * 32 bit AVS binary format (GRID_ERR_TOO_LARGE).
+ *
+ * The fixed xcoords/ycoords/zcoords and region arrays are gone.  The
+ * regions of a grid_spec and the coordinates of a grid are allocated
+ * as they are needed (gridder_spec_regions(), gridder_grid_init()),
+ * and the number of divisions of a region is checked before anything
+ * is stored.  When a grid is too big the front end starts over in a
+ * loop instead of calling main() again.  MAXNODES and MAXZONES are
+ * now only there to keep counts inside an int.
+ *
+ * gridder_visit() hands a grid to a caller's struct grid_visitor in
+ * blocks of node coordinates, connectivity and zones, through the same
+ * code that writes the AVS and FEHM files, so a program can build its
+ * own mesh without writing and parsing a grid file.
+ *
+ * Geometric regions are solved in closed form.  The number of
+ * divisions for a smallest dx comes from the sum of the geometric
+ * series instead of subtracting one power at a time, and geom()
+ * calculates every node directly from (r^i - 1)/(r^n - 1) instead of
+ * adding up dx's, so the error no longer grows along the region and
+ * the last node is exactly END.
+ *
+ * The spacing kernels fill a region in batches with loops the
+ * compiler can vectorize.  log_it() takes its logarithms with
+ * vlog10(), and geom() needs exp()/expm1() once per GEOM_BLOCK nodes
+ * instead of for every node.  The nodes are within GRID_VEC_ULP of
+ * the one call per node formulas; bench/spacing_bench.c checks that
+ * and times the kernels.
+ *
+ * Zones are found from a table of region starts kept for each axis
+ * (struct grid region_start[]) instead of walking the region arrays
+ * in order.  gridder_zone() and gridder_zone_bounds() look a zone up
+ * directly, print_zone_bounds() uses them, and the connectivity finds
+ * the zone of any element on its own.  1-D grids along y or z
+ * (options 4 and 5) were given the x regions, which numbered every
+ * element as a new zone; they now use their own regions and the zones
+ * match the ones print_zone_bounds() lists.
+ *
+ * gridder -p prints a line with the records done, throughput and ETA
+ * every few seconds while a section is written, and a table of wall
+ * and CPU time, records and bytes of each phase (coordinates, nodes,
+ * zone bounds, connectivity) with the peak memory to stderr at the
+ * end.  gridder -j file writes the same table as JSON.  Library users
+ * get them by pointing spec.stats at a struct grid_stats.
+ *
+ * gridder -z [level] writes the grid gzipped, as grid.inp.gz.  The
+ * writers are unchanged: gridder_write() hands them a pipe, and
+ * threads cut what comes out into blocks, deflate them in parallel
+ * as separate gzip members and write the members in order.  Needs
+ * -DHAVE_ZLIB and -lz; without them spec.compress is an error
+ * (GRID_ERR_COMPRESS).
+ *
+ * gridder -o file and -r file choose where the grid and the copy of
+ * the input go, - for standard output, which sends the prompts to
+ * stderr.  grid.inp is no longer opened twice, and input.grid is
+ * created with O_EXCL so two runs cannot both decide to write it.
+ *
+ * gridder -b manifest builds a list of grids on the thread pool, each
+ * into its own file, and prints a table of the results.  The grids
+ * are described in the format of input.grid, which gridder_read_spec()
+ * reads.  gridder_batch() calculates each different axis only once
+ * and starts the biggest grids first.
+ *
+ * gridder -c dir (spec.cache) keeps axis coordinates and grid files in
+ * a cache directory under an FNV-1a hash of the spec they came from.
+ * gridder_axis_coords() reads an axis from it when it can, and
+ * gridder_write() copies a grid that is already there.
+ *
+ * gridder -m (spec.map) allocates each section of a regular grid file
+ * with posix_fallocate() and maps it, and the chunks are formatted
+ * directly into the mapping instead of a buffer that is then written.
+ *
+ * gridder -n (--dry-run) stops before the grid file is written and
+ * prints the nodes, elements, zones, elements per zone and the exact
+ * size of the grid in every output format.  gridder_dry_run() gets the
+ * sizes from the writers' own section sizes, which count the records
+ * past each decade or region instead of formatting them, into a stream
+ * that only counts, and calculates no coordinates.  gridder_zone_elems()
+ * counts the elements of a zone.
+ * With -b it prints the batch table without building anything.
+ *
+ * gridder -d [nodes|cells] (spec.data) adds AVS node data, the region
+ * of each node along each axis, and cell data, the zone and regions of
+ * each element, to the UCD file.  They are written as two more
+ * sections after the connectivity, a row of x at a time, so the ids
+ * LaGriT used to attach in a second pass over the mesh come with it.
+ *
+ * Output 7 writes a VTK XML RectilinearGrid (.vtr): the coordinates of
+ * each axis and the region of each element along it as raw appended
+ * data, so the file grows with nx+ny+nz instead of the number of
+ * cells.  With -d the zone of every cell is added as cell data.
+ *
+ * Output 8 writes binary VTK UnstructuredGrid pieces, one per slab of
+ * element layers along the last axis (-s pieces, one a thread by
+ * default), on the threads at once, and the grid file is the .pvtu
+ * that lists them.  The connectivity and zones of a piece are those of
+ * assign_elements() with the node numbers shifted to the piece.
+ *
+ * gridder -B px,py,pz [-g ghost] (spec.blocks, spec.ghost) cuts the
+ * grid into px*py*pz blocks for a distributed solver, with ghost
+ * layers of elements around each, and writes every block as a grid
+ * file of its own plus a map of its node and element numbers and
+ * owning blocks in the whole grid, a block to a thread.  A block is a
+ * struct grid pointing into the whole one, with the regions outside
+ * it left empty, so the existing writers number it from 1 and keep
+ * the zones of the whole grid.  The grid file lists the blocks.
+ *
+ * gridder -f [outside|material] (spec.zones) has the FEHM writer add
+ * name_outside.zone, a zonn macro of the six faces, and
+ * name_material.zone, a zone macro of the nodes of every zone.  Each
+ * zone is a box of node ranges taken from the region starts, written
+ * as a section, so a face costs its own nodes and nothing is scanned.
+ *
+ * gridder -S (spec.stor) has the FEHM writer add name.stor, the
+ * volumes, neighbor lists and area/distance coefficients of the
+ * 7-point stencil, worked out from the axis coordinates.  The entries
+ * before each row are counted in closed form, so every array is a
+ * section written on the threads and only the half spacings of the
+ * axes are kept in memory.
+ *
+ */
 /********************************************************************/
  /* Version 3
  *
@@ -142,6 +301,8 @@ See LICENSE.md for the full text.
  */
  /***********************************************************/
 
+/* fopencookie() for the counting stream of a dry run. */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <math.h>
 #include <sys/types.h>
@@ -149,19 +310,113 @@ See LICENSE.md for the full text.
 #include <fcntl.h>
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "gridder.h"
 
-#define MAXNODES 100000
-#define MAXZONES 1000
 #define ERR_LEVEL 3
 #define DEBUG 0
 
-double xcoords[MAXNODES]; 
-double ycoords[MAXNODES];
-double zcoords[MAXNODES];
-
+/* Where and how the grid file is written, and the coordinates. */
+/* If visitor is set the grid is handed to it instead of fp.     */
+struct grid_out {
+	FILE *fp;
+	int num_threads;
+	const double *coords[3];
+	const struct grid_visitor *visitor;
+	struct grid_stats *stats;
+		/* Phase timing, NULL for none. */
+	int map;
+		/* Write sections through mmap() when the file allows. */
+	int dry;
+		/* Skip over the sections instead, see gridder_dry_run(). */
+	int data;
+	const char *axes;
+		/* GRID_DATA_ flags and the axes used, for AVS data. */
+	int num_pieces;
+	const char *piece_name;
+		/* Slabs of OUTPUT_VTU and the name they are written to. */
+	const struct grid *whole;
+	int origin[3];
+		/* The grid a block is cut from and its node where the block */
+		/* starts, for the regions of the AVS data.                  */
+	int phase;
+	long long bytes;
+		/* Bytes written by sections in the phase. */
+	off_t phase_start;
+		/* File position at the start of the phase. */
+};
+
+/* Compresses the grid file as it is written, see grid_gzip_open(). */
+struct grid_gzip;
+static int grid_gzip_open(struct grid_gzip **gz, FILE **fp_out, 
+		int num_threads, int level);
+static int grid_gzip_close(struct grid_gzip *gz);
+
+/* Writes a grid, gridder_write() without the cache.  With dry set the */
+/* sections are skipped over instead, see gridder_dry_run().           */
+static int grid_write(const struct grid *grid, const struct grid_spec *spec,
+		FILE *fp_out, int dry);
+
+/* Writes grid, a block of whole starting at node origin of it. */
+static int grid_write_part(const struct grid *grid, const struct grid *whole,
+		const int origin[3], const struct grid_spec *spec, 
+		FILE *fp_out, int dry);
+
+/* Writes the FEHM zone files of spec->zones next to the grid file. */
+static int write_fehm_zones(const struct grid *grid, 
+		const struct grid_spec *spec, const struct grid_out *out);
+
+/* Writes the FEHM .stor file of spec->stor next to the grid file. */
+static int write_fehm_stor(const struct grid *grid, 
+		const struct grid_spec *spec, const struct grid_out *out);
+
+/* Writes the blocks of spec->blocks and lists them in fp_out. */
+static int spec_num_blocks(const struct grid_spec *spec);
+static int write_blocks(const struct grid *grid, const struct grid_spec *spec,
+		FILE *fp_out, int dry);
+
+/* Look axes and grid files up in the cache directory spec->cache. */
+static int cache_axis_load(struct grid *grid, const struct grid_spec *spec, 
+		int axis);
+static void cache_axis_store(const struct grid *grid, 
+		const struct grid_spec *spec, int axis);
+static int cache_grid_write(const struct grid *grid, 
+		const struct grid_spec *spec, FILE *fp_out);
+
+/* Makes room for the nodes and regions of an axis. */
+static int grid_reserve(struct grid *grid, int axis, int num_nodes, 
+		int num_regions);
+
+/* Reads a clock in seconds. */
+static double stats_clock(clockid_t clock);
+
+/* Starts and ends a timed phase of writing a grid. */
+static void out_phase_begin(struct grid_out *out, int phase);
+static void out_phase_end(struct grid_out *out, long long records);
+static int out_skip(struct grid_out *out, long long bytes);
+
+/* Calculates the nodes of region r of an axis, see gridder_axis_coords(). */
+static int add_region_nodes(struct grid *grid, int axis, int r, 
+		const struct grid_region *region, double begin, int num_nodes);
+
+/* Empties a grid but keeps its arrays. */
+static int grid_reset(struct grid *grid);
 
 /* primary function is assign_grid_coords_and_elements()
    the remaining functions are called by it.
+   The prompts are in assign_grid_coords_and_elements(), 
+   assign_axis_coords() and assign_region_coords(), everything 
+   else is the engine declared in gridder.h.
 */
 
 #ifndef PROTO 
@@ -172,58 +427,84 @@ int assign_grid_coords_and_elements();
 /*  Returns number of nodes in axis. */
 int assign_axis_coords();
 
-/*  Returns number of nodes in zone. */
-int assign_region_coords(); 
+/*  Reads the values for a region. */
+void assign_region_coords(); 
 
-/*  The following functions are called by assign_region_coords()   */
+/*  Builds the grids of a batch manifest. */
+int run_batch();
+
+/*  Prints the sizes of a grid for a dry run. */
+int print_grid_size();
+
+/*  Names the VTK pieces, blocks or zone files after the grid file. */
+void vtu_piece_name();
+
+/*  The following functions are called by gridder_region_coords()   */
 void geom(); 
 void log_it(); 
 void equal(); 
 void print_spacing_info();
-void print_avs_coords();
-void print_fehm_coords();
+int print_avs_coords();
+int print_fehm_coords();
+int print_binary_coords();
+int print_avs_binary_header();
+int print_raw_header();
+int print_vtr_header();
 void print_tracer_coords();
 void print_vectors_coords();
 void print_zone_bounds(); 
-void assign_elements();
-void assign_elements_helper();
+int assign_elements();
+int assign_elements_helper();
 
 #else
 
-int assign_grid_coords_and_elements(FILE *fp_out, FILE *fp_in); 
+int assign_grid_coords_and_elements(FILE *fp_out, FILE *fp_in,
+               struct grid_spec *spec); 
+
+int assign_axis_coords(struct grid *grid, struct grid_spec *spec, 
+               int axis_num, char axis, FILE *fp_in);	
 
-int assign_axis_coords(double *ptr, char axis, int *num_elems_per_region,
-               int *num_axis_region, FILE *fp_in);	
+void assign_region_coords(struct grid_region *region, double *begin,
+               int region_num, char axis, FILE *fp_in);
 
-int assign_region_coords(double **ptr1, int region_num, char axis, 
-               int *num_elems_per_region, FILE *fp_in);
+int run_batch(const char *manifest, const struct grid_spec *spec, 
+               int dry_run);
 
-void geom(int region_num, char axis, int num_divisions, 
-                double begin, double end, double **x, FILE *fp_in);
+int print_grid_size(struct grid *grid, const struct grid_spec *spec);
+
+void vtu_piece_name(const char *path, char *name, size_t size);
+
+void geom(int num_divisions, double geom_factor, 
+                double begin, double end, double *x);
 void log_it(int num_divisions, double begin, double end, 
-                double **x, int direction);
+                double *x, int direction);
 void equal(int num_divisions, double begin, double end, 
-                double **x, FILE *fp_in);
+                double *x);
 void print_spacing_info(void);
-void print_avs_coords(int num_xnodes, int num_ynodes, int num_znodes,
-                int num_elems, FILE *fp_out);
-void print_fehm_coords(int num_xnodes, int num_ynodes, int num_znodes,
-                int num_elems, int num_dimensions, FILE *fp_out);
+int print_avs_coords(int num_xnodes, int num_ynodes, int num_znodes,
+                long long num_elems, struct grid_out *out);
+int print_fehm_coords(int num_xnodes, int num_ynodes, int num_znodes,
+                long long num_elems, int num_dimensions, struct grid_out *out);
+int print_binary_coords(int num_xnodes, int num_ynodes, int num_znodes,
+                int axis, struct grid_out *out);
+int print_avs_binary_header(long long num_nodes, long long num_elems,
+                int num_dimensions, FILE *fp_out);
+int print_raw_header(long long num_nodes, long long num_elems,
+                int num_dimensions, FILE *fp_out);
+int print_vtr_header(const struct grid *grid, struct grid_out *out);
 void print_vectors_coords(int num_xnodes, int num_ynodes, int num_znodes,
-                int num_elems, FILE *fp_out);
+                struct grid_out *out);
 void print_tracer_coords(int num_xnodes, int num_ynodes, int num_znodes,
-                FILE *fp_out);
-void print_zone_bounds(int num_xregions,int num_yregions, int 
-                num_zregions, int *num_xelems, int *num_yelems, 
-                int *num_zelems);
-void assign_elements(int num_xnodes, int num_ynodes, int num_znodes,
-                int *num_xelems, int*num_yelems, int *zelems,
-                int num_xregions, int num_yregions, int num_dimensions,
-                int output, FILE *fp_out);
-void assign_elements_helper(int num_xnodes, int num_ynodes, int num_znodes,
-                int *num_xelems, int*num_yelems, int *zelems,
-                int num_xregions, int num_yregions, int num_dimensions,
-                int output, FILE *fp_out);
+                struct grid_out *out);
+void print_zone_bounds(const struct grid *grid);
+int assign_elements(int num_xnodes, int num_ynodes, int num_znodes,
+                int *xstart, int *ystart, int *zstart,
+                int num_xregions, int num_yregions, int num_zregions,
+                int num_dimensions, int output, struct grid_out *out);
+int assign_elements_helper(int num_xnodes, int num_ynodes, int num_znodes,
+                int *xstart, int *ystart, int *zstart,
+                int num_xregions, int num_yregions, int num_zregions,
+                int num_dimensions, int output, struct grid_out *out);
 
 #endif //PROTO
 
@@ -232,40 +513,235 @@ void assign_elements_helper(int num_xnodes, int num_ynodes, int num_znodes,
 *	
 ******************************************************************************/
 
-main()
+#ifndef GRIDDER_LIB
+int main(int argc, char *argv[])
 {
     FILE *fp_out, *fp_in;
-    int error, file_exist;
-    char filename[12];
-
+    int error, file_exist, fd;
+    const char *filename = "input.grid";
+    const char *grid_file = NULL;
+    const char *replay_file = NULL;
+    const char *batch_file = NULL;
+    int dry_run = 0;
+    struct stat st;
+    static char piece_name[4096];
+
+    /* Options from the command line, the rest of the */
+    /* grid description is read from the keyboard.    */
+    static struct grid_spec spec;
+    static struct grid_stats stats;
+    int i, print_stats = 0;
+    const char *stats_file = NULL;
+    FILE *fp_stats;
+
+    gridder_spec_init(&spec);
+    gridder_stats_init(&stats);
+    for (i=1; i < argc; i++)
+    {
+	if ((strcmp(argv[i], "-t") == 0) && (i + 1 < argc))
+	    spec.num_threads = atoi(argv[++i]);
+	else if (strcmp(argv[i], "-p") == 0)
+	{
+	    /* Progress lines and a table of the phases on stderr. */
+	    print_stats = 1;
+	    stats.progress = stderr;
+	    spec.stats = &stats;
+	}
+	else if ((strcmp(argv[i], "-j") == 0) && (i + 1 < argc))
+	{
+	    /* The phases as JSON. */
+	    stats_file = argv[++i];
+	    spec.stats = &stats;
+	}
+	else if (strcmp(argv[i], "-z") == 0)
+	{
+	    /* gzip the grid, at the level given or 6. */
+	    spec.compress = 6;
+	    if ((i + 1 < argc) && (argv[i+1][0] >= '1') && 
+		(argv[i+1][0] <= '9') && (argv[i+1][1] == '\0'))
+		spec.compress = argv[++i][0] - '0';
+	}
+	else if ((strcmp(argv[i], "-o") == 0) && (i + 1 < argc))
+	    grid_file = argv[++i];
+	else if ((strcmp(argv[i], "-r") == 0) && (i + 1 < argc))
+	    replay_file = argv[++i];
+	else if ((strcmp(argv[i], "-b") == 0) && (i + 1 < argc))
+	    batch_file = argv[++i];
+	else if (strcmp(argv[i], "-m") == 0)
+	    spec.map = 1;
+	else if ((strcmp(argv[i], "-s") == 0) && (i + 1 < argc))
+	    spec.num_pieces = atoi(argv[++i]);
+	else if ((strcmp(argv[i], "-B") == 0) && (i + 1 < argc))
+	{
+	    /* Blocks along x, y and z, e.g. 4,2,1; missing ones are 1. */
+	    spec.blocks[0] = spec.blocks[1] = spec.blocks[2] = 1;
+	    sscanf(argv[++i], "%d,%d,%d", &spec.blocks[0], &spec.blocks[1],
+		   &spec.blocks[2]);
+	}
+	else if ((strcmp(argv[i], "-g") == 0) && (i + 1 < argc))
+	    spec.ghost = atoi(argv[++i]);
+	else if (strcmp(argv[i], "-f") == 0)
+	{
+	    /* FEHM outside and material zone files, or the one given. */
+	    spec.zones = GRID_ZONES_OUTSIDE | GRID_ZONES_MATERIAL;
+	    if ((i + 1 < argc) && (strcmp(argv[i+1], "outside") == 0))
+	    {
+		spec.zones = GRID_ZONES_OUTSIDE;
+		i++;
+	    }
+	    else if ((i + 1 < argc) && (strcmp(argv[i+1], "material") == 0))
+	    {
+		spec.zones = GRID_ZONES_MATERIAL;
+		i++;
+	    }
+	}
+	else if (strcmp(argv[i], "-S") == 0)
+	    spec.stor = 1;
+	else if (strcmp(argv[i], "-d") == 0)
+	{
+	    /* AVS node and cell data, or only the one given. */
+	    spec.data = GRID_DATA_NODES | GRID_DATA_CELLS;
+	    if ((i + 1 < argc) && (strcmp(argv[i+1], "nodes") == 0))
+	    {
+		spec.data = GRID_DATA_NODES;
+		i++;
+	    }
+	    else if ((i + 1 < argc) && (strcmp(argv[i+1], "cells") == 0))
+	    {
+		spec.data = GRID_DATA_CELLS;
+		i++;
+	    }
+	}
+	else if ((strcmp(argv[i], "-n") == 0) || 
+		 (strcmp(argv[i], "--dry-run") == 0))
+	    dry_run = 1;
+	else if ((strcmp(argv[i], "-c") == 0) && (i + 1 < argc))
+	{
+	    /* Keep axes and grid files in a cache directory. */
+	    spec.cache = argv[++i];
+	}
+	else
+	{
+	    printf("Usage: gridder [-t threads] [-p] [-j stats.json] ");
+	    printf("[-z [level]] [-c cache] [-m] [-n]\n");
+	    printf("               [-d [nodes|cells]] [-s pieces] ");
+	    printf("[-B px,py,pz [-g ghost]]\n");
+	    printf("               [-f [outside|material]] [-S] ");
+	    printf("[-o grid file] [-r replay file] [< input file]\n");
+	    printf("       gridder -b manifest [-t threads] [-z [level]] ");
+	    printf("[-c cache] [-m] [-n] [-d [nodes|cells]]\n");
+	    printf("               [-s pieces] [-B px,py,pz [-g ghost]] ");
+	    printf("[-f [outside|material]] [-S]\n");
+	    printf("-n or --dry-run prints the sizes instead of writing.\n");
+	    printf("A file of - is standard output.\n");
+	    exit(1);
+	}
+    }
+    if (spec.num_threads < 1)
+	spec.num_threads = 1;
+    /* A dry run writes nothing, not even the cache. */
+    if ((spec.cache != NULL) && !dry_run && 
+	(mkdir(spec.cache, 0777) != 0) && (errno != EEXIST))
+	printf("Could not make cache directory '%s'.\n", spec.cache);
+    if (batch_file != NULL)
+	exit(run_batch(batch_file, &spec, dry_run));
+    if (grid_file == NULL)
+	grid_file = (spec.compress > 0) ? "grid.inp.gz" : "grid.inp";
+    vtu_piece_name(grid_file, piece_name, sizeof(piece_name));
+    spec.piece_name = piece_name;
+    if ((replay_file != NULL) && (strcmp(grid_file, "-") == 0) && 
+	(strcmp(replay_file, "-") == 0))
+    {
+	printf("The grid and the replay record cannot both go to ");
+	printf("standard output.\n");
+	exit(1);
+    }
 
-    fp_out = fopen("grid.inp", "w");
+    /* A grid or replay record on standard output gets its own copy */
+    /* of it, and the prompts and messages go to stderr instead.     */
+    fd = -1;
+    if ((strcmp(grid_file, "-") == 0) || 
+	((replay_file != NULL) && (strcmp(replay_file, "-") == 0)))
+    {
+	fflush(stdout);
+	if (((fd = dup(1)) < 0) || (dup2(2, 1) < 0))
+	{
+	    fprintf(stderr, "Could not redirect standard output.\n");
+	    exit(1);
+	}
+    }
 
-    if ((fp_out = fopen("grid.inp", "w")) == NULL)
-	printf ("Could not open new output file 'grid.inp.'\n");
+    if (dry_run)
+	fp_out = NULL;
+    else if (strcmp(grid_file, "-") == 0)
+    {
+	fp_out = fdopen(fd, "w");
+	grid_file = "standard output";
+    }
+    else
+	fp_out = fopen(grid_file, spec.map ? "w+" : "w");
+    if ((fp_out == NULL) && !dry_run)
+    {
+	printf ("Could not open new output file '%s'.\n", grid_file);
+	exit(1);
+    }
 
-    /* Check to see if input.grid already exists
-       0 means does not exist, -1 means file does not exist */
-    file_exist = open("./input.grid", O_RDONLY);
-    if (file_exist != -1) 
+    /* Without -r the copy of the input goes to input.grid, or to   */
+    /* input.tmp if there already is one.  input.grid is created    */
+    /* with O_EXCL so that of two runs starting together only one   */
+    /* takes it.                                                    */
+    file_exist = -1;
+    if (replay_file != NULL)
+    {
+	filename = replay_file;
+	if (strcmp(replay_file, "-") == 0)
+	{
+	    fp_in = fdopen(fd, "w");
+	    filename = "standard output";
+	}
+	else
+	    fp_in = fopen(replay_file, "w");
+    }
+    else if ((fd = open("input.grid", O_WRONLY | O_CREAT | O_EXCL, 0666)) 
+	     >= 0)
+	fp_in = fdopen(fd, "w");
+    else if (errno == EEXIST)
     {
+	file_exist = 0;
         printf("File input.grid already exists.\n");
-        strcpy(filename, "input.tmp");
+        filename = "input.tmp";
         printf("File %s will be written instead.\n\n", filename);
+	fp_in = fopen(filename, "w");
     }
-    else {
-        strcpy(filename, "input.grid");
-    }
+    else
+	fp_in = NULL;
 
-    /* Open the output file */
-    if ((fp_in = fopen(filename, "w")) == NULL)
+    if (fp_in == NULL)
     {
-	printf ("Could not open new file 'input.grid' for copy "); 
+	printf ("Could not open new file '%s' for copy ", filename); 
 	printf ("of input parameters.\n");
     }
     else
     {
-	error = assign_grid_coords_and_elements(fp_out, fp_in);
+	/* 0 means the grid was too big and the user starts over, */
+	/* with a fresh copy of the input parameters.             */
+	/* A replay record that is not a file (a pipe or a terminal)  */
+	/* keeps the input that was started over: replaying it starts  */
+	/* over in the same place.                                     */
+	while ((error = assign_grid_coords_and_elements(fp_out, fp_in, 
+			&spec)) == 0)
+	{
+	    if (feof(stdin))
+		exit(2);
+	    fflush(fp_in);
+	    if ((fstat(fileno(fp_in), &st) == 0) && S_ISREG(st.st_mode) &&
+		(ftruncate(fileno(fp_in), 0) != 0))
+	    {
+		printf("Could not start '%s' over.\n", filename);
+		exit(2);
+	    }
+	    rewind(fp_in);
+	}
         if (error == -1) {
            exit(0); 
 	}
@@ -273,19 +749,51 @@ main()
 	printf("\nProgram gridder has completed.\n");
 	printf("The following files have been written:\n\n");
 
+	if (!dry_run && (error != 8) && ((spec.blocks[0] > 1) || 
+	    (spec.blocks[1] > 1) || (spec.blocks[2] > 1))) {
+	  printf("%-12s lists the blocks %s_*%s and their id maps %s_*.map.\n", grid_file, spec.piece_name, gridder_extension(spec.output), spec.piece_name);
+	}
+	else if (!dry_run) {
 	if (error == 1) {
-	  printf("grid.inp     contains coordinate & connectivity in AVS format.\n");
+	  printf("%-12s contains coordinate & connectivity in AVS format.\n", grid_file);
 	}
 	if (error == 2) {
-	  printf("grid.inp     contains coordinate data in TRACER3D format.\n");
+	  printf("%-12s contains coordinate data in TRACER3D format.\n", grid_file);
 	}
 	if (error == 3) {
-	  printf("grid.inp     contains coordinate data in VECTORS format.\n");
+	  printf("%-12s contains coordinate data in VECTORS format.\n", grid_file);
 	}
 	if (error == 4) {
-	  printf("grid.inp     contains coordinate data in FEHM format.\n");
+	  printf("%-12s contains coordinate data in FEHM format.\n", grid_file);
 	}
-
+	if (error == 5) {
+	  printf("%-12s contains coordinate & connectivity in AVS binary UCD format.\n", grid_file);
+	}
+	if (error == 6) {
+	  printf("%-12s contains coordinate & connectivity as raw binary arrays.\n", grid_file);
+	}
+	if (error == 7) {
+	  printf("%-12s contains the axes as a VTK RectilinearGrid (.vtr).\n", grid_file);
+	}
+	if (error == 8) {
+	  printf("%-12s lists the VTK UnstructuredGrid pieces %s_*.vtu.\n", grid_file, spec.piece_name);
+	}
+	if ((spec.compress > 0) && (error != 8))
+	  printf("             It is gzipped.\n");
+	}
+	if (!dry_run && (error == 4) && (spec.zones & GRID_ZONES_OUTSIDE))
+	  printf("%s%s contains the faces of the grid as FEHM zonn macros.\n", spec.piece_name, "_outside.zone");
+	if (!dry_run && (error == 4) && (spec.zones & GRID_ZONES_MATERIAL))
+	  printf("%s%s contains the nodes of each zone as FEHM zone macros.\n", spec.piece_name, "_material.zone");
+	if (!dry_run && (error == 4) && spec.stor)
+	  printf("%s%s contains the FEHM sparse matrix of the grid.\n", spec.piece_name, ".stor");
+
+	if (replay_file != NULL) {
+	  printf("%-12s contains input values you have generated during this run.\n", filename);
+	  printf("To repeat this run:\n");
+	  printf("   gridder < %s\n\n", filename);
+	}
+	else {
 	if (file_exist != -1) 
 	  printf("input.tmp    contains input values you have generated during this run.\n");
 	else
@@ -295,11 +803,24 @@ main()
 	if (file_exist != -1) 
 	  printf("   cp input.tmp input.grid\n");
 	  printf("   gridder < input.grid\n\n"); 
+	}
 	
+	if (print_stats)
+	  gridder_stats_print(&stats, stderr);
+	if (stats_file != NULL)
+	{
+	  if (((fp_stats = fopen(stats_file, "w")) == NULL) ||
+	      (gridder_stats_json(&stats, fp_stats) != GRID_OK))
+	    printf("Could not write '%s'.\n", stats_file);
+	  if (fp_stats != NULL)
+	    fclose(fp_stats);
+	}
     }
 
-   fclose (fp_out);
-   fclose (fp_in);
+   if ((fp_out != NULL) && (fclose (fp_out) != 0))
+      exit(2);
+   if (fp_in != NULL)
+      fclose (fp_in);
    exit(0);
 }
 /* End Main */
@@ -311,42 +832,24 @@ main()
 /*****************************************************************************
 * FUNCTION: assign_grid_coords_and_elements		
 *                                                       
-* PURPOSE: Assigns all grid coordinates and connectivity.
+* PURPOSE: Reads the grid description from the keyboard into a grid_spec,
+*          then assigns all grid coordinates and connectivity.
 *****************************************************************************/
 
-int assign_grid_coords_and_elements(fp_out, fp_in)
+int assign_grid_coords_and_elements(fp_out, fp_in, spec)
 FILE *fp_out; 
 FILE *fp_in;
+struct grid_spec *spec;
   {
-        /* Store coordinates in each axis. */
-	extern double xcoords[], ycoords[], zcoords[];
-
-	/* Pointers to coordinate arrays 
-           to be passed to following functions. */
-	//double *xptr = xcoords, *yptr = ycoords, *zptr = zcoords;
-	double *coords_ptr;
-
-	/* Store number of elements in each zone in each axis. */
-	int num_xelems[MAXZONES], num_yelems[MAXZONES], num_zelems[MAXZONES];
-
-	/* Pointers to element arrays to be passed to */
-	/* following funcitons. */
-	int *regionptrx = num_xelems; 
-        int *regionptry = num_yelems; 
-	int *regionptrz = num_zelems;
+	/* Description of the grid is read into spec, which already */
+	/* holds the options from the command line.  The coordinates */
+	/* and element counts calculated from it go in grid.         */
+	static struct grid grid;
+	static int grid_ready = 0;
 
         /* Number of dimensions in grid */
 	int num_dimensions;
-	char actual_axis[4] ;
-
-	/* Number of nodes in each axis. */
-	int num_xnodes = 1, num_ynodes = 1, num_znodes = 1;
-
-	/* Number of zones in each axis. */ 
-	int num_xregions=1, num_yregions=1, num_zregions=1;
-
-	/* Number of elements. */
-	int num_elems = 1;
+	const char *actual_axis;
 
 	/* Name of axis being configured (x, y, or z). */
 	char axis;
@@ -355,24 +858,18 @@ FILE *fp_in;
 	int output;
 
 	/* Counters. */
-	int i, j, k, error_count;
+	int j, error_count;
 
         /* Begin execution */
 
-        /* Initialize arrays */
- 
-        for (i=0; i < MAXNODES; i++){
-                xcoords[i] = 0.0;
-                ycoords[i] = 0.0;
-                zcoords[i] = 0.0;
-         } 
-
-	for (i=0; i < MAXZONES; i++)
-	   {
-		num_xelems[i] = 1;
-		num_yelems[i] = 1;
-		num_zelems[i] = 1;
-	   }
+        /* Initialize arrays, which are kept for the next grid. */
+	if ((grid_ready ? grid_reset(&grid) : gridder_grid_init(&grid)) 
+	    != GRID_OK)
+	{
+	    printf("Out of memory.\n");
+	    return -1;
+	}
+	grid_ready = 1;
 
         error_count = 0;
 	do
@@ -388,34 +885,9 @@ FILE *fp_in;
 	    scanf("%d", &num_dimensions);
 
 	//Assign actual dimensions
-	switch(num_dimensions)
+	actual_axis = gridder_axes(num_dimensions);
+	if (actual_axis == NULL)
 	{
-		case 1:
-			strcpy(actual_axis, "x");
-			break;
-		case 2:
-			strcpy(actual_axis, "xy");
-			break;
-		case 3:
-			strcpy(actual_axis, "xyz");
-			break;
-		case 4:
-			strcpy(actual_axis, "y");
-			//num_dimensions = 1;
-			break;
-		case 5:
-			strcpy(actual_axis, "z");
-			//num_dimensions = 1;
-			break;
-		case 6:
-			strcpy(actual_axis, "xz");
-			//num_dimensions=2;
-			break;
-		case 7:
-			strcpy(actual_axis, "yz");
-			//num_dimensions=2;
-			break;
-		default:
 		printf("\nYou can only have specified dimensions and directions.\n");
                 error_count++;
                 if (error_count > ERR_LEVEL)
@@ -425,9 +897,9 @@ FILE *fp_in;
                 }
 	}
 
-	 } while ((num_dimensions > 7) || (num_dimensions < 1));
-
+	 } while (actual_axis == NULL);
 
+	spec->num_dimensions = num_dimensions;
 	fprintf(fp_in, "%d\n", num_dimensions);
 	if(DEBUG) printf("**>Assigned num_dimentsions: %d\n", num_dimensions);
 
@@ -438,78 +910,46 @@ FILE *fp_in;
    
    axis = actual_axis[axis_i];
    do{
-	//create pointers to the parameters
-	int *num_elements;
-	int *num_regions;
-	int *num_nodes;
-	if(axis == 'x'){
-		num_nodes = &num_xnodes;
-		coords_ptr = xcoords;
-		num_elements = num_xelems;
-		num_regions = &num_xregions;
-	}else if(axis == 'y'){
-		num_nodes = &num_ynodes;
-		coords_ptr = ycoords;
-		num_elements = num_yelems;
-		num_regions = &num_yregions;
-	}else if(axis == 'z'){
-		num_nodes = &num_znodes;
-		coords_ptr = zcoords;
-		num_elements = num_zelems;
-		num_regions = &num_zregions;
+	int axis_num = axis - 'x';
+	int num_nodes;
+
+	num_nodes = assign_axis_coords (&grid, spec, axis_num, axis, fp_in);
+
+	/* If too many nodes, then erase everything and start over. */
+	if (num_nodes == GRID_ERR_TOO_MANY_NODES)
+	{
+		printf("\n\nWoa, that's too many nodes!  I can't handle more ");
+		printf("than %d nodes in any axis.  You're going ", MAXNODES);
+		printf("to have to start over.\n\n");
+		return 0;
+	}
+	if (num_nodes < 0)
+	{
+		printf("Error: %s\n", gridder_error_string(num_nodes));
+		return -1;
 	}
-	*num_nodes = assign_axis_coords (coords_ptr, axis, num_elements,
-		num_regions, fp_in);
 
-	for (j=0; j < *num_nodes; j++)
-		printf("%ccoords[%d] = %20.12g\n", axis,j, *(coords_ptr + j));
+	for (j=0; j < num_nodes; j++)
+		printf("%ccoords[%d] = %20.12g\n", axis,j, grid.coords[axis_num][j]);
 	printf("\n\n");
 	axis = actual_axis[++axis_i];
 	//calculate number of elements
-	num_elems = num_elems * ((*num_nodes) - 1);
+	grid.num_elems = grid.num_elems * (num_nodes - 1);
    }while(axis != '\0');
 
    /* end calculating axis coordinates*/
 
 
-   /* If too many nodes or too many zones, 
-      then erase everything and start over. */
-
-   if ((num_xnodes > MAXNODES) || (num_ynodes > MAXNODES) || (num_znodes > MAXNODES))
-   {
-	printf("\n\nWoa, that's too many nodes!  I can't handle more ");
-	printf("than %d nodes in any axis.  You're going ", MAXNODES);
-	printf("to have to start over.\n\n");
-	main();
-	return 1;
-    }
+   /* If too many zones, then erase everything and start over. */
 
-    if (num_xregions * num_yregions * num_zregions > MAXZONES)
+    if ((long long) grid.num_regions[AXIS_X] * grid.num_regions[AXIS_Y] * 
+		grid.num_regions[AXIS_Z] > MAXZONES)
     {
 	printf("\n\nWoa, that's too many zones! I can't handle more ");
 	printf("than %d total zones in a grid. You're ", MAXZONES);
 	printf("going to have to start over.\n\n");
-	main();
-	return 1;
-    }
-
-
-    /* Calculation of number of elements. */	
-
-    /* 1-D */
-    if ((num_ynodes <= 1) && (num_znodes <= 1)){
-	int num_elems_check = (num_xnodes -1);
-	if (num_elems_check != num_elems){
-		printf("Wrong number of elements\n test = %d ; actual = %d", num_elems_check, num_elems);
-		exit(1);
-	}
+	return 0;
     }
-    /* 2-D */
-//    else if (num_znodes <= 1)
-//	num_elems = ((num_xnodes -1) * (num_ynodes - 1));
-    /* 3-D */
-//    else 
-//	num_elems = ((num_xnodes - 1) * (num_ynodes - 1) * (num_znodes - 1));
 
 
     /* Determination of what type of output desired. */
@@ -518,167 +958,88 @@ FILE *fp_in;
     printf("specifications.\n");
     printf("2 = Tracer3d coordinate input specifications. \n");
     printf("3 = Vectors : x(i) y(j) z(k) \n");
-    printf("4 = FEHM coordinate input specifications. \n\n");
+    printf("4 = FEHM coordinate input specifications. \n");
+    printf("5 = AVS binary UCD. \n");
+    printf("6 = Raw binary arrays (see README). \n");
+    printf("7 = VTK RectilinearGrid (.vtr). \n");
+    printf("8 = VTK UnstructuredGrid pieces (.pvtu and .vtu). \n\n");
 
     scanf("%d", &output);
     fprintf(fp_in, "%d", output);
 
-    if(DEBUG) printf("Num_dimensions before switch: %d\n", num_dimensions);
-    switch(output) { 
-      case 1:
-        /* If output is AVS, print coordinates in AVS UCD format. */
-	{
-	  print_avs_coords(num_xnodes, num_ynodes, num_znodes, 
-			   num_elems, fp_out);
-	  
-	  print_zone_bounds(num_xregions, num_yregions, 
-			  num_zregions, regionptrx, regionptry, regionptrz);
+    if ((output < OUTPUT_AVS) || (output > OUTPUT_LAST))
+    {
+	printf("Invalid output selection %d\n",output);
+	return -1;
+    }
+    spec->output = output;
 
-	  assign_elements_helper(num_xnodes, num_ynodes, num_znodes, 
-			  regionptrx, regionptry, regionptrz, 
-			  num_xregions, num_yregions, num_zregions, num_dimensions, 
-			  output, fp_out);
-	  return 1;
-	}
-      case 2:
-        /* If output is Tracer, print coordinates in Tracer3d format. */
-        {
+    /* A dry run reports the sizes of every output instead. */
+    if (fp_out == NULL)
+	return (print_grid_size(&grid, spec) == GRID_OK) ? output : -1;
 
-	  print_tracer_coords(num_xnodes, num_ynodes, num_znodes, fp_out);
-	  return 2;
-	}
+    /* AVS binary numbers nodes and cells with 32 bit integers. */
+    if (gridder_spec_size(spec, NULL, NULL) == GRID_ERR_TOO_LARGE)
+    {
+	printf("Too many nodes or elements for output %d, ", output);
+	printf("use another output.\n");
+	return -1;
+    }
 
-      case 3:
-        /* If output is Vectors, print coordinates in Vectors format. */
-        {
-	  print_vectors_coords(num_xnodes, num_ynodes, num_znodes, fp_out);
-	  return 3;
-        }
- 
-      case 4:
-        /* If output is FEHM, print coordinates in FEHM format. */
-        {
-	  print_fehm_coords(num_xnodes, num_ynodes, num_znodes, 
-			   num_elems, num_dimensions, fp_out);
-	  assign_elements_helper(num_xnodes, num_ynodes, num_znodes, 
-			  regionptrx, regionptry, regionptrz, 
-			  num_xregions, num_yregions, num_zregions, num_dimensions, 
-			  output, fp_out);
-	  fprintf (fp_out, "\n");
-	  fprintf (fp_out, "%-s\n", "stop");
-	  return 4;
-        } 
+    /* AVS output lists which elements are in which zones. */
+    if ((output == OUTPUT_AVS) || (output == OUTPUT_AVS_BINARY))
+    {
+	gridder_stats_begin(spec->stats, GRID_PHASE_ZONES);
+	print_zone_bounds(&grid);
+	gridder_stats_end(spec->stats, GRID_PHASE_ZONES);
+	if (spec->stats != NULL)
+	    spec->stats->records[GRID_PHASE_ZONES] += 
+		(long long) grid.num_regions[AXIS_X] * 
+		grid.num_regions[AXIS_Y] * grid.num_regions[AXIS_Z];
+    }
 
-    default:
-       {
-	 printf("Invalid output selection %d\n",output);
-	 return -1;
-       }
+    if(DEBUG) printf("Num_dimensions before write: %d\n", num_dimensions);
+    if ((j = gridder_write(&grid, spec, fp_out)) != GRID_OK)
+    {
+	printf("Error writing grid file: %s.\n", gridder_error_string(j));
+	return -1;
     }
+    return output;
 
   }
 
 /* End assign_grid_coords_and_elements() */
 
-/****************************************************************************
-* Function: assign_elements_helper() 
-* Calls the assign_elements() with the arguments sorted depending on
-* the dimensions
-* 1: X
-* 2: XY
-* 3: XYZ
-* 4: Y
-* 5: Z
-* 6: XZ
-* 7: YZ
-****************************************************************************/
-void assign_elements_helper(num_xnodes, num_ynodes, num_znodes, 
-			  regionptrx, regionptry, regionptrz, 
-			  num_xregions, num_yregions, num_zregions, num_dimensions, 
-			  output, fp_out)
-
-int num_xnodes;
-int num_ynodes;
-int num_znodes;
-int *regionptrx;
-int *regionptry;
-int *regionptrz;
-int num_xregions;
-int num_yregions;
-int num_zregions;
-int num_dimensions;
-int output;
-FILE *fp_out;
-{
-	if(DEBUG) printf("***>Nodes: x#: %d, y#: %d, z#: %d\n", num_xnodes, num_ynodes, num_znodes);
-	if(DEBUG) printf("***>Regions: x#: %d, y#: %d, z#: %d\n", num_xregions, num_yregions, num_zregions);
-  if(DEBUG) printf("**>NumDimensions in assign_element_helper: %d\n", num_dimensions);
-  switch(num_dimensions){
-	case 1:
-	case 2:
-	case 3:
-	  assign_elements(num_xnodes, num_ynodes, num_znodes, 
-			  regionptrx, regionptry, regionptrz, 
-			  num_xregions, num_yregions, num_dimensions, 
-			  output, fp_out);
-	  break;
-	case 4:
-	  assign_elements(num_ynodes, num_xnodes, num_znodes, 
-			  regionptrx, regionptry, regionptrz, 
-			  num_xregions, num_yregions, 1, 
-			  output, fp_out);
-	  break;
-	case 5:
-	  assign_elements(num_znodes, num_xnodes, num_ynodes, 
-			  regionptrx, regionptry, regionptrz, 
-			  num_xregions, num_yregions, 1, 
-			  output, fp_out);
-	  break;
-	case 6:
-	  assign_elements(num_xnodes, num_znodes, num_ynodes, 
-			  regionptrx, regionptrz, regionptry, 
-			  num_xregions, num_zregions, 2, 
-			  output, fp_out);
-	  break;
-	case 7:
-	  assign_elements(num_ynodes, num_znodes, num_xnodes, 
-			  regionptry, regionptrz, regionptrx, 
-			  num_yregions, num_zregions, 2, 
-			  output, fp_out);
-	  break;
-	default:
-  	  printf("ERROR: Unknown num dimensions in assign_element_helper: %d\n", num_dimensions);
-	  exit(1);
-  }
-}
-
 /******************************************************************************
 * FUNCTION: assign_axis_coords()
 *
-* PURPOSE:  Calculates coordinates for each axis. 
+* PURPOSE:  Reads the regions of an axis into the grid_spec and calculates 
+*           the coordinates for the axis.  Returns the number of nodes in 
+*           the axis, or GRID_ERR_TOO_MANY_NODES.
 ******************************************************************************/
 
-int assign_axis_coords(ptr, axis, num_elems, num_regions, fp_in)
-double *ptr; 
+int assign_axis_coords(grid, spec, axis_num, axis, fp_in)
+struct grid *grid;
+struct grid_spec *spec;
+int axis_num;
 char axis;
-int *num_elems;
-int *num_regions;
 FILE *fp_in;
    {
+	struct grid_axis_spec *axis_spec = &spec->axis[axis_num];
+		/* Description of the axis being read in. */
+
 	int numr;
 		/* Stores number of regions before assigning its value to */ 
 		/* num_zones to avoid pointer complications. */
 	int num_nodes = 0;
 		/* Keeps track of number of coordinates in each region   */
-		/* so that function assign_region_coords starts          */
-		/* writing coordinates where the last region left off    */
-		/* within the coordinate array, instead of writing       */
-		/* over the coordinates assigned in the previous region. */
+		/* so that each region starts writing coordinates where  */
+		/* the last region left off within the coordinate array, */
+		/* instead of writing over the coordinates assigned in   */
+		/* the previous region.                                  */
 
-	int temp; 
-		/* Temporary storage for the number of nodes in a   */
-		/* single region before it is added on to the total */
-		/* number of nodes in the axis.			    */
+	double begin = 0.0;
+		/* BEGIN coordinate of the current region. */
 
         int i, error_count;
 		/* Counter. */
@@ -689,6 +1050,8 @@ FILE *fp_in;
         	scanf("%d", &numr);
 		if (numr <= 0)
 			printf("You have to have at least one region.\n");
+		else if (numr > MAXZONES)
+			printf("You can't have more than %d regions.\n", MAXZONES);
 		error_count++;
 	        if (error_count > ERR_LEVEL)
 	        {
@@ -696,32 +1059,48 @@ FILE *fp_in;
 		   exit(2);
                	}
 
-	   } while (numr <= 0);
+	   } while ((numr <= 0) || (numr > MAXZONES));
 
 	fprintf(fp_in, "%d\n", numr);
+	if (gridder_spec_regions(spec, axis_num, numr) != GRID_OK)
+	   {
+		printf("Not enough memory for %d regions.\n", numr);
+		exit(2);
+	   }
 
 
-/* Assign coordinates for each region. */
+/* Assign coordinates for each region.  Each region after the */
+/* first begins at the last coordinate of the previous one.   */
 
         for (i=1; i <= numr; i++)
 	   {
-                temp = assign_region_coords(&ptr, i, axis, num_elems + i - 1, 
-			fp_in);
+		if (i > 1)
+			begin = grid->coords[axis_num][num_nodes - 1];
 
-/* Num_nodes is total number of nodes in axis = sum of number */
-/* of nodes in each region in axis. */
+                assign_region_coords(&axis_spec->region[i - 1], &begin, i, 
+			axis, fp_in);
+		if (i == 1) 
+		   {
+			axis_spec->begin = begin;
+			num_nodes = 1;
+		   }
 
-		num_nodes = num_nodes + temp;
+/* Num_nodes is total number of nodes in axis = sum of number */
+/* of divisions in each region in axis + 1.  The divisions are */
+/* checked before any coordinates are stored.                  */
+
+		gridder_stats_begin(spec->stats, GRID_PHASE_COORDS);
+		num_nodes = add_region_nodes(grid, axis_num, i - 1,
+			&axis_spec->region[i - 1], begin, num_nodes);
+		gridder_stats_end(spec->stats, GRID_PHASE_COORDS);
+		if (num_nodes < 0)
+			return num_nodes;
 	   }
+	if (spec->stats != NULL)
+		spec->stats->records[GRID_PHASE_COORDS] += num_nodes;
 
-/* If this axis doesn't exist, i.e. if */ 
-/* num_regions = NULL, then the total  */
-/* number of nodes in this axis is 1.  */
-
-	*num_regions = numr;
-
-	if (!numr)
-		num_nodes = 1;
+	grid->num_regions[axis_num] = numr;
+	grid->num_nodes[axis_num] = num_nodes;
 
 	return num_nodes;
    }
@@ -729,30 +1108,27 @@ FILE *fp_in;
 /******************************************************************************
 * FUNCTION  assign_region_coords()
 *
-* PURPOSE: Calculates coordinates within each region.	
+* PURPOSE: Reads the values for a region into a grid_region.	
 ******************************************************************************/
 
-int assign_region_coords(x, region_num, axis, num_elems, fp_in)
-double **x;
+void assign_region_coords(region, begin, region_num, axis, fp_in)
+struct grid_region *region;
+double *begin;
 int region_num;
 char axis;
-int *num_elems;
 FILE *fp_in;
 
-/* **x is the value of the first node in the array   */ 
-/* containing the coordinates for the present axis.  */
-/* *x is the address of that value.                  */
-/* In other words, x is a pointer to a pointer to an */
-/* array of doubleing point nodal values.             */
+/* *begin is read for the first region of an axis.   */
+/* For the other regions it is the last coordinate   */
+/* of the previous region, calculated by the caller. */
 /* Though the variable name x is used, this function */ 
-/* calculates the region coordinates for the y and   */
-/* z axes, as well.                                  */
+/* reads the regions for the y and z axes, as well.  */
 
 {
 
     
     /* Begin and end coordinates */
-    double begin_region;
+    double begin_region = *begin;
     double end_region;
 
     /* Number of divisions. */
@@ -761,15 +1137,14 @@ FILE *fp_in;
     /*If don't specify number of divisions, specify dx. */
     double dx=0.0;
 
-    /* Tells whether to space logarithmically spaced nodes forward
-       (small dx to large) or backward (large dx to small. */
-    int direction;
-
     /* Determines equal, geometric, or logarithmic spacing. */
     int skew_factor=1;
 
+    /* Inputted growth factor of spacing. */
+    double geom_factor = 1.0;
+
     /* Counters */
-    int i, error_count, error_count_two; 
+    int error_count, error_count_two; 
 
 
 
@@ -788,7 +1163,6 @@ FILE *fp_in;
                     region_num, axis);
        	    scanf ("%lf", &begin_region);
        }
-       else begin_region = **x;
 
         /* Input for END coordinates */
         if (region_num > 1)
@@ -937,76 +1311,416 @@ FILE *fp_in;
      printf("\n\n");
 
 
-     if (skew_factor == 2)
-	geom(region_num, axis, &num_divisions, dx, begin_region, end_region, x, fp_in);
-
-     else if (skew_factor == 3)
-     {
-	direction = 1;
-	log_it(&num_divisions, dx, begin_region, end_region, x, direction);
-     }
-     else if (skew_factor == 4)
-     {
-	direction = 0;
-	log_it(&num_divisions, dx, begin_region, end_region, x, direction);
-     }
-     else if (skew_factor == 1)
+/* Input geom_factor.*/
+     if (skew_factor == SPACING_GEOMETRIC)
      {
-	equal(&num_divisions, dx, begin_region, end_region, x, fp_in);
+	error_count=0;
+	do {
+		printf("Please input geometric factor for region %d, axis %c\n\n", region_num, axis);
+		scanf("%lf", &geom_factor);
+		if (geom_factor <= 0)
+		   {
+			printf("Geometric factor must be greater than 0.\n");
+			error_count++;
+             		if (error_count > ERR_LEVEL)
+             		   {
+                		printf("You only get %d chances.\n",ERR_LEVEL);
+                		printf("Program Exiting...\n");
+                		exit(2);
+             		   }
+		   }
+	   } while (geom_factor <= 0);
+	fprintf(fp_in, "%20.12g\n", geom_factor);
      }
 
-     *num_elems = num_divisions;
-
-    /* Set the position of the array pointer to the    */
-    /* next element after the coordinates that have    */
-    /* just been assigned.  That way, the nodal values */
-    /* that are assigned in the next region will not   */
-    /* overwrite the values assigned in this region.   */
-
-    (*x) = (*x) + num_divisions;
-
-
-    /* Return total number of nodes in region for */ 
-    /* purpose  of printing out the values.       */
-
-    if (region_num == 1)
-	return (num_divisions + 1);
-    else return num_divisions;
+     *begin = begin_region;
+     region->end = end_region;
+     region->num_divisions = num_divisions;
+     region->dx = dx;
+     region->spacing = skew_factor;
+     region->geom_factor = geom_factor;
 
  }
 /* End  assign_region_coords() */
 
 /******************************************************************************
-* FUNCTION: equal
+* FUNCTION: run_batch()
 *
-* PURPOSE:Spaces nodes equally.						     
+* PURPOSE:  Builds the grids listed in a manifest with gridder_batch() and
+*           prints a table of the results.  Each line of the manifest is
+*           the file to write followed by the grid description in the
+*           format of input.grid, either the numbers themselves or 
+*           "< file" to read them from file.  Blank lines and lines 
+*           starting with # are skipped.  A line whose description
+*           cannot be read is reported and fails in the table, and the
+*           other grids are still built.  The output options of spec 
+*           (-z, -c, -m) apply to every grid.  With dry_run the size of
+*           each file is printed instead, from gridder_dry_run().
+*           Returns the exit status.
 ******************************************************************************/
+int run_batch(manifest, spec, dry_run)
+const char *manifest;
+const struct grid_spec *spec;
+int dry_run;
+  {
+	struct grid_batch_job *job = NULL;
+	int num_jobs = 0, max_jobs = 0;
+	FILE *fp, *fp_spec;
+	char *line = NULL, *p, *path, *spec_file;
+	size_t line_size = 0;
+	int line_num = 0, i, error = GRID_OK, num_ok = 0;
+	double t;
+
+	if ((fp = fopen(manifest, "r")) == NULL)
+	{
+	    printf("Could not open manifest '%s'.\n", manifest);
+	    return 2;
+	}
 
-void equal(num_div, input_dx, begin, end, x, fp_in)
-int *num_div;
-double input_dx;
-double begin;
-double end;
-double **x;
-FILE *fp_in;
-   {
-	double dx;
-	int i;
+	while ((error == GRID_OK) && (getline(&line, &line_size, fp) > 0))
+	{
+	    line_num++;
+	    for (p=line; (*p == ' ') || (*p == '\t'); p++)
+		;
+	    if ((*p == '#') || (*p == '\n') || (*p == '\0'))
+		continue;
+	    if (num_jobs == max_jobs)
+	    {
+		struct grid_batch_job *more;
+
+		max_jobs = (max_jobs > 0) ? 2 * max_jobs : 64;
+		more = realloc(job, max_jobs * sizeof(*job));
+		if (more == NULL)
+		{
+		    error = GRID_ERR_MEMORY;
+		    break;
+		}
+		job = more;
+	    }
+
+	    /* The file name, then the description. */
+	    path = p;
+	    p += strcspn(p, " \t\n");
+	    if (*p != '\0')
+		*p++ = '\0';
+	    p += strspn(p, " \t");
+	    spec_file = NULL;
+	    if (*p == '<')
+	    {
+		p++;
+		p += strspn(p, " \t");
+		p[strcspn(p, " \t\n")] = '\0';
+		spec_file = p;
+		fp_spec = fopen(p, "r");
+	    }
+	    else
+		fp_spec = fmemopen(p, strlen(p), "r");
+
+	    /* A line that cannot be read fails its own grid only. */
+	    gridder_spec_init(&job[num_jobs].spec);
+	    num_jobs++;
+	    if (fp_spec == NULL)
+		job[num_jobs-1].error = GRID_ERR_IO;
+	    else
+	    {
+		job[num_jobs-1].error = 
+		    gridder_read_spec(&job[num_jobs-1].spec, fp_spec);
+		fclose(fp_spec);
+		/* Left to gridder_batch() to report with the grid. */
+		if (job[num_jobs-1].error == GRID_ERR_TOO_LARGE)
+		    job[num_jobs-1].error = GRID_OK;
+	    }
+	    if ((fp_spec == NULL) && (spec_file != NULL))
+		printf("%s line %d: could not open '%s'.\n", manifest, 
+		    line_num, spec_file);
+	    else if (job[num_jobs-1].error != GRID_OK)
+		printf("%s line %d: %s.\n", manifest, line_num, 
+		    gridder_error_string(job[num_jobs-1].error));
+	    job[num_jobs-1].bytes = 0;
+	    job[num_jobs-1].seconds = 0.0;
+	    job[num_jobs-1].spec.num_threads = 1;
+	    job[num_jobs-1].spec.compress = spec->compress;
+	    job[num_jobs-1].spec.cache = spec->cache;
+	    job[num_jobs-1].spec.map = spec->map;
+	    job[num_jobs-1].spec.data = spec->data;
+	    job[num_jobs-1].spec.num_pieces = spec->num_pieces;
+	    job[num_jobs-1].spec.piece_name = NULL;
+	    for (i=0; i < 3; i++)
+		job[num_jobs-1].spec.blocks[i] = spec->blocks[i];
+	    job[num_jobs-1].spec.ghost = spec->ghost;
+	    job[num_jobs-1].spec.zones = spec->zones;
+	    job[num_jobs-1].spec.stor = spec->stor;
+	    if ((job[num_jobs-1].path = strdup(path)) == NULL)
+		error = GRID_ERR_MEMORY;
+	    else if ((job[num_jobs-1].spec.output == OUTPUT_VTU) ||
+		     (spec->blocks[0] > 1) || (spec->blocks[1] > 1) ||
+		     (spec->blocks[2] > 1) || (spec->zones != 0) || spec->stor)
+	    {
+		/* Each grid's pieces, blocks, zone or .stor files are */
+		/* named after its file.                                */
+		p = malloc(strlen(path) + 5);
+		if (p == NULL)
+		    error = GRID_ERR_MEMORY;
+		else
+		    vtu_piece_name(path, p, strlen(path) + 5);
+		job[num_jobs-1].spec.piece_name = p;
+	    }
+	}
+	fclose(fp);
+	free(line);
+	if (error != GRID_OK)
+	{
+	    printf("%s line %d: %s.\n", manifest, line_num, 
+		gridder_error_string(error));
+	    for (i=0; i < num_jobs; i++)
+	    {
+		gridder_spec_free(&job[i].spec);
+		free((char *) job[i].path);
+		free((char *) job[i].spec.piece_name);
+	    }
+	    free(job);
+	    return 2;
+	}
 
-	/* If user has chosen to input dx instead of number of divixions, */
-	/* then number of divisions = length of region/dx.		  */
-	if (*num_div == 0)
-		*num_div = ceil(((end - begin)/input_dx));
+	t = stats_clock(CLOCK_MONOTONIC);
+	if (dry_run)
+	{
+	    struct grid grid;
+	    struct grid_size size;
+
+	    /* Without a grid every job fails, reported in the table. */
+	    error = gridder_grid_init(&grid);
+	    for (i=0; i < num_jobs; i++)
+	    {
+		if (job[i].error != GRID_OK)
+		    continue;
+		job[i].error = error;
+		if (error == GRID_OK)
+		    job[i].error = gridder_dry_run(&grid, &job[i].spec, &size);
+		else
+		    memset(&size, 0, sizeof(size));
+		job[i].num_nodes = size.num_nodes;
+		job[i].num_elems = size.num_elems;
+		job[i].bytes = size.bytes[job[i].spec.output];
+		if ((job[i].error == GRID_OK) && (job[i].bytes < 0))
+		    job[i].error = GRID_ERR_TOO_LARGE;
+		job[i].seconds = 0.0;
+	    }
+	    gridder_grid_free(&grid);
+	}
+	else
+	{
+	    /* Build the grids that were read, the others keep their error. */
+	    struct grid_batch_job *good;
+	    int num_good = 0;
+
+	    good = malloc((num_jobs + 1) * sizeof(*good));
+	    for (i=0; i < num_jobs; i++)
+		if (good == NULL)
+		    job[i].error = GRID_ERR_MEMORY;
+		else if (job[i].error == GRID_OK)
+		    good[num_good++] = job[i];
+	    if (good != NULL)
+		gridder_batch(good, num_good, spec->num_threads);
+	    for (i=num_good=0; (good != NULL) && (i < num_jobs); i++)
+		if (job[i].error == GRID_OK)
+		    job[i] = good[num_good++];
+	    free(good);
+	}
+	t = stats_clock(CLOCK_MONOTONIC) - t;
+
+	printf("%-24s %14s %14s %14s %9s\n", "grid", "nodes", "elements",
+	    "bytes", "seconds");
+	for (i=0; i < num_jobs; i++)
+	{
+	    if (job[i].error == GRID_OK)
+	    {
+		printf("%-24s %14lld %14lld %14lld %9.3f\n", job[i].path,
+		    job[i].num_nodes, job[i].num_elems, job[i].bytes, 
+		    job[i].seconds);
+		num_ok++;
+	    }
+	    else if (dry_run && (job[i].error == GRID_ERR_TOO_LARGE))
+		printf("%-24s %14lld %14lld %14s\n", job[i].path,
+		    job[i].num_nodes, job[i].num_elems, "too large");
+	    else
+		printf("%-24s %s\n", job[i].path, 
+		    gridder_error_string(job[i].error));
+	    gridder_spec_free(&job[i].spec);
+	    free((char *) job[i].path);
+	    free((char *) job[i].spec.piece_name);
+	}
+	if (dry_run)
+	    printf("\nDry run, %d of %d grids could be written.\n", num_ok, 
+		num_jobs);
+	else
+	    printf("\n%d of %d grids written in %.3f seconds with %d threads.\n",
+		num_ok, num_jobs, t, spec->num_threads);
+	free(job);
+	return (num_ok == num_jobs) ? 0 : 2;
+  }
+/* End run_batch() */
+
+/******************************************************************************
+* FUNCTION: vtu_piece_name()
+*
+* PURPOSE:  Names the VTK pieces, the blocks or the FEHM zone files of the
+*           grid file path: the path without its extension, or "grid" for
+*           standard output.
+******************************************************************************/
+void vtu_piece_name(path, name, size)
+const char *path;
+char *name;
+size_t size;
+  {
+	char *dot, *slash;
+
+	if (strcmp(path, "-") == 0)
+	    path = "grid";
+	snprintf(name, size, "%s", path);
+	dot = strrchr(name, '.');
+	slash = strrchr(name, '/');
+	if ((dot != NULL) && (dot > ((slash != NULL) ? slash + 1 : name)))
+	    *dot = '\0';
+  }
+/* End vtu_piece_name() */
+
+/******************************************************************************
+* FUNCTION: print_grid_size()
+*
+* PURPOSE:  Prints what gridder_dry_run() found out about a grid: the 
+*           node, element and zone counts, the elements in each zone and
+*           the size of the file of each output format.
+******************************************************************************/
+int print_grid_size(grid, spec)
+struct grid *grid;
+const struct grid_spec *spec;
+  {
+	static const char *output_name[] = { "", "AVS", "Tracer3d", 
+	    "Vectors", "FEHM", "AVS binary UCD", "Raw binary arrays",
+	    "VTK rectilinear", "VTK pieces" };
+	struct grid_size size;
+	long long zone;
+	int error, o;
+
+	error = gridder_dry_run(grid, spec, &size);
+	if (error != GRID_OK)
+	{
+	    printf("Error: %s.\n", gridder_error_string(error));
+	    return error;
+	}
+
+	printf("\nDry run, no grid file is written.\n\n");
+	printf("Nodes     %20lld\n", size.num_nodes);
+	printf("Elements  %20lld\n", size.num_elems);
+	printf("Zones     %20lld\n\n", size.num_zones);
+	printf("Zone                  Elements\n");
+	for (zone=1; zone <= size.num_zones; zone++)
+	    printf("%-10lld%20lld\n", zone, gridder_zone_elems(grid, zone));
+	printf("\nOutput                                 Bytes\n");
+	for (o=OUTPUT_AVS; o <= OUTPUT_LAST; o++)
+	{
+	    printf("%c%d %-20s", (o == spec->output) ? '*' : ' ', o, 
+		output_name[o]);
+	    if (size.bytes[o] < 0)
+		printf("%20s\n", "too large");
+	    else
+		printf("%20lld\n", size.bytes[o]);
+	}
+	return GRID_OK;
+  }
+/* End print_grid_size() */
+#endif /* GRIDDER_LIB */
+
+/******************************************************************************/
+/* Spacing kernels.  equal(), geom() and log_it() fill the coordinates of a  */
+/* region in batches with loops that have no calls or branches inside, so   */
+/* an optimizing compiler turns them into SIMD code (gcc -O3).  The         */
+/* logarithm is vlog10() below instead of one log10() call per node.  The   */
+/* results are within GRID_VEC_ULP units in the last place of the scalar    */
+/* libm formulas; bench/spacing_bench.c checks this and times them.         */
+/******************************************************************************/
+
+/* Nodes per batch in log_it(), and per block in geom(). */
+#define GRID_VEC 256
+#define GEOM_BLOCK 32
+
+/******************************************************************************/
+/* FUNCTION: vlog10()							      */
+/* PURPOSE:  out[i] = log10(in[i]) for n positive normal numbers.  Each      */
+/*           value is split into 2^e * m with m in [sqrt(1/2), sqrt(2)),     */
+/*           and ln(m) = 2 atanh(s), s = (m-1)/(m+1), is summed as a         */
+/*           polynomial in s^2 (|s| < 0.1716, so 11 terms reach double       */
+/*           precision).  in and out may be the same array.                  */
+/******************************************************************************/
+static void vlog10(const double *in, double *out, int n)
+   {
+	const double log10_2 = 0.30102999566398119521;
+	const double log10_e = 0.43429448190325182765;
+	const unsigned long long sqrt_half = 0x3fe6a09e667f3bcdULL;
+	const unsigned long long two52 = 0x4330000000000000ULL;
+	union { double d; unsigned long long u; } v, w;
+	double m, s, z, p, e;
+	int i;
+
+	for (i=0; i < n; i++)
+	   {
+		/* Offsetting the bits by those of sqrt(1/2) carries into */
+		/* the exponent exactly when the mantissa is above        */
+		/* sqrt(2), which leaves m in [sqrt(1/2), sqrt(2)) with   */
+		/* only adds, ands and shifts.  The exponent is made a    */
+		/* double by putting it in the low bits of 2^52, as SIMD  */
+		/* units have no 64 bit int to double conversion.         */
+		v.d = in[i];
+		v.u = v.u + (0x3ff0000000000000ULL - sqrt_half);
+		w.u = two52 | (v.u >> 52);
+		e = w.d - (4503599627370496.0 + 1023);
+		v.u = (v.u & 0x000fffffffffffffULL) + sqrt_half;
+		m = v.d;
+
+		s = (m - 1.0) / (m + 1.0);
+		z = s * s;
+		p = 1.0/21;
+		p = 1.0/19 + z * p;
+		p = 1.0/17 + z * p;
+		p = 1.0/15 + z * p;
+		p = 1.0/13 + z * p;
+		p = 1.0/11 + z * p;
+		p = 1.0/9 + z * p;
+		p = 1.0/7 + z * p;
+		p = 1.0/5 + z * p;
+		p = 1.0/3 + z * p;
+		p = 2.0 * s + (2.0 * s) * (z * p);
+		out[i] = e * log10_2 + p * log10_e;
+	   }
+   }
+
+/******************************************************************************
+* FUNCTION: equal
+*
+* PURPOSE:Spaces nodes equally.						     
+******************************************************************************/
+
+void equal(num_div, begin, end, x)
+int num_div;
+double begin;
+double end;
+double *x;
+   {
+	double dx;
+	int i;
 
         /* Dx = length of region/number of divisions. */ 
-	dx = ((end - begin)/(*num_div));
+	dx = ((end - begin)/num_div);
 
         /* The value of the i'th element of the array of */
         /* coordinates = (i * dx) +  the value of the    */
-        /* first coordinate in the region.               */
+        /* first coordinate in the region.  There is no  */
+        /* dependence between nodes, so the loop is      */
+        /* vectorized as it is.                          */
 
-  	for (i=0; i<= *num_div; i++) {
-               	*((*x) + i) = ((i * dx) + begin);
+  	for (i=0; i<= num_div; i++) {
+               	x[i] = ((i * dx) + begin);
         }
 
    }
@@ -1017,111 +1731,137 @@ FILE *fp_in;
 * PURPOSE: Spaces nodes geometrically
 ******************************************************************************/
 
-void geom(region, axis, num_divisions, input_dx, begin, end, x, fp_in)
-int region;
-char axis;
-int *num_divisions;
-double input_dx;
+void geom(num_divisions, geom_factor, begin, end, x)
+int num_divisions;
+double geom_factor;
 double begin;
 double end; 
-double **x;
-FILE *fp_in;
-/* x is again a pointer to a pointer to the   */
-/* array of coordinates for the current axis. */
+double *x;
+/* x is the array of coordinates for the current region. */
 
    {
+	double length = end - begin;
+		/* Length of the region. */
 
-	double geom_factor;	
-		/* Inputted growth factor of spacing. */
-
-	double temp_geom_factor;	
-		/* Temporary storage for geometric factor. */
-
-	double num_eq_div = 0.0;	
-		/* Number of equal divisions, i.e. the number of        */
-		/* times the smallest dx  divides into the total        */
-		/* length of the zone.  (Every other dx is a            */
-		/* multiple of the smallest dx and geom_factor).  	*/
-		/* It is a doubleing point number to allow for the 	*/
-		/* case of a doubleing point geom_factor, which    	*/
-		/* would cause a non-integer number of equal divisions. */
+	double lr;
+		/* log(geom_factor). */
 
-	double dx;
-		/* Space between nodes. */
+	double rk[GEOM_BLOCK], sk[GEOM_BLOCK], ck[GEOM_BLOCK];
+		/* r^k, r^-k and 1 - r^-k (or r^k - 1) for k in a block. */
 
-	double temp;
-		/* Temporary storage for variables. */
+	double scale, a;
+		/* Terms shared by a block of nodes. */
 
-	double j;
-	int i, error_count;
+	int i, k, m;
 		/* Counters. */
 
-
-/* Set the first element of the array equal to  */
-/* the inputted first coordinate of the region. */
- 
-	**x = begin;
-
-
-/* Input geom_factor.*/
-	error_count=0;
-	do {
-		printf("Please input geometric factor for region %d, axis %c\n\n", region, axis);
-		scanf("%lf", &geom_factor);
-		if (geom_factor <= 0)
+/* Each dx is geom_factor times the one before, so node i is at      */
+/* begin + dx*(1 + r + ... + r^(i-1)) = begin + dx*(r^i - 1)/(r - 1) */
+/* and the first dx makes node num_divisions land on end:            */
+/*    x[i] = begin + length * (r^i - 1)/(r^n - 1).                   */
+/* Every node is calculated directly, so there is no error carried   */
+/* from one node to the next, and the ratio is worked out with       */
+/* expm1() so it neither overflows for large n nor loses digits for  */
+/* r close to 1.  The nodes are done GEOM_BLOCK at a time: with      */
+/* i = i0 + k, r^i - 1 = (r^i0 - 1) r^k + (r^k - 1), so only i0      */
+/* needs exp()/expm1() and the k terms are a loop the compiler can   */
+/* vectorize.                                                        */
+
+	x[0] = begin;
+	if (geom_factor == 1.0)
+	   {
+		for (i=1; i < num_divisions; i++)
+			x[i] = begin + length * ((double) i / num_divisions);
+	   }
+	else if (geom_factor > 1.0)
+	   {
+		/* (r^i - 1)/(r^n - 1) = r^(i-n) (1 - r^-i)/(1 - r^-n) */
+		lr = log(geom_factor);
+		for (k=0; k < GEOM_BLOCK; k++)
 		   {
-			printf("Geometric factor must be greater than 0.\n");
-			error_count++;
-             		if (error_count > ERR_LEVEL)
-             		   {
-                		printf("You only get %d chances.\n",ERR_LEVEL);
-                		printf("Program Exiting...\n");
-                		exit(2);
-             		   }
+			rk[k] = exp(k * lr);
+			sk[k] = exp(-k * lr);
+			ck[k] = -expm1(-k * lr);
 		   }
-	   } while (geom_factor <= 0);
-	fprintf(fp_in, "%20.12g\n", geom_factor);
-
-/* If user has chosen to input dx rather than number */
-/* of divisions,then num_divisions will equal 0.     */
-
-	if (*num_divisions == 0)
+		for (i=1; i < num_divisions; i += GEOM_BLOCK)
+		   {
+			m = num_divisions - i;
+			if (m > GEOM_BLOCK)
+				m = GEOM_BLOCK;
+			scale = exp((i - num_divisions) * lr) / 
+				-expm1(-num_divisions * lr);
+			a = -expm1(-i * lr);
+			for (k=0; k < m; k++)
+				x[i + k] = begin + length * 
+					((scale * rk[k]) * (a * sk[k] + ck[k]));
+		   }
+	   }
+	else
 	   {
-
-/* If geometric factor is less than one, need its */
-/* inverse to calculate the number of divisions.  */
-
-		if (geom_factor < 1.0)
-			temp_geom_factor = (1.0/geom_factor);
-		else temp_geom_factor = geom_factor;
-		num_eq_div = ((end-begin)/input_dx);
-		temp = num_eq_div;
-		for(j=0.0; temp > 0; j++)
-			temp = (temp - pow(temp_geom_factor, j));
-		*num_divisions = j;
+		lr = log(geom_factor);
+		for (k=0; k < GEOM_BLOCK; k++)
+		   {
+			rk[k] = exp(k * lr);
+			ck[k] = expm1(k * lr);
+		   }
+		scale = 1.0 / expm1(num_divisions * lr);
+		for (i=1; i < num_divisions; i += GEOM_BLOCK)
+		   {
+			m = num_divisions - i;
+			if (m > GEOM_BLOCK)
+				m = GEOM_BLOCK;
+			a = expm1(i * lr);
+			for (k=0; k < m; k++)
+				x[i + k] = begin + length * 
+					((a * rk[k] + ck[k]) * scale);
+		   }
 	   }
+	x[num_divisions] = end;
+   }
 
-/* num_eq_div = geom_factor^0 + geom_factor^1 +  */ 
-/* geom_factor^2 + ... geom_factor^i,            */
-/* where i = total number of divisions.)         */
-
-	num_eq_div = 0;
-	for (j=0.0; j < *num_divisions; j++)
-		num_eq_div = num_eq_div + pow(geom_factor, j);
-
-/* The initial dx = length of region/ number of equal divisions.  */
-
-	dx = (end - begin)/num_eq_div;
+/******************************************************************************/
+/* FUNCTION: geom_sum()							      */
+/* PURPOSE:  Returns 1 + r + r^2 + ... + r^(n-1) for r >= 1.                 */
+/******************************************************************************/
+static double geom_sum(double r, double n)
+   {
+	if (r == 1.0)
+		return n;
+	return expm1(n * log1p(r - 1.0)) / (r - 1.0);
+   }
 
+/******************************************************************************/
+/* FUNCTION: geom_divisions()						      */
+/* PURPOSE:  Returns the number of divisions of a geometric region of the    */
+/*           given length whose smallest division is dx: the smallest n      */
+/*           with 1 + r + ... + r^(n-1) >= length/dx, where r >= 1 is the    */
+/*           geometric factor or its inverse.  Returns MAXNODES + 1 if that  */
+/*           is more than any axis can hold.                                 */
+/******************************************************************************/
+static int geom_divisions(double r, double length, double dx)
+   {
+	double num_eq_div = length / dx;
+	double n;
 
-/* Subsequent dx's = geom_factor * previous dx.   */
-/* Present coordinate = previous coordinate + dx. */
+	if (r < 1.0)
+		r = 1.0 / r;
 
-	for (i=1; i <= *num_divisions; i++)
-	   {
-		*((*x) + i) = *((*x) + i - 1) + dx;
-		dx = dx * geom_factor;
-	   }
+	/* Solve (r^n - 1)/(r - 1) = num_eq_div for n, then step to the */
+	/* smallest whole n that covers the region, checking against the */
+	/* sum itself in case the logarithms rounded the wrong way.      */
+	if (r == 1.0)
+		n = ceil(num_eq_div);
+	else
+		n = ceil(log1p(num_eq_div * (r - 1.0)) / log1p(r - 1.0));
+	if (!(n <= MAXNODES))
+		return MAXNODES + 1;
+	if (n < 1)
+		n = 1;
+	while ((n > 1) && (geom_sum(r, n - 1) >= num_eq_div))
+		n = n - 1;
+	while (geom_sum(r, n) < num_eq_div)
+		n = n + 1;
+	return n;
    }
 
 /******************************************************************************/
@@ -1129,635 +1869,5834 @@ FILE *fp_in;
 /* PURPOSE: Spaces nodes logarithmically.				      */
 /******************************************************************************/
 
-void log_it(num_div, input_dx, begin, end, x, direction)
-int *num_div;
-double input_dx;
+void log_it(num_div, begin, end, x, direction)
+int num_div;
 double begin;
 double end;
-double **x;
+double *x;
 int direction;
    {
-	int i;
-		/* Counter.*/
+	double t[GRID_VEC];
+		/* Arguments, then logarithms, of a batch of nodes. */
 
-/* If user chose to input dx rather than number */
-/* of divisions, calculate number of divisions. */
+	double step = 9.0/num_div;
+	double length = end - begin;
+	int i, k, n;
+		/* Counters.*/
 
-	if (*num_div == 0)
-	    *num_div = ceil((-9.0/(pow(10.0,(((end-begin)-input_dx)/(end - begin))) - 10)));
+/* Node i is log10(1 + 9i/n) of the way along the region.  The     */
+/* logarithms are taken GRID_VEC at a time with vlog10().           */
+/* Direction 0 is large spacing to small, measured from begin.      */
+/* If spacing is from small dx to large, follow same process        */
+/* except starting from the end of the region and subtracting.      */
 
-/* Set the first element of the array equal to  */
-/* the inputted first coordinate of the region. */
-/* Direction is large to small.			*/		
-
-	if (direction == 0)
+	for (i=0; i <= num_div; i += GRID_VEC)
 	   {
-		for (i=0; i <= *num_div; i++)
-			*(*x + i) = begin + ((log10(1 + ((9.0/(*num_div))*i))) * (end - begin));
+		n = num_div + 1 - i;
+		if (n > GRID_VEC)
+			n = GRID_VEC;
+		for (k=0; k < n; k++)
+			t[k] = 1 + (step * (i + k));
+		vlog10(t, t, n);
+
+		if (direction == 0)
+			for (k=0; k < n; k++)
+				x[i + k] = begin + (t[k] * length);
+		else if (direction == 1)
+			for (k=0; k < n; k++)
+				x[num_div - i - k] = end - (t[k] * length);
 	   }
+   }
 
-/* If spacing is from small dx to large, follow same process   */
-/* except starting from the end of the region and subtracting. */
+/******************************************************************************/
+/* FUNCTION: gridder_axes()						      */
+/* PURPOSE:  Returns the names of the axes used by a dimension option,       */
+/*           or NULL if the option is not 1-7.                               */
+/******************************************************************************/
+const char *gridder_axes(int num_dimensions)
+   {
+	static const char *axes[] = 
+		{ NULL, "x", "xy", "xyz", "y", "z", "xz", "yz" };
 
-	else if (direction == 1)
-	   {
-		for (i=0; i <= *num_div; i++)
-			*(*x + *num_div - i) = end - ((log10(1 + ((9.0/(*num_div))*i))) * (end - begin));
-	   }
+	if ((num_dimensions < 1) || (num_dimensions > 7))
+		return NULL;
+	return axes[num_dimensions];
    }
 
 /******************************************************************************/
-/* FUNCTION: print_avs_coords() 					      */
-/* PURPOSE: Prints coordinates to file in AVS format.				      */
+/* FUNCTION: gridder_extension()					      */
+/* PURPOSE:  Returns the file name extension of an output format, with the  */
+/*           dot, or "" if the format is not 1-OUTPUT_LAST.                  */
 /******************************************************************************/
-void print_avs_coords(num_xnodes, num_ynodes, num_znodes, num_elems, fp_out)
-int num_xnodes;
-int num_ynodes;
-int num_znodes;
-int num_elems;
-FILE *fp_out;
+const char *gridder_extension(int output)
    {
-	int i, j, k;
-		/* Counters. */
+	static const char *ext[] = { "", ".inp", ".dat", ".dat", ".fehm", 
+		".inp", ".raw", ".vtr", ".vtu" };
 
-/* Print to file according to AVS input number of nodes, number of elements, 
-   and number of regions as the number of material specifcations.
-   left justify first numbers, AVS doesn't like a space in first column. */
+	if ((output < 1) || (output > OUTPUT_LAST))
+		return "";
+	return ext[output];
+   }
 
-	fprintf(fp_out, "%-d %d 0 0 0\n", num_xnodes*num_ynodes*num_znodes,  
-		num_elems);
+/******************************************************************************/
+/* FUNCTION: gridder_spec_init()					      */
+/* PURPOSE:  Sets a grid_spec to an empty 1-D AVS grid.                      */
+/******************************************************************************/
+void gridder_spec_init(struct grid_spec *spec)
+   {
+	int a;
+
+	memset(spec, 0, sizeof(*spec));
+	for (a=0; a < 3; a++)
+		spec->axis[a].region = NULL;
+	spec->num_dimensions = 1;
+	spec->output = OUTPUT_AVS;
+	spec->num_threads = 1;
+   }
 
-/* Print coordinates to file. */
-	for (k=0; k < num_znodes; k++)
-		for (j=0; j < num_ynodes; j++)
-			for (i=0; i < num_xnodes; i++)
-				fprintf(fp_out, "%-11d  %20.12g  %20.12g  %20.12g\n", i+1+j*num_xnodes+k*num_xnodes*num_ynodes, xcoords[i], ycoords[j], zcoords[k]);
+/******************************************************************************/
+/* FUNCTION: gridder_spec_regions()					      */
+/* PURPOSE:  Sets the number of regions of an axis, allocating region[] if   */
+/*           it is not big enough.  New regions are zeroed.  Returns GRID_OK,*/
+/*           GRID_ERR_REGIONS or GRID_ERR_MEMORY.                            */
+/******************************************************************************/
+int gridder_spec_regions(struct grid_spec *spec, int axis, int num_regions)
+   {
+	struct grid_axis_spec *axis_spec;
+	struct grid_region *region;
 
+	if ((axis < AXIS_X) || (axis > AXIS_Z) || (num_regions <= 0) ||
+			(num_regions > MAXZONES))
+		return GRID_ERR_REGIONS;
 
+	axis_spec = &spec->axis[axis];
+	if (num_regions > axis_spec->max_regions)
+	   {
+		region = realloc(axis_spec->region, 
+			(size_t) num_regions * sizeof(*region));
+		if (region == NULL)
+			return GRID_ERR_MEMORY;
+		memset(region + axis_spec->max_regions, 0, 
+			(size_t) (num_regions - axis_spec->max_regions) * 
+			sizeof(*region));
+		axis_spec->region = region;
+		axis_spec->max_regions = num_regions;
+	   }
+	axis_spec->num_regions = num_regions;
+	return GRID_OK;
    }
 
 /******************************************************************************/
-/* FUNCTION: print_fehm_coords() 					      */
-/* PURPOSE: Prints coordinates to file in FEHM format.				      */
+/* FUNCTION: gridder_spec_free()					      */
 /******************************************************************************/
-void print_fehm_coords(num_xnodes, num_ynodes, num_znodes, num_elems, num_dimensions, fp_out)
-int num_xnodes;
-int num_ynodes;
-int num_znodes;
-int num_elems;
-int num_dimensions;
-FILE *fp_out;
+void gridder_spec_free(struct grid_spec *spec)
    {
-	int i, j, k;
-		/* Counters. */
+	int a;
 
-/* Print to file according to AVS input number of nodes, number of elements, 
-   and number of regions as the number of material specifcations.
-   left justify first numbers, AVS doesn't like a space in first column. */
+	for (a=0; a < 3; a++)
+	   {
+		free(spec->axis[a].region);
+		spec->axis[a].region = NULL;
+		spec->axis[a].max_regions = 0;
+		spec->axis[a].num_regions = 0;
+	   }
+   }
 
-        fprintf(fp_out, "%-s\n", "coor");
-	fprintf(fp_out, "%d\n", num_xnodes*num_ynodes*num_znodes);
+/******************************************************************************/
+/* FUNCTION: grid_reserve()						      */
+/* PURPOSE:  Makes room for num_nodes coordinates and num_regions regions    */
+/*           along an axis of a grid, at least doubling an array that has    */
+/*           to grow.  Returns GRID_OK or GRID_ERR_MEMORY.                   */
+/******************************************************************************/
+static int grid_reserve(struct grid *grid, int axis, int num_nodes, 
+		int num_regions)
+   {
+	double *coords;
+	int *elems;
+	int n;
 
-/* Print coordinates to file. */
-	for (k=0; k < num_znodes; k++)
-		for (j=0; j < num_ynodes; j++)
-			for (i=0; i < num_xnodes; i++)
-				fprintf(fp_out, "%11d  %20.12g  %20.12g  %20.12g\n", i+1+j*num_xnodes+k*num_xnodes*num_ynodes, xcoords[i], ycoords[j], zcoords[k]);
+	if (num_nodes > grid->max_nodes[axis])
+	   {
+		n = grid->max_nodes[axis];
+		n = (n > MAXNODES / 2) ? MAXNODES : 2 * n;
+		if (n < num_nodes)
+			n = num_nodes;
+		coords = realloc(grid->coords[axis], (size_t) n * sizeof(double));
+		if (coords == NULL)
+			return GRID_ERR_MEMORY;
+		grid->coords[axis] = coords;
+		grid->max_nodes[axis] = n;
+	   }
 
-	fprintf(fp_out, "\n");
-	fprintf(fp_out, "%-s\n", "elem");
-	if (num_dimensions == 3) {
-	  fprintf(fp_out, "8 %d\n", num_elems);
-	} else if  (num_dimensions == 2) {
-	  fprintf(fp_out, "4 %d\n", num_elems);
-	} else {
-	  fprintf(fp_out, "2 %d\n", num_elems);
-	}
+	if (num_regions > grid->max_regions[axis])
+	   {
+		n = grid->max_regions[axis];
+		n = (n > MAXZONES / 2) ? MAXZONES : 2 * n;
+		if (n < num_regions)
+			n = num_regions;
+		elems = realloc(grid->num_elems_per_region[axis], 
+			(size_t) n * sizeof(int));
+		if (elems == NULL)
+			return GRID_ERR_MEMORY;
+		grid->num_elems_per_region[axis] = elems;
+		elems = realloc(grid->region_start[axis], 
+			(size_t) (n + 1) * sizeof(int));
+		if (elems == NULL)
+			return GRID_ERR_MEMORY;
+		grid->region_start[axis] = elems;
+		grid->max_regions[axis] = n;
+	   }
+	return GRID_OK;
    }
 
-/*****************************************************************************/
-/* FUNCTION: print_vectors_coords() 					     */
-/* PURPOSE: Prints coordinates to file in Vectors : x(i) y(j) z(k)	     */
-/* Writes no more than 10 values to each line.
- * Note NX, NY, and NZ are at least 1
- *
- *      NX NY NZ
- *    x(i) i = 1,nx
- *    y(j) i = 1,ny
- *    z(k) i = 1,nz
- *
- */
-/*****************************************************************************/
-void print_vectors_coords(num_xnodes, num_ynodes, num_znodes, fp_out)
-int num_xnodes;
-int num_ynodes;
-int num_znodes;
-FILE *fp_out;
+/******************************************************************************/
+/* FUNCTION: grid_reset()						      */
+/* PURPOSE:  Sets every axis of a grid to a single node at 0.0 in one        */
+/*           region of one element, as for an axis that is not used.  The    */
+/*           arrays are kept for the next grid.                              */
+/******************************************************************************/
+static int grid_reset(struct grid *grid)
    {
+	int a;
 
+	for (a=0; a < 3; a++)
+	   {
+		if (grid_reserve(grid, a, 1, 1) != GRID_OK)
+			return GRID_ERR_MEMORY;
+		grid->num_nodes[a] = 1;
+		grid->num_regions[a] = 1;
+		grid->coords[a][0] = 0.0;
+		grid->num_elems_per_region[a][0] = 1;
+		grid->region_start[a][0] = 0;
+		grid->region_start[a][1] = 1;
+	   }
+	grid->num_elems = 1;
+	return GRID_OK;
+   }
 
-     int i;
-     fprintf(fp_out, "%14d %14d %14d\n",num_xnodes,num_ynodes,num_znodes);
+/******************************************************************************/
+/* FUNCTION: gridder_grid_init()					      */
+/* PURPOSE:  Sets up an empty grid, see grid_reset().  Returns GRID_OK or    */
+/*           GRID_ERR_MEMORY.                                                */
+/******************************************************************************/
+int gridder_grid_init(struct grid *grid)
+   {
+	int a;
 
-/* x(i)
-*/
-     for (i=0; i < num_xnodes; i++) {
-       fprintf(fp_out, "%20.12g ", xcoords[i]);
-       if (((i+1)%10) == 0) {
-	 fprintf(fp_out, "\n");
-       } 
-     }
-     /* don't put extra blank lines.  Flotran could freak out.  */
-     if ((num_xnodes > 0) && (num_xnodes % 10) > 0) {
-       fprintf(fp_out, "\n");
-     } 
+	memset(grid, 0, sizeof(*grid));
+	for (a=0; a < 3; a++)
+	   {
+		grid->coords[a] = NULL;
+		grid->num_elems_per_region[a] = NULL;
+		grid->region_start[a] = NULL;
+	   }
+	return grid_reset(grid);
+   }
 
+/******************************************************************************/
+/* FUNCTION: gridder_grid_free()					      */
+/******************************************************************************/
+void gridder_grid_free(struct grid *grid)
+   {
+	int a;
 
-/* y(j)
-*/
-     for (i=0; i < num_ynodes; i++) {
-       fprintf(fp_out, "%20.12g ", ycoords[i]);
-       if (((i+1)%10) == 0) {
-	 fprintf(fp_out, "\n");
-       } 
-     }
-     /* don't put extra  blank lines.  Flotran could freak out.*/
-     if ((num_ynodes > 0) && (num_ynodes % 10) > 0) {
-       fprintf(fp_out, "\n");
-     } 
+	for (a=0; a < 3; a++)
+	   {
+		free(grid->coords[a]);
+		free(grid->num_elems_per_region[a]);
+		free(grid->region_start[a]);
+		grid->coords[a] = NULL;
+		grid->num_elems_per_region[a] = NULL;
+		grid->region_start[a] = NULL;
+		grid->max_nodes[a] = 0;
+		grid->max_regions[a] = 0;
+	   }
+   }
 
+/* Nodes of an element for a dimension option: line, quad or hex. */
+static int elem_nodes(int num_dimensions)
+   {
+	if (num_dimensions == 3)
+		return 8;
+	if ((num_dimensions == 2) || (num_dimensions == 6) || 
+			(num_dimensions == 7))
+		return 4;
+	return 2;
+   }
 
-/* z(k)
-*/
-     for (i=0; i < num_znodes; i++) {
-       fprintf(fp_out, "%20.12g ", zcoords[i]);   
-       if (((i+1)%10) == 0) {
-	 fprintf(fp_out, "\n");
-       } 
-     }
-     /* don't put extra  blank lines.  Flotran could freak out.*/
-     if ((num_znodes > 0) && (num_znodes % 10) > 0) {
-       fprintf(fp_out, "\n");
-     }
+/******************************************************************************/
+/* FUNCTION: gridder_check_spec()					      */
+/* PURPOSE:  Checks a grid_spec for the same mistakes the prompts catch.     */
+/*           Returns GRID_OK or the GRID_ERR_ value of the first mistake.    */
+/******************************************************************************/
+int gridder_check_spec(const struct grid_spec *spec)
+   {
+	const struct grid_axis_spec *axis_spec;
+	const struct grid_region *region;
+	const char *axes;
+	double begin;
+	long long num_zones = 1;
+	int a, r;
+
+	axes = gridder_axes(spec->num_dimensions);
+	if (axes == NULL)
+		return GRID_ERR_DIMENSION;
+
+	for (a=0; axes[a] != '\0'; a++)
+	   {
+		axis_spec = &spec->axis[axes[a] - 'x'];
+		if ((axis_spec->num_regions <= 0) || 
+				(axis_spec->num_regions > MAXZONES))
+			return GRID_ERR_REGIONS;
+		/* Both at most MAXZONES, so the product fits. */
+		num_zones = num_zones * axis_spec->num_regions;
+		if (num_zones > MAXZONES)
+			return GRID_ERR_TOO_MANY_ZONES;
+
+		begin = axis_spec->begin;
+		for (r=0; r < axis_spec->num_regions; r++)
+		   {
+			region = &axis_spec->region[r];
+			if (region->end <= begin)
+				return GRID_ERR_BOUNDS;
+			if (region->num_divisions < 0)
+				return GRID_ERR_DIVISIONS;
+			if ((region->num_divisions == 0) && ((region->dx <= 0) ||
+					(region->dx > (region->end - begin))))
+				return GRID_ERR_DIVISIONS;
+			if ((region->spacing < SPACING_EQUAL) || 
+					(region->spacing > SPACING_LOG_LARGE))
+				return GRID_ERR_SPACING;
+			if ((region->spacing == SPACING_GEOMETRIC) &&
+					(region->geom_factor <= 0))
+				return GRID_ERR_GEOM_FACTOR;
+			begin = region->end;
+		   }
+	   }
 
+	if ((spec->output < OUTPUT_AVS) || (spec->output > OUTPUT_LAST))
+		return GRID_ERR_OUTPUT;
+
+	return gridder_spec_size(spec, NULL, NULL);
    }
 
 /******************************************************************************/
-/* FUNCTION: print_tracer_coords         				      */
-/* PURPOSE: Prints coordinates to file in Tracer3d format.		      */
+/* FUNCTION: gridder_spec_size()					      */
+/* PURPOSE:  Works out the number of nodes and elements of a checked         */
+/*           grid_spec from the divisions of its regions, without            */
+/*           calculating any coordinates.  Node and element numbers are      */
+/*           64 bit, so the limits are MAXNODES along an axis, nodes that    */
+/*           fit in an int64 and the 32 bit numbers of the AVS binary        */
+/*           format.  Either pointer may be NULL.  Returns GRID_OK,          */
+/*           GRID_ERR_TOO_MANY_NODES or                                      */
+/*           GRID_ERR_TOO_LARGE.                                             */
 /******************************************************************************/
-void print_tracer_coords(num_xnodes, num_ynodes, num_znodes, fp_out)
-int num_xnodes;
-int num_ynodes;
-int num_znodes;
-FILE *fp_out;
+int gridder_spec_size(const struct grid_spec *spec, long long *num_nodes,
+		long long *num_elems)
    {
-	int i;
-		/* Counter. */
+	const struct grid_axis_spec *axis_spec;
+	const char *axes;
+	long long nodes = 1, elems = 1, axis_nodes;
+	double begin;
+	int a, r;
 
-	fprintf(fp_out, "rcm=");
-	for (i=0; i < num_xnodes-1; i++)
-	fprintf(fp_out, "%20.12g,1,", xcoords[i]);
-	fprintf(fp_out, "%20.12g,\n", xcoords[num_xnodes-1]);
+	axes = gridder_axes(spec->num_dimensions);
+	if (axes == NULL)
+		return GRID_ERR_DIMENSION;
 
-	fprintf(fp_out, "ycm=");
-	for (i=0; i < num_ynodes-1; i++)
-	fprintf(fp_out, "%20.12g,1,", ycoords[i]);
-	fprintf(fp_out, "%20.12g,\n", ycoords[num_ynodes-1]);
+	for (a=0; axes[a] != '\0'; a++)
+	   {
+		axis_spec = &spec->axis[axes[a] - 'x'];
+		axis_nodes = 1;
+		begin = axis_spec->begin;
+		for (r=0; r < axis_spec->num_regions; r++)
+		   {
+			axis_nodes = axis_nodes + 
+				gridder_region_divisions(&axis_spec->region[r], 
+					begin);
+			if (axis_nodes > MAXNODES)
+				return GRID_ERR_TOO_MANY_NODES;
+			begin = axis_spec->region[r].end;
+		   }
+		/* MAXNODES^3 is past the int64 limit, so check first. */
+		if (axis_nodes > LLONG_MAX / nodes)
+			return GRID_ERR_TOO_LARGE;
+		nodes = nodes * axis_nodes;
+		elems = elems * (axis_nodes - 1);
+	   }
 
-	fprintf(fp_out, "zcm=");
-	for (i=0; i < num_znodes-1; i++)
-	fprintf(fp_out, "%20.12g,1,", zcoords[i]);
-	fprintf(fp_out, "%20.12g,\n", zcoords[num_znodes-1]);
+	if ((spec->output == OUTPUT_AVS_BINARY) && ((nodes > INT_MAX) ||
+			(elems > INT_MAX / elem_nodes(spec->num_dimensions))))
+		return GRID_ERR_TOO_LARGE;
 
+	if (num_nodes != NULL)
+		*num_nodes = nodes;
+	if (num_elems != NULL)
+		*num_elems = elems;
+	return GRID_OK;
    }
 
 /******************************************************************************/
-/* FUNCTION: print_spacing_info()						      */
-/* PURPOSE:  Prints out more info about spacing.			      */
+/* FUNCTION: gridder_read_spec()					      */
+/* PURPOSE:  Reads a grid_spec in the format of the copy of the input the   */
+/*           interactive gridder writes (input.grid): the dimension option,  */
+/*           then for each axis the number of regions and BEGIN, for each    */
+/*           region END, divisions, dx if divisions is 0, spacing and the    */
+/*           geometric factor if the spacing is geometric, and last the      */
+/*           output option.  Returns GRID_OK, GRID_ERR_INPUT if the numbers  */
+/*           run out or are not numbers, or the error of gridder_check_spec. */
 /******************************************************************************/
-void print_spacing_info()
+int gridder_read_spec(struct grid_spec *spec, FILE *fp)
    {
-	int which_info;
-		/* Number describing which subject user would */
-		/* like more information about. */
-	int menu;
-		/* Allows user to return to menu when finished reading */
-		/* information. */
-	int error_count;
-		/* Counter */
-
-	error_count = 0;
-	printf("\n\nHELP MENU:\n\n");
-	do
+	struct grid_axis_spec *axis_spec;
+	struct grid_region *region;
+	const char *axes;
+	int a, r, n;
+
+	if (fscanf(fp, "%d", &spec->num_dimensions) != 1)
+		return GRID_ERR_INPUT;
+	axes = gridder_axes(spec->num_dimensions);
+	if (axes == NULL)
+		return GRID_ERR_DIMENSION;
+
+	for (a=0; axes[a] != '\0'; a++)
 	   {
-		printf("Please input which subject you would like more ");
-		printf("information about: \n");
-		printf("0 = return to program.\n");
-	 	printf("1 = equally spaced nodes.\n");
-		printf("2 = geometric spacing of nodes.\n");
-		printf("3 = logarithmic spacing of nodes.\n");
-		scanf("%d", &which_info);
-		if ((which_info < 0) || (which_info > 3))
+		axis_spec = &spec->axis[axes[a] - 'x'];
+		if (fscanf(fp, "%d", &n) != 1)
+			return GRID_ERR_INPUT;
+		if ((n <= 0) || (n > MAXZONES))
+			return GRID_ERR_REGIONS;
+		if (gridder_spec_regions(spec, axes[a] - 'x', n) != GRID_OK)
+			return GRID_ERR_MEMORY;
+		if (fscanf(fp, "%lf", &axis_spec->begin) != 1)
+			return GRID_ERR_INPUT;
+
+		for (r=0; r < n; r++)
 		   {
-			printf("Please input a 0, 1, 2, or 3.\n\n");
-	             	error_count++;
-	             	if (error_count > ERR_LEVEL)
-	                   {
-	                	printf("You only get %d chances.\n",ERR_LEVEL);
-	                	printf("Program Exiting...\n");
-	                	exit(2);
-	                   }
-        	   }
+			region = &axis_spec->region[r];
+			region->dx = 0.0;
+			region->geom_factor = 1.0;
+			if (fscanf(fp, "%lf %d", &region->end, 
+					&region->num_divisions) != 2)
+				return GRID_ERR_INPUT;
+			if ((region->num_divisions == 0) && 
+					(fscanf(fp, "%lf", &region->dx) != 1))
+				return GRID_ERR_INPUT;
+			if (fscanf(fp, "%d", &region->spacing) != 1)
+				return GRID_ERR_INPUT;
+			if ((region->spacing == SPACING_GEOMETRIC) && 
+					(fscanf(fp, "%lf", &region->geom_factor) != 1))
+				return GRID_ERR_INPUT;
+		   }
 	   }
-	while ((which_info < 0)||(which_info > 3));
 
-	if (which_info == 0)
-		return;
+	if (fscanf(fp, "%d", &spec->output) != 1)
+		return GRID_ERR_INPUT;
+	return gridder_check_spec(spec);
+   }
 
-	if (which_info == 1)
-	   {
-		printf("\n\nEQUAL SPACING\n");
-		printf("\nIn a region with equal spacing, all of the nodes are equally spaced.  This distance between any two nodes in the region is equal to the length of the region divided by its number of divisions.  For example, if the user inputs a region 10 units long with 10 divisions, the distance between every pair of consecutive nodes in the region equals 1.  \n");
+/******************************************************************************/
+/* FUNCTION: gridder_region_divisions()					      */
+/* PURPOSE:  Returns the number of divisions in a region.  If the number of  */
+/*           divisions was input as 0 it is calculated from the smallest dx. */
+/******************************************************************************/
+int gridder_region_divisions(const struct grid_region *region, double begin)
+   {
+	double end = region->end;
+	double input_dx = region->dx;
+	double num_eq_div;
 
-	   }
+	if (region->num_divisions > 0)
+		return region->num_divisions;
 
-	else if(which_info == 2)
+	switch (region->spacing)
 	   {
-		printf("\n\nGEOMETRIC SPACING: \n\n");
-		printf("In a region with geometric spacing, the distance between each node increases by a factor inputted by the user.  (The user will be prompted for a geometric factor if he or she chooses geometric spacing of nodes.)  The length of any division in the region will be equal to the geometric factor times the length of the previous division.  Here is an example of a geometric series with a geometric factor of 2:\n");
-		printf("\n0, 1, 3, 7, 15, 31\n");
-		printf("\nHere, n1 = 0.  n2 = 1.  The geometric factor = 2. n3 is determined by the following formula: \nn3 = n2 + f*(n2 - n1)\nn3 = 1 + 2*(1-0) = 3\n\nn4 is determined similarly:\nn4 = n3 + f*(n3 - n2)/nn4 = 3 + 2*(3-1) = 7.  And so on for the rest of the nodes in the series. Geometric spacing is determined in the same fashion where the numbers in the series become the coordinates.\n\n");
-		printf("If the user wishes that the distance between each node decreases by a given factor, he or she should simply input as the geometric factor 1 divided by the factor of shrinkage desired. For example, to create a region where the distances between nodes becomes smaller by a factor of two, simply input as the geometric factor 0.5 = 1/2.\n");
-	   }
+	      case SPACING_GEOMETRIC:
+		return geom_divisions(region->geom_factor, end - begin, 
+			input_dx);
 
-	else if (which_info == 3)
-	   {
-		printf("\nLOGARTIHMIC SPACING: \n\n");
-		printf("In a region with logarithmically spaced nodes, the coordinates of the nodes are determined as a function of log base 10 of x.  Since by nature, this type of spacing results in smaller divisions towards the beginning of the region and larger divisions toward the end of the region, we have included as a separate spacing option a 'backwards' logarithmic spacing, where the the divisions are larger towards the beginning of the region and gradually become smaller (accordint to the funtion of log(x)) as they approach the end of the region. \n");
+	      case SPACING_LOG_SMALL:
+	      case SPACING_LOG_LARGE:
+		return ceil((-9.0/(pow(10.0,(((end-begin)-input_dx)/(end - begin))) - 10)));
+
+	      default:
+
+	/* If user has chosen to input dx instead of number of divixions, */
+	/* then number of divisions = length of region/dx.		  */
+		num_eq_div = ceil(((end - begin)/input_dx));
+		if (num_eq_div > MAXNODES)
+			return MAXNODES + 1;
+			/* Too many for any axis, and would overflow an int. */
+		return num_eq_div;
 	   }
+   }
 
-	printf("\nPress 1 to return to menu.\n");
-	scanf("%d", &menu);
-	if (menu == 1)
-		print_spacing_info();
+/******************************************************************************/
+/* FUNCTION: gridder_region_coords()					      */
+/* PURPOSE:  Calculates the coordinates x[0] ... x[n] of a region that       */
+/*           starts at begin, where n is the number of divisions.  Returns   */
+/*           n, or GRID_ERR_TOO_MANY_NODES without touching x if n would be  */
+/*           more than max_divisions.                                        */
+/******************************************************************************/
+int gridder_region_coords(const struct grid_region *region, double begin,
+		double *x, int max_divisions)
+   {
+	int num_divisions;
+
+	if (region->end <= begin)
+		return GRID_ERR_BOUNDS;
+
+	num_divisions = gridder_region_divisions(region, begin);
+	if (num_divisions > max_divisions)
+		return GRID_ERR_TOO_MANY_NODES;
 
+	if (region->spacing == SPACING_GEOMETRIC)
+		geom(num_divisions, region->geom_factor, begin, region->end, x);
+	else if (region->spacing == SPACING_LOG_SMALL)
+		log_it(num_divisions, begin, region->end, x, 1);
+	else if (region->spacing == SPACING_LOG_LARGE)
+		log_it(num_divisions, begin, region->end, x, 0);
+	else
+		equal(num_divisions, begin, region->end, x);
+
+	return num_divisions;
    }
 
 /******************************************************************************/
-/* FUNCTION: print_zone_bounds						      */
-/* PURPOSE:  Prints out which element numbers are in which zones.	      */
+/* FUNCTION: gridder_axis_coords()					      */
+/* PURPOSE:  Calculates the coordinates of one axis of a grid_spec.          */
+/*           Returns the number of nodes in the axis or a GRID_ERR_ value.   */
 /******************************************************************************/
+int gridder_axis_coords(struct grid *grid, const struct grid_spec *spec,
+		int axis)
+   {
+	const struct grid_axis_spec *axis_spec = &spec->axis[axis];
+	int num_nodes = 1;
+	int r;
 
+	if ((axis_spec->num_regions <= 0) || (axis_spec->num_regions > MAXZONES))
+		return GRID_ERR_REGIONS;
+	if ((spec->cache != NULL) && 
+			((num_nodes = cache_axis_load(grid, spec, axis)) > 0))
+		return num_nodes;
+	num_nodes = 1;
 
-void print_zone_bounds(num_xregions, num_yregions, num_zregions, xelems, yelems, zelems)
-int num_xregions;
-int num_yregions;
-int num_zregions;
-int *xelems;
-int *yelems;
-int *zelems;
+/* Each region after the first begins at the last */
+/* coordinate of the previous region.             */
 
+	for (r=0; r < axis_spec->num_regions; r++)
+	   {
+		num_nodes = add_region_nodes(grid, axis, r, 
+			&axis_spec->region[r], (r == 0) ? axis_spec->begin : 
+			grid->coords[axis][num_nodes - 1], num_nodes);
+		if (num_nodes < 0)
+			return num_nodes;
+	   }
+
+	grid->num_regions[axis] = axis_spec->num_regions;
+	grid->num_nodes[axis] = num_nodes;
+	if (spec->cache != NULL)
+		cache_axis_store(grid, spec, axis);
+	return num_nodes;
+   }
+
+/******************************************************************************/
+/* FUNCTION: add_region_nodes()						      */
+/* PURPOSE:  Calculates the nodes of region r (from 0) of an axis, which     */
+/*           begins at node num_nodes-1 of the axis.  The number of          */
+/*           divisions is checked and the arrays grown before anything is    */
+/*           stored.  Returns the number of nodes in the axis with this      */
+/*           region, or a GRID_ERR_ value.                                   */
+/******************************************************************************/
+static int add_region_nodes(struct grid *grid, int axis, int r, 
+		const struct grid_region *region, double begin, int num_nodes)
    {
-	extern double xcoords[], ycoords[], zcoords[];
-		/* Arrays containing coordinates. */
+	int num_divisions;
+	int error;
 
-	int x = 0, y = 0, z = 0;
-		/* Coordinate numbers for x, y, and z axis. */
+	if (region->end <= begin)
+		return GRID_ERR_BOUNDS;
 
-	int zone_num = 1;
-		/* Zone number. */
+	num_divisions = gridder_region_divisions(region, begin);
+	if (num_divisions > MAXNODES - num_nodes)
+		return GRID_ERR_TOO_MANY_NODES;
 
-	int i, j, k;
-		/* Counters. */
-	
-	for (k=0; k < num_zregions; k++)
+	error = grid_reserve(grid, axis, num_nodes + num_divisions, r + 1);
+	if (error != GRID_OK)
+		return error;
+
+	num_divisions = gridder_region_coords(region, begin, 
+		grid->coords[axis] + num_nodes - 1, num_divisions);
+	if (num_divisions < 0)
+		return num_divisions;
+	grid->num_elems_per_region[axis][r] = num_divisions;
+	grid->region_start[axis][r] = num_nodes - 1;
+	grid->region_start[axis][r + 1] = num_nodes - 1 + num_divisions;
+	return num_nodes + num_divisions;
+   }
+
+/******************************************************************************/
+/* FUNCTION: gridder_coords()						      */
+/* PURPOSE:  Calculates the coordinates of every axis used by a grid_spec    */
+/*           and the number of elements into a grid set up by               */
+/*           gridder_grid_init().  Returns GRID_OK or GRID_ERR_.             */
+/******************************************************************************/
+int gridder_coords(struct grid *grid, const struct grid_spec *spec)
+   {
+	const char *axes;
+	int error, a, num_nodes = 1;
+
+	error = gridder_check_spec(spec);
+	if (error != GRID_OK)
+		return error;
+
+	error = grid_reset(grid);
+	if (error != GRID_OK)
+		return error;
+	axes = gridder_axes(spec->num_dimensions);
+	gridder_stats_begin(spec->stats, GRID_PHASE_COORDS);
+	for (a=0; axes[a] != '\0'; a++)
 	   {
-		for (j=0; j < num_yregions; j++)
-		   {
-			for (i=0; i < num_xregions; i++)
-			   {
-				printf("\nZone %d\n", zone_num);
-				printf("x boundaries: %20.12g", xcoords[x]);
-				x = x + *(xelems + i);
-				printf("   %20.12g\n", xcoords[x]);
-				printf("y boundaries: %20.12g", ycoords[y]);
-				y = y + *(yelems + j);
-				printf("   %20.12g\n", ycoords[y]);
-				y = y - *(yelems + j);
-				printf("z boundaries: %20.12g", zcoords[z]);
-				z = z + *(zelems + k);
-				printf("   %20.12g\n", zcoords[z]);
-				z = z - *(zelems + k);	
-				zone_num++;
-			   }
-			x = 0;
-			y = y + *(yelems + j);
-		   }
-		y = 0;
-		z = z + *(zelems + k);
+		num_nodes = gridder_axis_coords(grid, spec, axes[a] - 'x');
+		if (num_nodes < 0)
+			break;
+		grid->num_elems = grid->num_elems * (num_nodes - 1);
+		if (spec->stats != NULL)
+			spec->stats->records[GRID_PHASE_COORDS] += num_nodes;
 	   }
+	gridder_stats_end(spec->stats, GRID_PHASE_COORDS);
 
+	return (num_nodes < 0) ? num_nodes : GRID_OK;
    }
 
 /******************************************************************************/
-/* FUNCTION: assign_elements						      */
-/* PURPOSE:  Calculates connectivity.					      */
+/* FUNCTION: grid_regions()						      */
+/* PURPOSE:  Fills in the node counts, region tables and number of elements */
+/*           of a grid_spec that passed gridder_spec_size(), as             */
+/*           gridder_coords() does but without the coordinates, which stay   */
+/*           the single node of grid_reset().  Returns GRID_OK or            */
+/*           GRID_ERR_MEMORY.                                                */
 /******************************************************************************/
+static int grid_regions(struct grid *grid, const struct grid_spec *spec)
+   {
+	const struct grid_axis_spec *axis_spec;
+	const char *axes;
+	double begin;
+	int a, r, axis, num_nodes, num_divisions;
+
+	if (grid_reset(grid) != GRID_OK)
+		return GRID_ERR_MEMORY;
+	axes = gridder_axes(spec->num_dimensions);
+	for (a=0; axes[a] != '\0'; a++)
+	   {
+		axis = axes[a] - 'x';
+		axis_spec = &spec->axis[axis];
+		if (grid_reserve(grid, axis, 1, axis_spec->num_regions) != 
+				GRID_OK)
+			return GRID_ERR_MEMORY;
+		num_nodes = 1;
+		begin = axis_spec->begin;
+		for (r=0; r < axis_spec->num_regions; r++)
+		   {
+			num_divisions = gridder_region_divisions(
+				&axis_spec->region[r], begin);
+			grid->num_elems_per_region[axis][r] = num_divisions;
+			grid->region_start[axis][r] = num_nodes - 1;
+			num_nodes = num_nodes + num_divisions;
+			grid->region_start[axis][r + 1] = num_nodes - 1;
+			begin = axis_spec->region[r].end;
+		   }
+		grid->num_regions[axis] = axis_spec->num_regions;
+		grid->num_nodes[axis] = num_nodes;
+		grid->num_elems = grid->num_elems * (num_nodes - 1);
+	   }
+	return GRID_OK;
+   }
 
-void assign_elements( num_xnodes, num_ynodes, num_znodes, 
-                xelems, yelems, zelems, num_xregions, 
-                num_yregions, num_dimensions, output, fp_out)
-int num_xnodes;
-int num_ynodes;
-int num_znodes;
-int *xelems;
-int *yelems;
-int *zelems;
-int num_xregions;
-int num_yregions;
-int num_dimensions;
-int output;
-FILE *fp_out;
+/******************************************************************************/
+/* FUNCTION: gridder_write()						      */
+/* PURPOSE:  Writes a grid calculated by gridder_coords() to fp_out in the   */
+/*           output format of the grid_spec, or copies it from the cache.   */
+/*           Returns GRID_OK or GRID_ERR_.                                   */
+/******************************************************************************/
+int gridder_write(const struct grid *grid, const struct grid_spec *spec,
+		FILE *fp_out)
    {
+	/* The cache keeps one file a grid, VTK pieces, blocks and FEHM */
+	/* zone and .stor files are several.                            */
+	if ((spec->cache != NULL) && (spec->output != OUTPUT_VTU) && 
+			(spec_num_blocks(spec) == 1) && 
+			((spec->output != OUTPUT_FEHM) || 
+			((spec->zones == 0) && !spec->stor)))
+		return cache_grid_write(grid, spec, fp_out);
+	return grid_write(grid, spec, fp_out, 0);
+   }
 
-	int num_trials;
-		/* Number of nodes chacked to see if should start an */
-		/* element assignment at that node.  All nodes begin */
-		/* an element except the nodes in the first row      */
-		/* (smallest y), the nodes on the end of each row    */
-		/* (largest x), and the nodes in the last plane      */ 
-		/* (largest z).  This program starts on row two and  */
-		/* ends on the next to the last plane, checks to be  */
-		/* sure the current node is not at the end of a row  */
-		/* end of a row, and starts an element. It does this */
-		/* num_trials times. 	                             */
+static int grid_write(const struct grid *grid, const struct grid_spec *spec,
+		FILE *fp_out, int dry)
+   {
+	static const int origin[3] = { 0, 0, 0 };
 
-	int row_num, plane_num = 1;
-		/* Keep track of row number and plane number. */
+	/* OUTPUT_VTU has its own pieces. */
+	if ((spec_num_blocks(spec) > 1) && (spec->output != OUTPUT_VTU))
+		return write_blocks(grid, spec, fp_out, dry);
+	return grid_write_part(grid, grid, origin, spec, fp_out, dry);
+   }
 
-	int elem_ident = 1;
-		/* Element identification number. */ 
+static int grid_write_part(const struct grid *grid, const struct grid *whole,
+		const int origin[3], const struct grid_spec *spec, 
+		FILE *fp_out, int dry)
+   {
+	int num_xnodes = grid->num_nodes[AXIS_X];
+	int num_ynodes = grid->num_nodes[AXIS_Y];
+	int num_znodes = grid->num_nodes[AXIS_Z];
+
+	/* assign_elements() finds zones from the region start tables. */
+	int *regionptrx = grid->region_start[AXIS_X];
+	int *regionptry = grid->region_start[AXIS_Y];
+	int *regionptrz = grid->region_start[AXIS_Z];
+
+	long long num_nodes = (long long) num_xnodes * num_ynodes * num_znodes;
+	struct grid_out out;
+	struct grid_gzip *gz = NULL;
+	int axis, gz_error;
+	int error = GRID_OK;
+
+	if ((spec->output < OUTPUT_AVS) || (spec->output > OUTPUT_LAST))
+		return GRID_ERR_OUTPUT;
+
+	/* The writers write to the compressor instead of the file. */
+	/* VTK pieces are not compressed, nor is the .pvtu naming them. */
+	if ((spec->compress > 0) && !dry && (spec->output != OUTPUT_VTU))
+	   {
+		error = grid_gzip_open(&gz, &fp_out, spec->num_threads, 
+			spec->compress);
+		if (error != GRID_OK)
+			return error;
+	   }
 
-	int node_ident;
-		/* Node identification number. */
+	out.fp = fp_out;
+	out.num_threads = (spec->num_threads > 1) ? spec->num_threads : 1;
+	out.map = spec->map && !dry;
+	out.dry = dry;
+	out.data = ((spec->output == OUTPUT_AVS) || 
+		(spec->output == OUTPUT_VTR)) ? spec->data : 0;
+	out.axes = gridder_axes(spec->num_dimensions);
+	out.num_pieces = (spec->num_pieces > 0) ? spec->num_pieces : 
+		out.num_threads;
+	out.piece_name = (spec->piece_name != NULL) ? spec->piece_name : 
+		"grid";
+	out.whole = whole;
+	for (axis=AXIS_X; axis <= AXIS_Z; axis++)
+		out.origin[axis] = origin[axis];
+	out.coords[AXIS_X] = grid->coords[AXIS_X];
+	out.coords[AXIS_Y] = grid->coords[AXIS_Y];
+	out.coords[AXIS_Z] = grid->coords[AXIS_Z];
+	out.visitor = NULL;
+	out.stats = spec->stats;
+
+    switch(spec->output) { 
+      case OUTPUT_AVS:
+        /* If output is AVS, print coordinates in AVS UCD format. */
+	  out_phase_begin(&out, GRID_PHASE_NODES);
+	  error = print_avs_coords(num_xnodes, num_ynodes, num_znodes, 
+			   grid->num_elems, &out);
+	  out_phase_end(&out, num_nodes);
+	  if (error != GRID_OK)
+	    break;
+	  out_phase_begin(&out, GRID_PHASE_ELEMS);
+	  error = assign_elements_helper(num_xnodes, num_ynodes, num_znodes, 
+			  regionptrx, regionptry, regionptrz, 
+			  grid->num_regions[AXIS_X], grid->num_regions[AXIS_Y],
+			  grid->num_regions[AXIS_Z], spec->num_dimensions, 
+			  spec->output, &out);
+	  out_phase_end(&out, grid->num_elems);
+	  break;
 
-	int elements[8];
-		/* Array of element identification numbers, each with */
-		/* up to 8 nodes defining element's connectivity.     */
+      case OUTPUT_TRACER:
+        /* If output is Tracer, print coordinates in Tracer3d format. */
+	  out_phase_begin(&out, GRID_PHASE_NODES);
+	  print_tracer_coords(num_xnodes, num_ynodes, num_znodes, &out);
+	  out_phase_end(&out, num_xnodes + num_ynodes + num_znodes);
+	  break;
 
-	int zone_num = 1;
-		/* Zone number. */
+      case OUTPUT_VECTORS:
+        /* If output is Vectors, print coordinates in Vectors format. */
+	  out_phase_begin(&out, GRID_PHASE_NODES);
+	  print_vectors_coords(num_xnodes, num_ynodes, num_znodes, &out);
+	  out_phase_end(&out, num_xnodes + num_ynodes + num_znodes);
+	  break;
+ 
+      case OUTPUT_FEHM:
+        /* If output is FEHM, print coordinates in FEHM format. */
+	  out_phase_begin(&out, GRID_PHASE_NODES);
+	  error = print_fehm_coords(num_xnodes, num_ynodes, num_znodes, 
+			   grid->num_elems, spec->num_dimensions, &out);
+	  out_phase_end(&out, num_nodes);
+	  out_phase_begin(&out, GRID_PHASE_ELEMS);
+	  if (error == GRID_OK)
+	    error = assign_elements_helper(num_xnodes, num_ynodes, num_znodes, 
+			  regionptrx, regionptry, regionptrz, 
+			  grid->num_regions[AXIS_X], grid->num_regions[AXIS_Y],
+			  grid->num_regions[AXIS_Z], spec->num_dimensions, 
+			  spec->output, &out);
+	  fprintf (fp_out, "\n");
+	  fprintf (fp_out, "%-s\n", "stop");
+	  out_phase_end(&out, grid->num_elems);
+	  break;
 
-	int zone_elems = 0;
-		/* Number of elements in all previous regions in current axis.*/
+      case OUTPUT_AVS_BINARY:
+        /* AVS binary UCD: header, cells and node lists, then x, y and z. */
+	  out_phase_begin(&out, GRID_PHASE_NODES);
+	  error = print_avs_binary_header(num_nodes, grid->num_elems, 
+			  spec->num_dimensions, fp_out);
+	  out_phase_end(&out, 0);
+	  if (error != GRID_OK)
+	    break;
+	  out_phase_begin(&out, GRID_PHASE_ELEMS);
+	  error = assign_elements_helper(num_xnodes, num_ynodes, num_znodes, 
+			  regionptrx, regionptry, regionptrz, 
+			  grid->num_regions[AXIS_X], grid->num_regions[AXIS_Y],
+			  grid->num_regions[AXIS_Z], spec->num_dimensions, 
+			  spec->output, &out);
+	  out_phase_end(&out, grid->num_elems);
+	  out_phase_begin(&out, GRID_PHASE_NODES);
+	  for (axis=AXIS_X; (axis <= AXIS_Z) && (error == GRID_OK); axis++)
+	    error = print_binary_coords(num_xnodes, num_ynodes, num_znodes, 
+			  axis, &out);
+	  out_phase_end(&out, num_nodes);
+	  break;
 
-	int zone_rows = 0;
-		/* Number of rows in all previous regions in current plane. */
+      case OUTPUT_RAW:
+        /* Raw arrays: header, coordinates, connectivity, zones. */
+	  out_phase_begin(&out, GRID_PHASE_NODES);
+	  error = print_raw_header(num_nodes, grid->num_elems, 
+			  spec->num_dimensions, fp_out);
+	  if (error == GRID_OK)
+	    error = print_binary_coords(num_xnodes, num_ynodes, num_znodes, 
+			  -1, &out);
+	  out_phase_end(&out, num_nodes);
+	  if (error != GRID_OK)
+	    break;
+	  out_phase_begin(&out, GRID_PHASE_ELEMS);
+	  error = assign_elements_helper(num_xnodes, num_ynodes, num_znodes, 
+			  regionptrx, regionptry, regionptrz, 
+			  grid->num_regions[AXIS_X], grid->num_regions[AXIS_Y],
+			  grid->num_regions[AXIS_Z], spec->num_dimensions, 
+			  spec->output, &out);
+	  out_phase_end(&out, grid->num_elems);
+	  break;
 
-	int zone_planes = 0;	
-		/* Number of planes in all previous regions. */
+      case OUTPUT_VTR:
+        /* VTK rectilinear grid: the axes and regions, then the zones. */
+	  out_phase_begin(&out, GRID_PHASE_NODES);
+	  error = print_vtr_header(grid, &out);
+	  out_phase_end(&out, num_xnodes + num_ynodes + num_znodes);
+	  if ((error != GRID_OK) || !(out.data & GRID_DATA_CELLS))
+	    break;
+	  out_phase_begin(&out, GRID_PHASE_ELEMS);
+	  error = assign_elements_helper(num_xnodes, num_ynodes, num_znodes, 
+			  regionptrx, regionptry, regionptrz, 
+			  grid->num_regions[AXIS_X], grid->num_regions[AXIS_Y],
+			  grid->num_regions[AXIS_Z], spec->num_dimensions, 
+			  spec->output, &out);
+	  out_phase_end(&out, grid->num_elems);
+	  break;
 
-	int row=1;
-		/* Row number used for zone calculations, separate from */
-		/* `row_num' which is used for connectivity calculations. */
+      case OUTPUT_VTU:
+        /* VTK unstructured pieces on the threads, and the .pvtu. */
+	  out_phase_begin(&out, GRID_PHASE_ELEMS);
+	  error = assign_elements_helper(num_xnodes, num_ynodes, num_znodes, 
+			  regionptrx, regionptry, regionptrz, 
+			  grid->num_regions[AXIS_X], grid->num_regions[AXIS_Y],
+			  grid->num_regions[AXIS_Z], spec->num_dimensions, 
+			  spec->output, &out);
+	  out_phase_end(&out, grid->num_elems);
+	  break;
+    }
 
-	int plane=1;
-		/* Plane number used for zone calculations, separate from */
-		/* `plane_num' which is used for connectivity calculations. */
+	if ((error == GRID_OK) && (spec->output == OUTPUT_VTR))
+		fprintf(fp_out, "\n  </AppendedData>\n</VTKFile>\n");
 
-	int i, j;
-		/* Counters. */
-/* Starts assignment of nodes within element from bottom side */
-/* of square, according to AVS standards, so assignment of  */
-/* nodes for the first element will begin on row  2. 	      */
+	/* The zone files of the FEHM grid, in their own files. */
+	if ((error == GRID_OK) && (spec->output == OUTPUT_FEHM) && 
+			(spec->zones != 0))
+		error = write_fehm_zones(grid, spec, &out);
+	if ((error == GRID_OK) && (spec->output == OUTPUT_FEHM) && 
+			spec->stor)
+		error = write_fehm_stor(grid, spec, &out);
 
-	row_num = 2;
+	if ((error == GRID_OK) && (fflush(fp_out) != 0 || ferror(fp_out)))
+		error = GRID_ERR_IO;
+	if (gz != NULL)
+	   {
+		gz_error = grid_gzip_close(gz);
+		if (error == GRID_OK)
+			error = gz_error;
+	   }
+	return error;
+   }
 
-	
-/* Start on first node of second row - num_xnodes + 1. */
+/******************************************************************************/
+/* FUNCTION: gridder_visit()						      */
+/* PURPOSE:  Hands a grid calculated by gridder_coords() to a grid_visitor   */
+/*           in blocks instead of writing a file: the node coordinates in    */
+/*           node order, then the connectivity and zones in the order of     */
+/*           the AVS output.  Only one block is held in memory at a time.    */
+/*           Returns GRID_OK, a GRID_ERR_ value, or the nonzero value a      */
+/*           visitor function returned to stop.                              */
+/******************************************************************************/
+int gridder_visit(const struct grid *grid, const struct grid_spec *spec,
+		const struct grid_visitor *visitor)
+   {
+	int num_xnodes = grid->num_nodes[AXIS_X];
+	int num_ynodes = grid->num_nodes[AXIS_Y];
+	int num_znodes = grid->num_nodes[AXIS_Z];
+	long long num_nodes = (long long) num_xnodes * num_ynodes * num_znodes;
+	long long block = (visitor->block > 0) ? visitor->block : 
+		GRID_VISIT_BLOCK;
+	long long first, count, n, i, j, k;
+	struct grid_out out;
+	double *xyz;
+	int error = GRID_OK;
+
+	if (gridder_axes(spec->num_dimensions) == NULL)
+		return GRID_ERR_DIMENSION;
+
+	out.fp = NULL;
+	out.num_threads = 1;
+	out.map = 0;
+	out.dry = 0;
+	out.data = 0;
+	out.axes = gridder_axes(spec->num_dimensions);
+	out.num_pieces = 1;
+	out.piece_name = NULL;
+	out.whole = grid;
+	out.origin[AXIS_X] = out.origin[AXIS_Y] = out.origin[AXIS_Z] = 0;
+	out.coords[AXIS_X] = grid->coords[AXIS_X];
+	out.coords[AXIS_Y] = grid->coords[AXIS_Y];
+	out.coords[AXIS_Z] = grid->coords[AXIS_Z];
+	out.visitor = visitor;
+	out.stats = spec->stats;
+
+	/* Nodes, x fastest, as in the AVS and FEHM output. */
+	if (visitor->nodes != NULL)
+	   {
+		out_phase_begin(&out, GRID_PHASE_NODES);
+		if (block > num_nodes)
+			block = num_nodes;
+		xyz = malloc((size_t) block * 3 * sizeof(double));
+		if (xyz == NULL)
+			return GRID_ERR_MEMORY;
+		for (first=0; (error == GRID_OK) && (first < num_nodes); 
+				first += count)
+		   {
+			count = num_nodes - first;
+			if (count > block)
+				count = block;
+			i = first % num_xnodes;
+			j = (first / num_xnodes) % num_ynodes;
+			k = first / ((long long) num_xnodes * num_ynodes);
+			for (n=0; n < count; n++)
+			   {
+				xyz[3 * n] = grid->coords[AXIS_X][i];
+				xyz[3 * n + 1] = grid->coords[AXIS_Y][j];
+				xyz[3 * n + 2] = grid->coords[AXIS_Z][k];
+				if (++i == num_xnodes)
+				   {
+					i = 0;
+					if (++j == num_ynodes)
+					   {
+						j = 0;
+						k++;
+					   }
+				   }
+			   }
+			error = visitor->nodes(visitor->arg, first, count, xyz);
+		   }
+		free(xyz);
+		out_phase_end(&out, num_nodes);
+		if (error != GRID_OK)
+			return error;
+	   }
 
-	node_ident = num_xnodes + 1;
+	/* Elements, through the same connectivity as the grid files. */
+	out_phase_begin(&out, GRID_PHASE_ELEMS);
+	error = assign_elements_helper(num_xnodes, num_ynodes, num_znodes, 
+		grid->region_start[AXIS_X], grid->region_start[AXIS_Y],
+		grid->region_start[AXIS_Z], grid->num_regions[AXIS_X], 
+		grid->num_regions[AXIS_Y], grid->num_regions[AXIS_Z], 
+		spec->num_dimensions, OUTPUT_AVS, &out);
+	out_phase_end(&out, (visitor->elems != NULL) ? grid->num_elems : 0);
+	return error;
+   }
 
+/******************************************************************************/
+/* FUNCTION: region_of()						      */
+/* PURPOSE:  Region (from 0) of element e (from 0) along an axis, by binary  */
+/*           search of the num_regions+1 entry region start table.           */
+/******************************************************************************/
+static int region_of(const int *start, int num_regions, int e)
+   {
+	int lo = 0, hi = num_regions - 1, mid;
 
-/* Safeguard in case of non-3-dimensional grid.  */
-/* NOTE this code assumes x axis is used as mininum
-   so will not work if user tries to use just y dimension
-*/
-	if ((num_ynodes <= 1) && (num_znodes <= 1)){
-		num_trials = num_xnodes;
-                node_ident = 1;
+	while (lo < hi)
+	   {
+		mid = lo + (hi - lo + 1) / 2;
+		if (start[mid] <= e)
+			lo = mid;
+		else
+			hi = mid - 1;
+	   }
+	return lo;
+   }
 
-        }
-	else if (num_znodes <= 1) {
-		num_trials = num_xnodes * (num_ynodes - 1);
+/******************************************************************************/
+/* FUNCTION: gridder_zone()						      */
+/* PURPOSE:  Zone (from 1) of the element that starts at node (i, j, k) of   */
+/*           a grid from gridder_coords().                                   */
+/******************************************************************************/
+int gridder_zone(const struct grid *grid, int i, int j, int k)
+   {
+	int nrx = grid->num_regions[AXIS_X];
+	int nry = grid->num_regions[AXIS_Y];
 
+	return 1 + region_of(grid->region_start[AXIS_X], nrx, i) + 
+		nrx * (region_of(grid->region_start[AXIS_Y], nry, j) + 
+		nry * region_of(grid->region_start[AXIS_Z], 
+			grid->num_regions[AXIS_Z], k));
+   }
 
-/* In 3-D, the number of elements = number of x  */
-/* nodes - 1 * number of y nodes - 1 * number of */
-/* z nodes - 1.  This loop skips each row of y   */
-/* nodes and the single plane of znodes that     */
-/* that don't start an element, but not the x    */
-/* nodes that don't start an element.  So, 	 */
-/* num_trials = number of y nodes -1 * number    */
-/* of z nodes - 1 * number of xnodes.   	 */ 
+/******************************************************************************/
+/* FUNCTION: gridder_zone_bounds()					      */
+/* PURPOSE:  First and last node along x, y and z of zone (from 1) of a      */
+/*           grid from gridder_coords().  An axis that is not used has one   */
+/*           node, so both are 0.  Returns GRID_OK, or GRID_ERR_REGIONS if   */
+/*           there is no such zone.                                          */
+/******************************************************************************/
+int gridder_zone_bounds(const struct grid *grid, int zone, int first[3], 
+		int last[3])
+   {
+	int a, r;
 
-        }
-	else {
-               num_trials = num_xnodes * (num_ynodes - 1) * (num_znodes - 1);
-        }
+	zone = zone - 1;
+	if ((zone < 0) || ((long long) zone >= (long long) 
+			grid->num_regions[AXIS_X] * grid->num_regions[AXIS_Y] * 
+			grid->num_regions[AXIS_Z]))
+		return GRID_ERR_REGIONS;
 
-	if(DEBUG) printf("**>Num trials: %d\n", num_trials);
-	if(DEBUG) printf("**>Num_dimensions = %d\n", num_dimensions);	
-        for(i=1; i <= num_trials; i++)
+	for (a=AXIS_X; a <= AXIS_Z; a++)
 	   {
+		r = zone % grid->num_regions[a];
+		zone = zone / grid->num_regions[a];
+		first[a] = grid->region_start[a][r];
+		last[a] = grid->region_start[a][r + 1];
+		if (last[a] >= grid->num_nodes[a])
+			last[a] = grid->num_nodes[a] - 1;
+	   }
+	return GRID_OK;
+   }
+
+/******************************************************************************/
+/* FUNCTION: gridder_build()						      */
+/* PURPOSE:  Calculates the grid described by a grid_spec and writes it to   */
+/*           fp_out.  Nothing is read from the keyboard or printed.          */
+/*           Returns GRID_OK or GRID_ERR_.                                   */
+/******************************************************************************/
+int gridder_build(const struct grid_spec *spec, FILE *fp_out)
+   {
+	struct grid grid;
+	int error;
+
+	error = gridder_grid_init(&grid);
+	if (error == GRID_OK)
+		error = gridder_coords(&grid, spec);
+	if (error == GRID_OK)
+		error = gridder_write(&grid, spec, fp_out);
+	gridder_grid_free(&grid);
+	return error;
+   }
 
+/******************************************************************************/
+/* FUNCTION: gridder_zone_elems()					      */
+/* PURPOSE:  Number of elements in zone (from 1) of a grid from              */
+/*           gridder_coords(), or GRID_ERR_REGIONS if there is no such zone. */
+/******************************************************************************/
+long long gridder_zone_elems(const struct grid *grid, int zone)
+   {
+	long long n = 1;
+	int a, r;
 
-/* Assign element if current node is not last node in row. */
-		 if (node_ident < (row_num * num_xnodes)) 
-		   {
-                        elements[0] = node_ident;
-                        elements[1] = elements[0] + 1;
+	zone = zone - 1;
+	if ((zone < 0) || ((long long) zone >= (long long) 
+			grid->num_regions[AXIS_X] * grid->num_regions[AXIS_Y] * 
+			grid->num_regions[AXIS_Z]))
+		return GRID_ERR_REGIONS;
 
+	for (a=AXIS_X; a <= AXIS_Z; a++)
+	   {
+		r = zone % grid->num_regions[a];
+		zone = zone / grid->num_regions[a];
+		n = n * grid->num_elems_per_region[a][r];
+	   }
+	return n;
+   }
 
-/* If grid is at least two dimensional, assign the next */
-/* two corners for a total of four corners of a square. */
+/* No output format takes more bytes than this for a node or element. */
+#define DRY_MAX_RECORD 1024
 
-			if (num_ynodes > 1)
-			   {   
-				elements[2] = elements[1] - num_xnodes;
-				elements[3] = elements[2] - 1;
-			   }
-		   
-
-/* If grid is 3-D and current node is not on the last  */ 
-/* plane, assign the next four corners to make a cube. */
-
-			if ((plane_num < num_znodes) && (num_znodes > 1))
-		   	   {
-			   				
-				elements[4] = elements[0] + 
-					(num_xnodes*num_ynodes);
-				elements[5] = elements[4] + 1;
-				elements[6] = elements[5] - num_xnodes;
-				elements[7] = elements[6] - 1;
-			    
-/* If current node is the last in its plane, */
-/* increment plane_num and skip the next row */
-/* of nodes.				     */
-
-				if (node_ident==((plane_num) * 
-					(num_xnodes*num_ynodes)) - 1)
-			           {
-				 	plane_num++;
-					node_ident = (node_ident + num_xnodes);
-					row_num++;
-                                   }
-		   	   }
-
-
-/* If element is a cube, i.e. if corners 5 and 6 do not both equal */ 
-/* 0, print the connectivity to the given file in AVS format.      */
-	if (num_dimensions == 3) {
+/* The stream of dry_open(), its cookie is the position as a long long. */
+static long long dry_move(long long *pos, long long offset, int whence)
+   {
+	if ((whence == SEEK_CUR) && (offset <= LLONG_MAX - *pos))
+		offset = *pos + offset;
+	else if (whence != SEEK_SET)
+		return -1;
+	if (offset < 0)
+		return -1;
+	*pos = offset;
+	return offset;
+   }
 
-/* elements[3], elements[2], elements[6], elements[7], 
-   elements[0], elements[1], elements[5], elements[4])
-   changed order to AVS counter clockwise top then bottom - tam Jul 2001 */
-	  if (output == 1) {
-		fprintf(fp_out, "%d   %d hex ", elem_ident, zone_num);
-		for (j=7; j >= 0; j--){
-		  fprintf(fp_out, "%4d", elements[j]);
-		  fprintf(fp_out, " ");
-                }
-		fprintf(fp_out, "\n");
-	  } else if (output == 4) {
-	    	fprintf(fp_out, "%d ", elem_ident); 
-		for (j=7; j >=0; j--){
-		  fprintf(fp_out, "%4d", elements[j]);
-		  fprintf(fp_out, " ");
-                }
-		fprintf(fp_out, "\n");
-	  }
-/* If element is a square, i.e. if corners 3 and 4 do not both equal */
-/* 0, print the connectivity to the given file in AVS format.        */
-
-/* connectivity output was out of order, fixed 950222 cwg        */
-
-	} else if (num_dimensions == 2) {
-	  if (output == 1) {
-		if(DEBUG) printf("**>Output 1: %d %d quad ", elem_ident, zone_num);
-		fprintf(fp_out, "%d   %d quad ", elem_ident, zone_num);
-		for (j=3; j >= 0; j--){
-		  fprintf(fp_out, "%4d", elements[j]);
-		  fprintf(fp_out, " ");
-                }
-		fprintf(fp_out, "\n");
+static int dry_close(void *cookie)
+   {
+	free(cookie);
+	return 0;
+   }
 
-	  } else if (output == 4) {
-	    	fprintf(fp_out, "%d ", elem_ident); 
-		for (j=3; j >=0; j--){
-		  fprintf(fp_out, "%4d", elements[j]);
-		  fprintf(fp_out, " ");
-                }
-		fprintf(fp_out, "\n");
-	  }
+#ifdef __GLIBC__
+static ssize_t dry_write(void *cookie, const char *buf, size_t n)
+   {
+	*(long long *) cookie += n;
+	return n;
+   }
 
-/* If the element is a line, print the connectivity */
-/*  and do not write past the last set of nodes     */
+static int dry_seek(void *cookie, off64_t *offset, int whence)
+   {
+	*offset = dry_move(cookie, *offset, whence);
+	return (*offset < 0) ? -1 : 0;
+   }
+#else
+static int dry_write(void *cookie, const char *buf, int n)
+   {
+	*(long long *) cookie += n;
+	return n;
+   }
 
+static fpos_t dry_seek(void *cookie, fpos_t offset, int whence)
+   {
+	return dry_move(cookie, offset, whence);
+   }
+#endif
 
-	} else {
-          if (i < num_trials) {
-
-		  if (output == 1) {
-		    fprintf(fp_out, "%d   %d line ", 
-		    elem_ident, zone_num);
-		    for (j=0; j < 2; j++){
-		      fprintf(fp_out, "%4d", elements[j]);
-		      fprintf(fp_out, " ");
-                    }
-		    fprintf(fp_out, "\n");
-		  } 
-
-	       	  else if (output == 4) {
-		    fprintf(fp_out, "%d ", elem_ident); 
-		    for (j=0; j < 2; j++){
-		      fprintf(fp_out, "%4d", elements[j]);
-		      fprintf(fp_out, " ");
-                    }
-		    fprintf(fp_out, "\n");
-		  }
-	  }
-	}    
-
-/*--------------------------------*/
-/* Calculation of which zone current element is is. */
-/* If at end of x zone but not at end of line, increment zone number by 1. */
-			if (*xelems == (elem_ident - zone_elems))
-			   {
-				zone_elems = zone_elems + *xelems;
-				xelems++;
-/* If at end of line but not at end of y zone, decrease zone number by */
-/* number of x zones. */
-				if (num_xnodes - 1 == 
-					zone_elems-((num_xnodes-1)*(row-1)))
-				   {
-					xelems = xelems -(num_xregions);
-/* If at end of y zone but not at end of plane, increase zone number. */
-					if (row - zone_rows == *yelems)
-					   {
-						zone_rows = zone_rows + *yelems;
-						yelems++;
-/* If at end of plane but not at end of z zone, decrease zone number by */
-/* number of x zones times number of y zones. */
-						if(num_ynodes - 1 == zone_rows -
-							((num_ynodes - 1) * 
-								(plane - 1)))
-						   {
-/* If at end of z zone, increase zone number. */	yelems = yelems-
-								   num_yregions;
-							if(plane - zone_planes 
-								== *zelems)
-							   {
-								zone_num++;
-
-								zone_planes = 
-								   zone_planes +
-								   *zelems;
-
-								zelems++;
-							   } 
-							else 
-							   {
-								zone_num = 
-								 zone_num - 
-								 (num_xregions*
-								num_yregions)+1;	
-							   }
-							plane++;
-						   } 
-						else zone_num++;
-					   } 
-					else 
-					   {
-						zone_num = (zone_num - 
-							num_xregions) + 1;
-						
-					   }
-					row++;
-				   }
-				else zone_num++;
-			   }
-			elem_ident++;
+/******************************************************************************/
+/* FUNCTION: dry_open()							      */
+/* PURPOSE:  Opens a stream that only counts the bytes written to it, for   */
+/*           gridder_dry_run().  Seeking forward adds to the count too, so  */
+/*           ftello() is the size the file would have.  Returns NULL if it  */
+/*           cannot be opened.                                               */
+/******************************************************************************/
+static FILE *dry_open(void)
+   {
+#ifdef __GLIBC__
+	cookie_io_functions_t io = { NULL, dry_write, dry_seek, dry_close };
+#endif
+	long long *pos = calloc(1, sizeof(long long));
+	FILE *fp;
+
+	if (pos == NULL)
+		return NULL;
+#ifdef __GLIBC__
+	fp = fopencookie(pos, "w", io);
+#else
+	fp = funopen(pos, NULL, dry_write, dry_seek, dry_close);
+#endif
+	if (fp == NULL)
+		free(pos);
+	return fp;
+   }
 
-/* If current node is the last in its row, move to next row. */
+/******************************************************************************/
+/* FUNCTION: gridder_dry_run()						      */
+/* PURPOSE:  Works out the counts of a grid_spec and the exact size of the   */
+/*           file every output format would make, without writing any of    */
+/*           them.  The counts come from gridder_spec_size() and the region */
+/*           tables of grid, for gridder_zone_elems(), from the divisions;  */
+/*           no coordinates are calculated.  The writers run into a stream  */
+/*           that only counts: the headers add their lengths and each       */
+/*           section adds its size() (a few decades or regions at a time)   */
+/*           without a record being formatted.  A format whose ids or file  */
+/*           size do not fit is given a size of -1.  Sizes are before -z    */
+/*           compression.  Returns GRID_OK or a GRID_ERR_ value.             */
+/******************************************************************************/
+int gridder_dry_run(struct grid *grid, const struct grid_spec *spec, 
+		struct grid_size *size)
+   {
+	struct grid_spec s = *spec;
+	FILE *fp;
+	int o, error;
+
+	memset(size, 0, sizeof(*size));
+	s.output = OUTPUT_AVS;
+	s.compress = 0;
+	s.map = 0;
+	s.cache = NULL;
+	s.stats = NULL;
+	error = gridder_check_spec(&s);
+	if (error == GRID_OK)
+		error = gridder_spec_size(&s, &size->num_nodes, 
+			&size->num_elems);
+	if (error == GRID_OK)
+		error = grid_regions(grid, &s);
+	if (error != GRID_OK)
+		return error;
+	size->num_zones = (long long) grid->num_regions[AXIS_X] * 
+		grid->num_regions[AXIS_Y] * grid->num_regions[AXIS_Z];
+
+	for (o=OUTPUT_AVS; (o <= OUTPUT_LAST) && (error == GRID_OK); o++)
+	   {
+		s.output = o;
+		size->bytes[o] = -1;
+		/* Sizes past int64 are too large as well. */
+		if ((gridder_spec_size(&s, NULL, NULL) == GRID_ERR_TOO_LARGE) || 
+				(size->num_nodes > LLONG_MAX / DRY_MAX_RECORD - 
+				size->num_elems))
+			continue;
+		if ((fp = dry_open()) == NULL)
+			return GRID_ERR_MEMORY;
+		error = grid_write(grid, &s, fp, 1);
+		if (error == GRID_OK)
+			size->bytes[o] = ftello(fp);
+		else if (error == GRID_ERR_TOO_LARGE)
+			error = GRID_OK;
+		fclose(fp);
+	   }
+	return error;
+   }
 
-		   } else row_num++;
+/******************************************************************************/
+/* FUNCTION: gridder_error_string()					      */
+/* PURPOSE:  Returns a message for a GRID_ERR_ value.                        */
+/******************************************************************************/
+const char *gridder_error_string(int error)
+   {
+	switch (error)
+	   {
+	      case GRID_OK:
+		return "no error";
+	      case GRID_ERR_DIMENSION:
+		return "dimension option must be 1 to 7";
+	      case GRID_ERR_REGIONS:
+		return "each axis must have 1 to MAXZONES regions";
+	      case GRID_ERR_BOUNDS:
+		return "BEGIN coordinate should be less than END coordinate";
+	      case GRID_ERR_DIVISIONS:
+		return "number of divisions must be at least 0, and dx "
+			"greater than zero and less than the region length";
+	      case GRID_ERR_SPACING:
+		return "spacing must be 1, 2, 3 or 4";
+	      case GRID_ERR_GEOM_FACTOR:
+		return "geometric factor must be greater than 0";
+	      case GRID_ERR_TOO_MANY_NODES:
+		return "too many nodes in an axis";
+	      case GRID_ERR_TOO_MANY_ZONES:
+		return "too many zones in the grid";
+	      case GRID_ERR_OUTPUT:
+		return "output must be 1 to 8";
+	      case GRID_ERR_IO:
+		return "error writing grid file";
+	      case GRID_ERR_TOO_LARGE:
+		return "too many nodes or elements for the output format";
+	      case GRID_ERR_MEMORY:
+		return "out of memory";
+	      case GRID_ERR_INPUT:
+		return "could not read the grid description";
+	      case GRID_ERR_COMPRESS:
+		return "gridder was built without zlib (-DHAVE_ZLIB -lz)";
+	      default:
+		return "unknown error";
+	   }
+   }
 
-/* Move to next node. */
+/******************************************************************************/
+/* Timing of the phases of building a grid, see struct grid_stats.          */
+/******************************************************************************/
+
+static const char *stats_phase_name[GRID_NUM_PHASES] = { "coordinates",
+	"nodes", "zones", "connectivity" };
+
+/* Seconds on a clock, 0 if it cannot be read. */
+static double stats_clock(clockid_t clock)
+   {
+	struct timespec ts;
+
+	if (clock_gettime(clock, &ts) != 0)
+		return 0.0;
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+   }
+
+/******************************************************************************/
+/* FUNCTION: gridder_stats_init()					      */
+/* PURPOSE:  Zeroes a grid_stats, with no progress lines.                    */
+/******************************************************************************/
+void gridder_stats_init(struct grid_stats *stats)
+   {
+	memset(stats, 0, sizeof(*stats));
+	stats->progress = NULL;
+	stats->progress_interval = 5.0;
+   }
+
+/******************************************************************************/
+/* FUNCTION: gridder_stats_begin(), gridder_stats_end()			      */
+/* PURPOSE:  Start and stop the clocks of a phase.  The time in between is   */
+/*           added to the phase.  Both do nothing if stats is NULL.          */
+/******************************************************************************/
+void gridder_stats_begin(struct grid_stats *stats, int phase)
+   {
+	if (stats == NULL)
+		return;
+	stats->wall_start[phase] = stats_clock(CLOCK_MONOTONIC);
+	stats->cpu_start[phase] = stats_clock(CLOCK_PROCESS_CPUTIME_ID);
+	stats->last_progress = stats->wall_start[phase];
+   }
+
+void gridder_stats_end(struct grid_stats *stats, int phase)
+   {
+	struct rusage ru;
+
+	if (stats == NULL)
+		return;
+	stats->wall[phase] += stats_clock(CLOCK_MONOTONIC) - 
+		stats->wall_start[phase];
+	stats->cpu[phase] += stats_clock(CLOCK_PROCESS_CPUTIME_ID) - 
+		stats->cpu_start[phase];
+	if ((getrusage(RUSAGE_SELF, &ru) == 0) && 
+			(ru.ru_maxrss > stats->peak_rss_kb))
+		stats->peak_rss_kb = ru.ru_maxrss;
+   }
+
+/******************************************************************************/
+/* FUNCTION: gridder_stats_print()					      */
+/* PURPOSE:  Prints a table of the phases to fp, usually stderr.             */
+/******************************************************************************/
+void gridder_stats_print(const struct grid_stats *stats, FILE *fp)
+   {
+	double wall = 0.0, cpu = 0.0;
+	long long bytes = 0;
+	int p;
+
+	fprintf(fp, "%-14s %10s %10s %14s %14s %10s\n", "phase", "wall s", 
+		"cpu s", "records", "bytes", "MB/s");
+	for (p=0; p < GRID_NUM_PHASES; p++)
+	   {
+		fprintf(fp, "%-14s %10.3f %10.3f %14lld %14lld %10.1f\n", 
+			stats_phase_name[p], stats->wall[p], stats->cpu[p], 
+			stats->records[p], stats->bytes[p], (stats->wall[p] > 0) ?
+			stats->bytes[p] / stats->wall[p] / 1e6 : 0.0);
+		wall = wall + stats->wall[p];
+		cpu = cpu + stats->cpu[p];
+		bytes = bytes + stats->bytes[p];
+	   }
+	fprintf(fp, "%-14s %10.3f %10.3f %14s %14lld %10.1f\n", "total", wall,
+		cpu, "", bytes, (wall > 0) ? bytes / wall / 1e6 : 0.0);
+	fprintf(fp, "peak memory %ld kB\n", stats->peak_rss_kb);
+   }
+
+/******************************************************************************/
+/* FUNCTION: gridder_stats_json()					      */
+/* PURPOSE:  Writes the phases to fp as a JSON object.  Returns GRID_OK or  */
+/*           GRID_ERR_IO.                                                    */
+/******************************************************************************/
+int gridder_stats_json(const struct grid_stats *stats, FILE *fp)
+   {
+	double wall = 0.0, cpu = 0.0;
+	long long bytes = 0;
+	int p;
+
+	fprintf(fp, "{\n  \"phases\": {\n");
+	for (p=0; p < GRID_NUM_PHASES; p++)
+	   {
+		fprintf(fp, "    \"%s\": {\"wall_s\": %.6f, \"cpu_s\": %.6f, "
+			"\"records\": %lld, \"bytes\": %lld}%s\n", 
+			stats_phase_name[p], stats->wall[p], stats->cpu[p], 
+			stats->records[p], stats->bytes[p], 
+			(p < GRID_NUM_PHASES - 1) ? "," : "");
+		wall = wall + stats->wall[p];
+		cpu = cpu + stats->cpu[p];
+		bytes = bytes + stats->bytes[p];
+	   }
+	fprintf(fp, "  },\n  \"wall_s\": %.6f,\n  \"cpu_s\": %.6f,\n"
+		"  \"bytes\": %lld,\n  \"mb_per_s\": %.3f,\n"
+		"  \"peak_rss_kb\": %ld\n}\n", wall, cpu, bytes, 
+		(wall > 0) ? bytes / wall / 1e6 : 0.0, stats->peak_rss_kb);
+	return (fflush(fp) != 0 || ferror(fp)) ? GRID_ERR_IO : GRID_OK;
+   }
+
+/******************************************************************************/
+/* FUNCTION: out_phase_begin(), out_phase_end()				      */
+/* PURPOSE:  Time a phase of writing a grid and add up what it wrote: the    */
+/*           change in file position, or for a pipe the bytes the sections  */
+/*           reported, and the records given.                                */
+/******************************************************************************/
+static void out_phase_begin(struct grid_out *out, int phase)
+   {
+	out->phase = phase;
+	out->bytes = 0;
+	out->phase_start = -1;
+	if (out->stats == NULL)
+		return;
+	if ((out->fp != NULL) && (fflush(out->fp) == 0))
+		out->phase_start = ftello(out->fp);
+	gridder_stats_begin(out->stats, phase);
+   }
+
+static void out_phase_end(struct grid_out *out, long long records)
+   {
+	off_t pos = -1;
+
+	if (out->stats == NULL)
+		return;
+	if ((out->fp != NULL) && (fflush(out->fp) == 0))
+		pos = ftello(out->fp);
+	gridder_stats_end(out->stats, out->phase);
+	out->stats->bytes[out->phase] += ((out->phase_start >= 0) && 
+		(pos >= 0)) ? pos - out->phase_start : out->bytes;
+	out->stats->records[out->phase] += records;
+   }
+
+/******************************************************************************/
+/* FUNCTION: out_skip()							      */
+/* PURPOSE:  Moves a dry run past bytes it does not write, see              */
+/*           gridder_dry_run().  Returns GRID_OK or GRID_ERR_IO.             */
+/******************************************************************************/
+static int out_skip(struct grid_out *out, long long bytes)
+   {
+	out->bytes = out->bytes + bytes;
+	return (fseeko(out->fp, bytes, SEEK_CUR) != 0) ? GRID_ERR_IO : GRID_OK;
+   }
+
+/******************************************************************************/
+/* Output buffer used by the writers.  Records are formatted straight into   */
+/* a large buffer that is written with fwrite() in big blocks, instead of    */
+/* one fprintf() per node.  A buffer may also be a block of memory that is   */
+/* filled by one thread and written later (see write_section()).             */
+/******************************************************************************/
+
+/* Size of the output buffer. */
+#define GRID_BUF_SIZE (1 << 22)
+
+/* Width of a coordinate written with %20.12g.  The longest value    */
+/* %.12g can produce is 19 characters (-1.23456789012e-308), so the  */
+/* field is always padded to exactly 20.                             */
+#define COORD_WIDTH 20
+
+/* Longest record the writers ask the buffer for at one time. */
+#define GRID_BUF_RECORD 256
+
+/* Records in each chunk of a section written by several threads. */
+#define CHUNK_RECORDS (1 << 16)
+
+struct grid_buf {
+	FILE *fp;
+		/* File the buffer is flushed to, NULL for a memory block. */
+	char *buf;
+	size_t len;
+	size_t size;
+	long long flushed;
+		/* Bytes written to the file so far. */
+	int error;
+		/* Set if a memory block overflowed. */
+	char small[GRID_BUF_RECORD * 16];
+		/* Used if the large buffer cannot be allocated. */
+};
+
+/* A section of the grid file made of count records, such as the node  */
+/* coordinates or the connectivity.  write() formats records first ... */
+/* first+count-1 (from 0) into a buffer, and size() returns exactly    */
+/* how many bytes write() will produce for them.  Binary sections have */
+/* records of a fixed record_size and no size().                       */
+struct grid_section {
+	const void *ctx;
+	long long count;
+	long long (*size)(const void *ctx, long long first, long long count);
+	long long record_size;
+	void (*write)(const void *ctx, long long first, long long count,
+		struct grid_buf *b);
+};
+
+/******************************************************************************/
+/* FUNCTION: grid_buf_open()						      */
+/* PURPOSE:  Sets up an output buffer for fp.                                */
+/******************************************************************************/
+static void grid_buf_open(struct grid_buf *b, FILE *fp)
+   {
+	b->fp = fp;
+	b->len = 0;
+	b->flushed = 0;
+	b->error = 0;
+	b->buf = malloc(GRID_BUF_SIZE);
+	if (b->buf != NULL)
+		b->size = GRID_BUF_SIZE;
+	else
+	   {
+		b->buf = b->small;
+		b->size = sizeof(b->small);
+	   }
+   }
+
+/******************************************************************************/
+/* FUNCTION: grid_buf_mem()						      */
+/* PURPOSE:  Sets up a buffer that fills the memory block mem, which must    */
+/*           have GRID_BUF_RECORD bytes to spare after the records.          */
+/******************************************************************************/
+static void grid_buf_mem(struct grid_buf *b, char *mem, size_t size)
+   {
+	b->fp = NULL;
+	b->buf = mem;
+	b->len = 0;
+	b->size = size;
+	b->flushed = 0;
+	b->error = 0;
+   }
+
+/******************************************************************************/
+/* FUNCTION: grid_buf_flush()						      */
+/* PURPOSE:  Writes the buffered records to the file.  Errors are left in    */
+/*           the FILE for ferror().                                          */
+/******************************************************************************/
+static void grid_buf_flush(struct grid_buf *b)
+   {
+	if (b->fp == NULL)
+	   {
+		/* A memory block should never fill up. */
+		b->error = 1;
+		b->len = 0;
+		return;
+	   }
+	if (b->len > 0)
+		fwrite(b->buf, 1, b->len, b->fp);
+	b->flushed = b->flushed + b->len;
+	b->len = 0;
+   }
+
+/******************************************************************************/
+/* FUNCTION: grid_buf_close()						      */
+/* PURPOSE:  Flushes and releases an output buffer.                          */
+/******************************************************************************/
+static void grid_buf_close(struct grid_buf *b)
+   {
+	if (b->fp == NULL)
+		return;
+	grid_buf_flush(b);
+	if (b->buf != b->small)
+		free(b->buf);
+	b->buf = NULL;
+   }
+
+/******************************************************************************/
+/* FUNCTION: grid_buf_reserve()						      */
+/* PURPOSE:  Returns room for a record of up to GRID_BUF_RECORD characters.  */
+/*           The caller adds the number of characters used to b->len.        */
+/******************************************************************************/
+static char *grid_buf_reserve(struct grid_buf *b)
+   {
+	if (b->len + GRID_BUF_RECORD > b->size)
+		grid_buf_flush(b);
+	return b->buf + b->len;
+   }
+
+/******************************************************************************/
+/* FUNCTION: format_int()						      */
+/* PURPOSE:  Writes value into s as %-<width>d (left > 0), %<width>d         */
+/*           (left == 0).  Returns the number of characters written.         */
+/******************************************************************************/
+static int format_int(char *s, long long value, int width, int left)
+   {
+	char digits[24];
+	unsigned long long v;
+	int n = 0, len, i;
+
+	v = (value < 0) ? 0ull - (unsigned long long) value : 
+		(unsigned long long) value;
+	do {
+		digits[n++] = '0' + (v % 10);
+		v = v / 10;
+	   } while (v > 0);
+	if (value < 0)
+		digits[n++] = '-';
+
+	len = 0;
+	if (!left)
+		for (; len < width - n; len++)
+			s[len] = ' ';
+	for (i=n-1; i >= 0; i--)
+		s[len++] = digits[i];
+	if (left)
+		for (; len < width; len++)
+			s[len] = ' ';
+	return len;
+   }
+
+/******************************************************************************/
+/* FUNCTION: num_digits()						      */
+/* PURPOSE:  Returns the number of digits in value >= 0.                     */
+/******************************************************************************/
+static int num_digits(long long value)
+   {
+	int n = 1;
+
+	while (value >= 10)
+	   {
+		value = value / 10;
+		n++;
+	   }
+	return n;
+   }
+
+/******************************************************************************/
+/* FUNCTION: put_le64(), put_le32()					      */
+/* PURPOSE:  Store an integer in little-endian byte order at p, whatever     */
+/*           the byte order of the machine.                                  */
+/******************************************************************************/
+static void put_le64(char *p, long long value)
+   {
+	unsigned long long v = (unsigned long long) value;
+	int n;
+
+	for (n=0; n < 8; n++, v = v >> 8)
+		p[n] = (char) (v & 0xff);
+   }
+
+static void put_le32(char *p, int value)
+   {
+	unsigned int v = (unsigned int) value;
+	int n;
+
+	for (n=0; n < 4; n++, v = v >> 8)
+		p[n] = (char) (v & 0xff);
+   }
+
+/* A double as little-endian IEEE 754 float64. */
+static void put_le_double(char *p, double value)
+   {
+	long long bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	put_le64(p, bits);
+   }
+
+/******************************************************************************/
+/* FUNCTION: digits_sum()						      */
+/* PURPOSE:  Returns the total width of the integers lo ... hi (>= 0) each   */
+/*           written with %<width>d, counting the decades they cover         */
+/*           instead of every value.                                         */
+/******************************************************************************/
+static long long digits_sum(long long lo, long long hi, int width)
+   {
+	long long total = 0;
+	long long start, end;
+	int d;
+
+	if (hi < lo)
+		return 0;
+
+	/* Values with d digits are 10^(d-1) ... 10^d - 1. */
+	start = lo;
+	for (d=num_digits(lo); start <= hi; d++)
+	   {
+		end = hi;
+		if (d < 19)
+		   {
+			long long p = 1;
+			int n;
+			for (n=0; n < d; n++)
+				p = p * 10;
+			if (p - 1 < hi)
+				end = p - 1;
+		   }
+		total = total + (end - start + 1) * ((d > width) ? d : width);
+		start = end + 1;
+	   }
+	return total;
+   }
+
+/******************************************************************************/
+/* Sizes of whole sections in constant time.  The records of a section are  */
+/* an n[0] by n[1] by n[2] array, x fastest, and a value written in each    */
+/* only grows a digit at a decade or a region.  So the records of first ... */
+/* last-1 past each decade are counted as a few boxes of the array instead  */
+/* of a row of x at a time, which a dry run of a big grid cannot afford.    */
+/******************************************************************************/
+
+/* The part of 0 ... end-1 inside lo ... hi-1. */
+static long long span(long long end, long long lo, long long hi)
+   {
+	if (lo < 0)
+		lo = 0;
+	if (hi > end)
+		hi = end;
+	return (hi > lo) ? hi - lo : 0;
+   }
+
+/******************************************************************************/
+/* FUNCTION: box_before(), box_count()					      */
+/* PURPOSE:  The number of records inside lo[a] ... hi[a]-1 along every     */
+/*           axis a, of the first r records of the n array or of records    */
+/*           first ... last-1.                                               */
+/******************************************************************************/
+static long long box_before(const int n[3], long long r, 
+		const long long lo[3], const long long hi[3])
+   {
+	long long row = r / n[0], count;
+	int i = r % n[0], j = row % n[1], k = row / n[1];
+
+	/* Whole planes, whole rows of plane k, then row j up to i. */
+	count = span(k, lo[2], hi[2]) * span(n[1], lo[1], hi[1]) * 
+		span(n[0], lo[0], hi[0]);
+	if ((k >= lo[2]) && (k < hi[2]))
+		count = count + span(j, lo[1], hi[1]) * 
+			span(n[0], lo[0], hi[0]) + (((j >= lo[1]) && 
+			(j < hi[1])) ? span(i, lo[0], hi[0]) : 0);
+	return count;
+   }
+
+static long long box_count(const int n[3], long long first, long long last,
+		const long long lo[3], const long long hi[3])
+   {
+	return box_before(n, last, lo, hi) - box_before(n, first, lo, hi);
+   }
+
+/******************************************************************************/
+/* FUNCTION: cut_count()						      */
+/* PURPOSE:  Of records first ... last-1 of the n array, the number before   */
+/*           a cut: those with k below lo[2], or k inside lo[2] ... hi[2]-1  */
+/*           and j below lo[1], or j inside lo[1] ... hi[1]-1 as well and i  */
+/*           below lo[0].                                                    */
+/******************************************************************************/
+static long long cut_count(const int n[3], long long first, long long last,
+		const long long lo[3], const long long hi[3])
+   {
+	long long blo[3] = { 0, 0, 0 };
+	long long bhi[3];
+	long long count;
+
+	bhi[0] = n[0];
+	bhi[1] = n[1];
+	bhi[2] = lo[2];
+	count = box_count(n, first, last, blo, bhi);
+	blo[2] = lo[2];
+	bhi[2] = hi[2];
+	bhi[1] = lo[1];
+	count = count + box_count(n, first, last, blo, bhi);
+	blo[1] = lo[1];
+	bhi[1] = hi[1];
+	bhi[0] = lo[0];
+	return count + box_count(n, first, last, blo, bhi);
+   }
+
+/******************************************************************************/
+/* FUNCTION: strided_digits()						      */
+/* PURPOSE:  Total width of base + i + j*sy + k*sz for records first ...     */
+/*           last-1 of the n array, each written with %<width>d.  The steps  */
+/*           must keep the order of the records, n[0] <= sy and              */
+/*           n[1]*sy <= sz, as for node numbers.                             */
+/******************************************************************************/
+static long long strided_digits(const int n[3], long long first, 
+		long long last, long long base, long long sy, long long sz, 
+		int width)
+   {
+	long long lo[3], hi[3] = { 0, 0, 0 };
+	long long total, t, p = 1;
+	int d;
+
+	if (width < 1)
+		width = 1;
+	total = (last - first) * width;
+
+	/* One more digit for each value past 10^d, d >= width. */
+	for (d=1; d < 19; d++)
+	   {
+		p = p * 10;
+		if (d < width)
+			continue;
+		t = p - base;
+		if (t <= 0)
+		   {
+			total = total + last - first;
+			continue;
+		   }
+		lo[2] = t / sz;
+		lo[1] = (t % sz) / sy;
+		lo[0] = (t % sz) % sy;
+		hi[2] = lo[2] + 1;
+		hi[1] = lo[1] + 1;
+		total = total + last - first - 
+			cut_count(n, first, last, lo, hi);
+	   }
+	return total;
+   }
+
+/******************************************************************************/
+/* FUNCTION: region_digits()						      */
+/* PURPOSE:  Total width of the region (from 1) along axis a of records    */
+/*           first ... last-1 of the n array.  The records start at index   */
+/*           origin of a region start table, whose last region also holds  */
+/*           the index at its end, the last node.                            */
+/******************************************************************************/
+static long long region_digits(const int n[3], long long first, 
+		long long last, int a, const int *start, int num_regions, 
+		int origin)
+   {
+	long long lo[3] = { 0, 0, 0 };
+	long long hi[3];
+	long long total = last - first, p;
+
+	hi[0] = n[0];
+	hi[1] = n[1];
+	hi[2] = n[2];
+	/* One more digit for each region from 10^d - 1 (from 0) on. */
+	for (p=10; p - 1 < num_regions; p = p * 10)
+	   {
+		hi[a] = start[p - 1] - origin;
+		total = total + last - first - 
+			box_count(n, first, last, lo, hi);
+	   }
+	return total;
+   }
+
+/******************************************************************************/
+/* FUNCTION: zone_digits()						      */
+/* PURPOSE:  Total width of the zone of records first ... last-1 of the n   */
+/*           array, with the region tables of region_digits().  Zones are   */
+/*           numbered x region fastest, so the records below a zone are a   */
+/*           cut.                                                            */
+/******************************************************************************/
+static long long zone_digits(const int n[3], long long first, 
+		long long last, const int *const start[3], 
+		const int num_regions[3], const int origin[3])
+   {
+	long long lo[3], hi[3];
+	long long total = last - first, t, p, num_zones;
+	int a, r;
+
+	num_zones = (long long) num_regions[0] * num_regions[1] * 
+		num_regions[2];
+	/* One more digit for each zone from 10^d (from 1) on. */
+	for (p=10; p <= num_zones; p = p * 10)
+	   {
+		for (a=0, t=p - 1; a < 3; a++)
+		   {
+			r = t % num_regions[a];
+			t = t / num_regions[a];
+			lo[a] = start[a][r] - origin[a];
+			hi[a] = (r == num_regions[a] - 1) ? n[a] : 
+				start[a][r + 1] - origin[a];
+		   }
+		total = total + last - first - 
+			cut_count(n, first, last, lo, hi);
+	   }
+	return total;
+   }
+
+/******************************************************************************/
+/* FUNCTION: run_threads()						      */
+/* PURPOSE:  Calls work(arg, item, thread) for item = 0 ... num_items-1,     */
+/*           handing the items out in order to num_threads threads.  The     */
+/*           calling thread is thread 0.  thread is between 0 and            */
+/*           num_threads-1 so work() can keep a buffer for each thread.      */
+/******************************************************************************/
+struct thread_job {
+	void (*work)(void *arg, long long item, int thread);
+	void *arg;
+	long long num_items;
+	long long next_item;
+	pthread_mutex_t lock;
+};
+
+struct thread_arg {
+	struct thread_job *job;
+	int thread;
+};
+
+static void *thread_main(void *p)
+   {
+	struct thread_arg *t = p;
+	struct thread_job *job = t->job;
+	long long item;
+
+	for (;;)
+	   {
+		pthread_mutex_lock(&job->lock);
+		item = job->next_item++;
+		pthread_mutex_unlock(&job->lock);
+		if (item >= job->num_items)
+			break;
+		job->work(job->arg, item, t->thread);
+	   }
+	return NULL;
+   }
+
+static void run_threads(int num_threads, long long num_items,
+		void (*work)(void *arg, long long item, int thread), void *arg)
+   {
+	struct thread_job job;
+	struct thread_arg *targ;
+	pthread_t *tid;
+	int *started;
+	int t;
+
+	job.work = work;
+	job.arg = arg;
+	job.num_items = num_items;
+	job.next_item = 0;
+	pthread_mutex_init(&job.lock, NULL);
+
+	targ = malloc(num_threads * sizeof(*targ));
+	tid = malloc(num_threads * sizeof(*tid));
+	started = calloc(num_threads, sizeof(*started));
+	if ((targ == NULL) || (tid == NULL) || (started == NULL))
+		num_threads = 1;
+
+	/* If a thread cannot be started the others do its share. */
+	for (t=1; t < num_threads; t++)
+	   {
+		targ[t].job = &job;
+		targ[t].thread = t;
+		started[t] = (pthread_create(&tid[t], NULL, thread_main, 
+			&targ[t]) == 0);
+	   }
+	   {
+		struct thread_arg self;
+		self.job = &job;
+		self.thread = 0;
+		thread_main(&self);
+	   }
+	for (t=1; t < num_threads; t++)
+		if (started[t])
+			pthread_join(tid[t], NULL);
+
+	pthread_mutex_destroy(&job.lock);
+	free(targ);
+	free(tid);
+	free(started);
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_section()						      */
+/* PURPOSE:  Writes a section of the grid file.  With more than one thread   */
+/*           the records are split into chunks.  The byte offset of every    */
+/*           chunk is worked out first from section->size(), then each       */
+/*           thread formats a chunk into its own buffer and writes it in     */
+/*           place with pwrite().  If the file cannot be written in place    */
+/*           (a pipe), the chunks are written in order as they finish.       */
+/*           With out->map the section is allocated in the file and mapped,  */
+/*           and the chunks are formatted straight into the mapping.         */
+/*           Either way the file is the same as with one thread.             */
+/*           Returns GRID_OK or a GRID_ERR_ value.                           */
+/******************************************************************************/
+struct section_job {
+	const struct grid_section *sec;
+	FILE *fp;
+	int fd;
+	off_t base;
+	int ordered;
+		/* Write the chunks in order with fwrite() instead of pwrite(). */
+	long long num_chunks;
+	long long *offset;
+		/* Byte offset of each chunk from base, offset[num_chunks] */
+		/* is the size of the section.                            */
+	char **buf;
+	size_t *buf_size;
+		/* Buffer of each thread. */
+	char *map;
+	size_t map_len;
+	off_t map_skip;
+		/* Mapping of the section, which starts map_skip bytes in. */
+	long long next_write;
+	pthread_mutex_t lock;
+	pthread_cond_t turn;
+	int error;
+	struct grid_out *out;
+	double start;
+	long long done, done_bytes;
+		/* Records and bytes written so far, for progress lines. */
+};
+
+/******************************************************************************/
+/* FUNCTION: section_progress()						      */
+/* PURPOSE:  Prints a progress line for a section with done of count        */
+/*           records and bytes written since start, if progress lines are   */
+/*           wanted and the last one was long enough ago.                    */
+/******************************************************************************/
+static void section_progress(struct grid_out *out, long long done, 
+		long long count, long long bytes, double start)
+   {
+	struct grid_stats *stats = out->stats;
+	double now, rate, eta;
+
+	if ((stats == NULL) || (stats->progress == NULL))
+		return;
+	now = stats_clock(CLOCK_MONOTONIC);
+	if (now - stats->last_progress < stats->progress_interval)
+		return;
+	stats->last_progress = now;
+
+	rate = (now > start) ? done / (now - start) : 0.0;
+	eta = (rate > 0) ? (count - done) / rate : 0.0;
+	fprintf(stats->progress, "gridder: %s %5.1f%% %lld/%lld records, "
+		"%.3g records/s, %.1f MB/s, ETA %d:%02d:%02d\n", 
+		stats_phase_name[out->phase], 100.0 * done / count, done, count,
+		rate, (now > start) ? bytes / (now - start) / 1e6 : 0.0, 
+		(int) (eta / 3600), (int) (eta / 60) % 60, (int) eta % 60);
+	fflush(stats->progress);
+   }
+
+static void section_chunk(void *arg, long long chunk, int thread)
+   {
+	struct section_job *job = arg;
+	const struct grid_section *sec = job->sec;
+	long long first = chunk * CHUNK_RECORDS;
+	long long count = sec->count - first;
+	size_t need = job->offset[chunk + 1] - job->offset[chunk];
+	size_t done;
+	ssize_t n;
+	struct grid_buf b;
+	char *mem;
+	int error = GRID_OK;
+
+	if (count > CHUNK_RECORDS)
+		count = CHUNK_RECORDS;
+
+	/* The records are exactly need bytes, so the spare room */
+	/* grid_buf_mem() asks for is never written in a mapping. */
+	if (job->map != NULL)
+		mem = job->map + job->map_skip + job->offset[chunk];
+	else
+	   {
+		if (job->buf_size[thread] < need + GRID_BUF_RECORD)
+		   {
+			free(job->buf[thread]);
+			job->buf_size[thread] = need + GRID_BUF_RECORD;
+			job->buf[thread] = malloc(job->buf_size[thread]);
+			if (job->buf[thread] == NULL)
+				job->buf_size[thread] = 0;
+		   }
+		mem = job->buf[thread];
+	   }
+
+	if (mem == NULL)
+		error = GRID_ERR_MEMORY;
+	else
+	   {
+		grid_buf_mem(&b, mem, need + GRID_BUF_RECORD);
+		sec->write(sec->ctx, first, count, &b);
+		if (b.error || (b.len != need))
+			error = GRID_ERR_IO;
+	   }
+
+	if (job->map != NULL)
+		pthread_mutex_lock(&job->lock);
+	else if (!job->ordered)
+	   {
+		for (done=0; (error == GRID_OK) && (done < need); done += n)
+		   {
+			n = pwrite(job->fd, mem + done, need - done,
+				job->base + job->offset[chunk] + done);
+			if ((n < 0) && (errno == EINTR))
+				n = 0;
+			else if (n <= 0)
+				error = GRID_ERR_IO;
+		   }
+		pthread_mutex_lock(&job->lock);
+	   }
+	else
+	   {
+		pthread_mutex_lock(&job->lock);
+		while (job->next_write != chunk)
+			pthread_cond_wait(&job->turn, &job->lock);
+		if ((error == GRID_OK) && (job->error == GRID_OK) &&
+				(fwrite(mem, 1, need, job->fp) != need))
+			error = GRID_ERR_IO;
+		job->next_write++;
+		pthread_cond_broadcast(&job->turn);
+	   }
+	if (error != GRID_OK)
+		job->error = error;
+	job->done = job->done + count;
+	job->done_bytes = job->done_bytes + need;
+	section_progress(job->out, job->done, sec->count, job->done_bytes, 
+		job->start);
+	pthread_mutex_unlock(&job->lock);
+   }
+
+/******************************************************************************/
+/* FUNCTION: section_map()						      */
+/* PURPOSE:  Allocates the space of a section in the file and maps it.       */
+/*           The allocation makes a full disk an error here rather than a    */
+/*           SIGBUS while the mapping is filled.  Leaves job->map NULL if    */
+/*           either cannot be done (a file opened "w" instead of "w+"), and  */
+/*           the section is written with pwrite().                           */
+/******************************************************************************/
+static void section_map(struct section_job *job)
+   {
+	long long size = job->offset[job->num_chunks];
+	long page = sysconf(_SC_PAGESIZE);
+	off_t start;
+	void *map;
+
+	job->map = NULL;
+	if ((size <= 0) || (page <= 0))
+		return;
+	start = job->base - job->base % page;
+	if (posix_fallocate(job->fd, job->base, size) != 0)
+		return;
+	map = mmap(NULL, job->base - start + size, PROT_READ | PROT_WRITE,
+		MAP_SHARED, job->fd, start);
+	if (map == MAP_FAILED)
+		return;
+	job->map = map;
+	job->map_len = job->base - start + size;
+	job->map_skip = job->base - start;
+   }
+
+static int write_section(struct grid_out *out, const struct grid_section *sec)
+   {
+	struct section_job job;
+	struct grid_buf b;
+	struct stat st;
+	long long c, first, count;
+	int t, num_threads = out->num_threads;
+	double start = stats_clock(CLOCK_MONOTONIC);
+
+	if (sec->count <= 0)
+		return GRID_OK;
+
+	/* A dry run only moves past the section. */
+	if (out->dry)
+	   {
+		c = (sec->size != NULL) ? sec->size(sec->ctx, 0, sec->count) :
+			sec->count * sec->record_size;
+		return out_skip(out, c);
+	   }
+
+	fflush(out->fp);
+
+	/* One thread, a chunk at a time so progress can be shown. */
+	if (((num_threads <= 1) || (sec->count <= CHUNK_RECORDS)) && !out->map)
+	   {
+		grid_buf_open(&b, out->fp);
+		for (first=0; first < sec->count; first += count)
+		   {
+			count = sec->count - first;
+			if (count > CHUNK_RECORDS)
+				count = CHUNK_RECORDS;
+			sec->write(sec->ctx, first, count, &b);
+			section_progress(out, first + count, sec->count, 
+				b.flushed + b.len, start);
+		   }
+		grid_buf_close(&b);
+		out->bytes = out->bytes + b.flushed;
+		return ferror(out->fp) ? GRID_ERR_IO : GRID_OK;
+	   }
+
+	job.sec = sec;
+	job.fp = out->fp;
+	job.fd = fileno(out->fp);
+	job.ordered = 1;
+	job.base = 0;
+	if ((fstat(job.fd, &st) == 0) && S_ISREG(st.st_mode))
+	   {
+		job.base = ftello(out->fp);
+		if (job.base >= 0)
+			job.ordered = 0;
+	   }
+
+	/* Byte offset of every chunk. */
+	job.num_chunks = (sec->count + CHUNK_RECORDS - 1) / CHUNK_RECORDS;
+	job.offset = malloc((job.num_chunks + 1) * sizeof(long long));
+	job.buf = calloc(num_threads, sizeof(char *));
+	job.buf_size = calloc(num_threads, sizeof(size_t));
+	if ((job.offset == NULL) || (job.buf == NULL) || (job.buf_size == NULL))
+	   {
+		free(job.offset);
+		free(job.buf);
+		free(job.buf_size);
+		return GRID_ERR_MEMORY;
+	   }
+	job.offset[0] = 0;
+	for (c=0; c < job.num_chunks; c++)
+	   {
+		first = c * CHUNK_RECORDS;
+		count = sec->count - first;
+		if (count > CHUNK_RECORDS)
+			count = CHUNK_RECORDS;
+		if (sec->size != NULL)
+			job.offset[c + 1] = job.offset[c] + 
+				sec->size(sec->ctx, first, count);
+		else
+			job.offset[c + 1] = job.offset[c] + 
+				count * sec->record_size;
+	   }
+
+	job.map = NULL;
+	if (!job.ordered && out->map)
+		section_map(&job);
+
+	job.next_write = 0;
+	job.error = GRID_OK;
+	job.out = out;
+	job.start = start;
+	job.done = 0;
+	job.done_bytes = 0;
+	pthread_mutex_init(&job.lock, NULL);
+	pthread_cond_init(&job.turn, NULL);
+
+	run_threads(num_threads, job.num_chunks, section_chunk, &job);
+
+	pthread_cond_destroy(&job.turn);
+	pthread_mutex_destroy(&job.lock);
+	if ((job.map != NULL) && (munmap(job.map, job.map_len) != 0))
+		job.error = GRID_ERR_IO;
+
+	/* Leave the file positioned after the section. */
+	if (!job.ordered && 
+		(fseeko(out->fp, job.base + job.offset[job.num_chunks], 
+			SEEK_SET) != 0))
+		job.error = GRID_ERR_IO;
+
+	out->bytes = out->bytes + job.offset[job.num_chunks];
+	for (t=0; t < num_threads; t++)
+		free(job.buf[t]);
+	free(job.buf);
+	free(job.buf_size);
+	free(job.offset);
+	return job.error;
+   }
+
+/******************************************************************************/
+/* Batches.  gridder_batch() builds a list of grids on a pool of threads,   */
+/* each into its own file.  The coordinates of an axis are calculated once  */
+/* for every axis spec that differs from the others, and the grids that     */
+/* share it point their struct grid at the same arrays.                     */
+/******************************************************************************/
+
+/* An axis spec of the batch and its coordinates, in grid.coords[axis]. */
+struct batch_axis {
+	const struct grid_axis_spec *axis_spec;
+	const struct grid_spec *spec;
+	int axis;
+	struct grid grid;
+	int error;
+};
+
+struct batch {
+	struct grid_batch_job *job;
+	int *order;
+		/* Jobs, biggest first. */
+	struct batch_axis *axis;
+	int num_axes;
+	int *job_axis;
+		/* batch.axis[] entry of each axis of each job, -1 if unused. */
+	struct grid unused;
+		/* An axis that is not used. */
+};
+
+/* Whether two axis specs give the same coordinates. */
+static int same_axis(const struct grid_axis_spec *a, 
+		const struct grid_axis_spec *b)
+   {
+	const struct grid_region *ra, *rb;
+	int r;
+
+	if ((a->begin != b->begin) || (a->num_regions != b->num_regions))
+		return 0;
+	for (r=0; r < a->num_regions; r++)
+	   {
+		ra = &a->region[r];
+		rb = &b->region[r];
+		if ((ra->end != rb->end) || 
+				(ra->num_divisions != rb->num_divisions) || 
+				(ra->spacing != rb->spacing) || 
+				((ra->num_divisions == 0) && (ra->dx != rb->dx)) || 
+				((ra->spacing == SPACING_GEOMETRIC) && 
+				(ra->geom_factor != rb->geom_factor)))
+			return 0;
+	   }
+	return 1;
+   }
+
+/* Points axis a of grid at axis b of from, without copying. */
+static void share_axis(struct grid *grid, int a, const struct grid *from, 
+		int b)
+   {
+	grid->num_nodes[a] = from->num_nodes[b];
+	grid->num_regions[a] = from->num_regions[b];
+	grid->num_elems_per_region[a] = from->num_elems_per_region[b];
+	grid->region_start[a] = from->region_start[b];
+	grid->coords[a] = from->coords[b];
+	grid->max_nodes[a] = from->max_nodes[b];
+	grid->max_regions[a] = from->max_regions[b];
+   }
+
+static void batch_axis_work(void *arg, long long item, int thread)
+   {
+	struct batch *b = arg;
+	struct batch_axis *ba = &b->axis[item];
+
+	ba->error = gridder_grid_init(&ba->grid);
+	if (ba->error == GRID_OK)
+	   {
+		ba->error = gridder_axis_coords(&ba->grid, ba->spec, ba->axis);
+		if (ba->error > 0)
+			ba->error = GRID_OK;
+	   }
+   }
+
+static void batch_job_work(void *arg, long long item, int thread)
+   {
+	struct batch *b = arg;
+	struct grid_batch_job *job = &b->job[b->order[item]];
+	struct batch_axis *ba;
+	struct grid_spec spec;
+	struct grid grid;
+	FILE *fp;
+	off_t size;
+	double t;
+	int a;
+
+	t = stats_clock(CLOCK_MONOTONIC);
+	memset(&grid, 0, sizeof(grid));
+	grid.num_elems = 1;
+	for (a=0; a < 3; a++)
+	   {
+		if (b->job_axis[3 * b->order[item] + a] < 0)
+		   {
+			share_axis(&grid, a, &b->unused, a);
+			continue;
+		   }
+		ba = &b->axis[b->job_axis[3 * b->order[item] + a]];
+		if (ba->error != GRID_OK)
+		   {
+			job->error = ba->error;
+			return;
+		   }
+		share_axis(&grid, a, &ba->grid, ba->axis);
+		grid.num_elems = grid.num_elems * (grid.num_nodes[a] - 1);
+	   }
+
+	if ((fp = fopen(job->path, "w+")) == NULL)
+	   {
+		job->error = GRID_ERR_IO;
+		return;
+	   }
+	/* A grid_stats is not shared between threads. */
+	spec = job->spec;
+	spec.stats = NULL;
+	job->error = gridder_write(&grid, &spec, fp);
+	size = ftello(fp);
+	if ((fclose(fp) != 0) && (job->error == GRID_OK))
+		job->error = GRID_ERR_IO;
+	job->bytes = (size > 0) ? size : 0;
+	job->seconds = stats_clock(CLOCK_MONOTONIC) - t;
+   }
+
+/******************************************************************************/
+/* FUNCTION: gridder_batch()						      */
+/* PURPOSE:  Builds num_jobs grids on num_threads threads, job[i].spec into  */
+/*           the file job[i].path, and fills in the results of each job.     */
+/*           The biggest grids are started first so that no thread is left  */
+/*           with a big one at the end.  Returns GRID_OK if every grid was   */
+/*           written, GRID_ERR_MEMORY, or the error of the first job that    */
+/*           failed.                                                         */
+/******************************************************************************/
+int gridder_batch(struct grid_batch_job *job, int num_jobs, int num_threads)
+   {
+	struct batch b;
+	const char *axes;
+	int i, j, k, a, error = GRID_OK;
+
+	memset(&b, 0, sizeof(b));
+	b.job = job;
+	b.order = malloc((num_jobs + 1) * sizeof(*b.order));
+	b.job_axis = malloc((3 * num_jobs + 1) * sizeof(*b.job_axis));
+	b.axis = malloc((3 * num_jobs + 1) * sizeof(*b.axis));
+	if ((b.order == NULL) || (b.job_axis == NULL) || (b.axis == NULL) || 
+			(gridder_grid_init(&b.unused) != GRID_OK))
+		error = GRID_ERR_MEMORY;
+
+	/* Check each job and find its axes among the ones seen so far. */
+	for (i=0; (error == GRID_OK) && (i < num_jobs); i++)
+	   {
+		job[i].bytes = 0;
+		job[i].seconds = 0.0;
+		job[i].num_nodes = job[i].num_elems = 0;
+		job[i].error = gridder_check_spec(&job[i].spec);
+		if (job[i].error == GRID_OK)
+			job[i].error = gridder_spec_size(&job[i].spec, 
+				&job[i].num_nodes, &job[i].num_elems);
+		for (a=0; a < 3; a++)
+			b.job_axis[3 * i + a] = -1;
+		if (job[i].error != GRID_OK)
+			continue;
+		axes = gridder_axes(job[i].spec.num_dimensions);
+		for (k=0; axes[k] != '\0'; k++)
+		   {
+			a = axes[k] - 'x';
+			for (j=0; j < b.num_axes; j++)
+				if (same_axis(b.axis[j].axis_spec, 
+						&job[i].spec.axis[a]))
+					break;
+			if (j == b.num_axes)
+			   {
+				b.axis[j].axis_spec = &job[i].spec.axis[a];
+				b.axis[j].spec = &job[i].spec;
+				b.axis[j].axis = a;
+				b.num_axes++;
+			   }
+			b.job_axis[3 * i + a] = j;
+		   }
+	   }
+
+	if (error == GRID_OK)
+	   {
+		/* Biggest first, by insertion: batches are hundreds of grids. */
+		for (i=0; i < num_jobs; i++)
+		   {
+			for (j=i; (j > 0) && (job[b.order[j-1]].num_elems < 
+					job[i].num_elems); j--)
+				b.order[j] = b.order[j-1];
+			b.order[j] = i;
+		   }
+		run_threads(num_threads, b.num_axes, batch_axis_work, &b);
+		for (i=0; i < num_jobs; i++)
+			if (job[b.order[i]].error != GRID_OK)
+				b.order[i] = -1;
+		for (i=j=0; i < num_jobs; i++)
+			if (b.order[i] >= 0)
+				b.order[j++] = b.order[i];
+		run_threads(num_threads, j, batch_job_work, &b);
+		for (i=0; (i < num_jobs) && (error == GRID_OK); i++)
+			error = job[i].error;
+	   }
+
+	for (j=0; (b.axis != NULL) && (j < b.num_axes); j++)
+		gridder_grid_free(&b.axis[j].grid);
+	gridder_grid_free(&b.unused);
+	free(b.order);
+	free(b.job_axis);
+	free(b.axis);
+	return error;
+   }
+
+/******************************************************************************/
+/* Cache.  With spec.cache set to a directory, the coordinates of each axis */
+/* and each finished grid file are kept there under a hash of what they     */
+/* were made from.  An axis is keyed on its BEGIN and regions, a grid on    */
+/* the dimension option, its axes, the output format and the compression,   */
+/* so changing one axis recalculates only that axis and changing the        */
+/* format rewrites only the file.  The hash is 64 bit FNV-1a of the numbers */
+/* in a fixed order, with the values that are not used (dx when there are   */
+/* divisions, the factor of a region that is not geometric) left out.       */
+/* Files are written under a temporary name and renamed, so runs sharing a  */
+/* cache never see half a file.  A cache that cannot be read or written is  */
+/* not an error, the grid is just calculated.                               */
+/******************************************************************************/
+
+/* Changes when the coordinates or files calculated for a spec change. */
+#define CACHE_VERSION 1
+#define CACHE_MAGIC "GRIDAXS1"
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME  1099511628211ULL
+
+static unsigned long long fnv(unsigned long long h, const void *p, size_t n)
+   {
+	const unsigned char *c = p;
+
+	while (n-- > 0)
+		h = (h ^ *c++) * FNV_PRIME;
+	return h;
+   }
+
+static unsigned long long fnv_int(unsigned long long h, long long i)
+   {
+	unsigned char b[8];
+	int k;
+
+	for (k=0; k < 8; k++)
+		b[k] = (unsigned char) (i >> (8 * k));
+	return fnv(h, b, 8);
+   }
+
+static unsigned long long fnv_double(unsigned long long h, double x)
+   {
+	union { double x; unsigned long long i; } u;
+
+	u.x = (x == 0.0) ? 0.0 : x;	/* -0.0 is 0.0 */
+	return fnv_int(h, (long long) u.i);
+   }
+
+/* Hash of the spec of one axis. */
+static unsigned long long cache_axis_key(const struct grid_axis_spec *a)
+   {
+	const struct grid_region *region;
+	unsigned long long h = FNV_OFFSET;
+	int r;
+
+	h = fnv_int(h, CACHE_VERSION);
+	h = fnv_double(h, a->begin);
+	h = fnv_int(h, a->num_regions);
+	for (r=0; r < a->num_regions; r++)
+	   {
+		region = &a->region[r];
+		h = fnv_double(h, region->end);
+		h = fnv_int(h, region->num_divisions);
+		if (region->num_divisions == 0)
+			h = fnv_double(h, region->dx);
+		h = fnv_int(h, region->spacing);
+		if (region->spacing == SPACING_GEOMETRIC)
+			h = fnv_double(h, region->geom_factor);
+	   }
+	return h;
+   }
+
+/* Hash of the grid file a spec makes. */
+static unsigned long long cache_grid_key(const struct grid_spec *spec)
+   {
+	unsigned long long h = FNV_OFFSET;
+	const char *axes;
+	int a;
+
+	h = fnv_int(h, CACHE_VERSION);
+	h = fnv_int(h, spec->num_dimensions);
+	axes = gridder_axes(spec->num_dimensions);
+	for (a=0; (axes != NULL) && (axes[a] != '\0'); a++)
+		h = fnv_int(h, (long long) 
+			cache_axis_key(&spec->axis[axes[a] - 'x']));
+	h = fnv_int(h, spec->output);
+	h = fnv_int(h, spec->compress);
+	if (spec->data != 0)
+		h = fnv_int(h, spec->data);
+	return h;
+   }
+
+/* Opens a temporary file in the cache to be renamed to path. */
+static FILE *cache_temp(const char *path, char *temp, size_t size)
+   {
+	FILE *fp;
+	int fd;
+
+	if (snprintf(temp, size, "%s.XXXXXX", path) >= (int) size)
+		return NULL;
+	if ((fd = mkstemp(temp)) < 0)
+		return NULL;
+	if ((fp = fdopen(fd, "w+")) == NULL)
+	   {
+		close(fd);
+		unlink(temp);
+	   }
+	return fp;
+   }
+
+/* Closes a temporary file and renames it to path if ok, or removes it. */
+static void cache_commit(FILE *fp, const char *temp, const char *path, int ok)
+   {
+	if ((fclose(fp) != 0) || !ok || (rename(temp, path) != 0))
+		unlink(temp);
+   }
+
+/******************************************************************************/
+/* FUNCTION: cache_axis_load()						      */
+/* PURPOSE:  Reads an axis from the cache into grid.  Returns the number of  */
+/*           nodes, or 0 if it is not in the cache.                          */
+/******************************************************************************/
+static int cache_axis_load(struct grid *grid, const struct grid_spec *spec, 
+		int axis)
+   {
+	const struct grid_axis_spec *axis_spec = &spec->axis[axis];
+	unsigned long long key = cache_axis_key(axis_spec), file_key;
+	char path[4096], magic[8];
+	int head[2], r, n, ok;
+	FILE *fp;
+
+	if (snprintf(path, sizeof(path), "%s/axis-%016llx", spec->cache, key) 
+			>= (int) sizeof(path))
+		return 0;
+	if ((fp = fopen(path, "rb")) == NULL)
+		return 0;
+
+	ok = (fread(magic, 8, 1, fp) == 1) && 
+		(memcmp(magic, CACHE_MAGIC, 8) == 0) && 
+		(fread(&file_key, sizeof(file_key), 1, fp) == 1) && 
+		(file_key == key) && (fread(head, sizeof(int), 2, fp) == 2) && 
+		(head[0] > 0) && (head[0] <= MAXNODES) && 
+		(head[1] == axis_spec->num_regions) && 
+		(grid_reserve(grid, axis, head[0], head[1]) == GRID_OK) && 
+		(fread(grid->num_elems_per_region[axis], sizeof(int), head[1], 
+			fp) == (size_t) head[1]) && 
+		(fread(grid->coords[axis], sizeof(double), head[0], fp) == 
+			(size_t) head[0]);
+	fclose(fp);
+
+	/* The regions have to add up to the nodes. */
+	n = 0;
+	for (r=0; ok && (r < head[1]); r++)
+	   {
+		grid->region_start[axis][r] = n;
+		if ((grid->num_elems_per_region[axis][r] < 1) || 
+				(grid->num_elems_per_region[axis][r] > 
+				head[0] - 1 - n))
+			ok = 0;
+		else
+			n += grid->num_elems_per_region[axis][r];
+	   }
+	if (!ok || (n != head[0] - 1))
+		return 0;
+	grid->region_start[axis][head[1]] = n;
+	grid->num_regions[axis] = head[1];
+	grid->num_nodes[axis] = head[0];
+	return head[0];
+   }
+
+/******************************************************************************/
+/* FUNCTION: cache_axis_store()						      */
+/* PURPOSE:  Puts an axis calculated by gridder_axis_coords() in the cache.  */
+/******************************************************************************/
+static void cache_axis_store(const struct grid *grid, 
+		const struct grid_spec *spec, int axis)
+   {
+	unsigned long long key = cache_axis_key(&spec->axis[axis]);
+	char path[4096], temp[4096 + 8];
+	int head[2];
+	FILE *fp;
+
+	if (snprintf(path, sizeof(path), "%s/axis-%016llx", spec->cache, key) 
+			>= (int) sizeof(path))
+		return;
+	if ((fp = cache_temp(path, temp, sizeof(temp))) == NULL)
+		return;
+	head[0] = grid->num_nodes[axis];
+	head[1] = grid->num_regions[axis];
+	cache_commit(fp, temp, path, 
+		(fwrite(CACHE_MAGIC, 8, 1, fp) == 1) && 
+		(fwrite(&key, sizeof(key), 1, fp) == 1) && 
+		(fwrite(head, sizeof(int), 2, fp) == 2) && 
+		(fwrite(grid->num_elems_per_region[axis], sizeof(int), head[1], 
+			fp) == (size_t) head[1]) && 
+		(fwrite(grid->coords[axis], sizeof(double), head[0], fp) == 
+			(size_t) head[0]));
+   }
+
+/* Copies the rest of from to to.  Returns GRID_OK or GRID_ERR_IO. */
+static int copy_file(FILE *from, FILE *to)
+   {
+	char *buf;
+	size_t n;
+	int error = GRID_OK;
+
+	if ((buf = malloc(1 << 20)) == NULL)
+		return GRID_ERR_MEMORY;
+	while ((n = fread(buf, 1, 1 << 20, from)) > 0)
+		if (fwrite(buf, 1, n, to) != n)
+		   {
+			error = GRID_ERR_IO;
+			break;
+		   }
+	if (ferror(from) || (fflush(to) != 0) || ferror(to))
+		error = GRID_ERR_IO;
+	free(buf);
+	return error;
+   }
+
+/******************************************************************************/
+/* FUNCTION: cache_grid_write()						      */
+/* PURPOSE:  gridder_write() with a cache: copies the grid file from the     */
+/*           cache if it is there, otherwise writes it into the cache and    */
+/*           copies it to fp_out.  Returns GRID_OK or a GRID_ERR_ value.     */
+/******************************************************************************/
+static int cache_grid_write(const struct grid *grid, 
+		const struct grid_spec *spec, FILE *fp_out)
+   {
+	char path[4096], temp[4096 + 8];
+	FILE *fp;
+	int error;
+
+	if (snprintf(path, sizeof(path), "%s/grid-%016llx", spec->cache, 
+			cache_grid_key(spec)) >= (int) sizeof(path))
+		return grid_write(grid, spec, fp_out, 0);
+	if ((fp = fopen(path, "rb")) != NULL)
+	   {
+		error = copy_file(fp, fp_out);
+		fclose(fp);
+		return error;
+	   }
+
+	/* Not there, or the cache cannot be written. */
+	if ((fp = cache_temp(path, temp, sizeof(temp))) == NULL)
+		return grid_write(grid, spec, fp_out, 0);
+	error = grid_write(grid, spec, fp, 0);
+	if (error == GRID_OK)
+	   {
+		rewind(fp);
+		error = copy_file(fp, fp_out);
+	   }
+	cache_commit(fp, temp, path, error == GRID_OK);
+	return error;
+   }
+
+/******************************************************************************/
+/* Compressed output.  gridder_write() gzips the grid file as it is written  */
+/* without the writers knowing: they write to one end of a pipe, a reader    */
+/* thread cuts what comes out into GZIP_BLOCK byte blocks, the compressor    */
+/* threads turn each block into a gzip member of its own, and a writer       */
+/* thread puts the members in the real output in order.  The result is an    */
+/* ordinary multi-member gzip file that gzip -d and zcat read.  Compile with */
+/* -DHAVE_ZLIB and link with -lz to have it.                                 */
+/******************************************************************************/
+
+#define GZIP_BLOCK (1 << 22)
+
+#ifdef HAVE_ZLIB
+
+/* States of a block slot. */
+#define GZ_EMPTY  0
+#define GZ_FILLED 1
+#define GZ_BUSY   2
+#define GZ_DONE   3
+
+struct gzip_slot {
+	char *in, *out;
+	size_t in_len, out_len, out_size;
+	int state;
+};
+
+struct grid_gzip {
+	FILE *fp;
+		/* The writers' end of the pipe. */
+	FILE *fp_out;
+	int fd_in, fd_pipe;
+		/* Reading and writing ends of the pipe. */
+	int level;
+	int num_slots;
+	struct gzip_slot *slot;
+		/* Block b is in slot[b % num_slots]. */
+	long long next_fill, next_compress, next_write;
+	long long num_blocks;
+		/* Set when the pipe is closed, -1 before. */
+	int error;
+	pthread_mutex_t lock;
+	pthread_cond_t change;
+	int num_threads;
+	pthread_t *tid;
+		/* Reader, writer, then the compressors. */
+	int *started;
+};
+
+/******************************************************************************/
+/* FUNCTION: gzip_reader()						      */
+/* PURPOSE:  Reads the pipe into the slots a block at a time.  An empty      */
+/*           grid still gets one (empty) member.                             */
+/******************************************************************************/
+static void *gzip_reader(void *arg)
+   {
+	struct grid_gzip *gz = arg;
+	struct gzip_slot *s;
+	ssize_t n;
+	size_t len;
+
+	for (;;)
+	   {
+		pthread_mutex_lock(&gz->lock);
+		s = &gz->slot[gz->next_fill % gz->num_slots];
+		while (s->state != GZ_EMPTY)
+			pthread_cond_wait(&gz->change, &gz->lock);
+		pthread_mutex_unlock(&gz->lock);
+
+		for (len=0; len < GZIP_BLOCK; len += n)
+		   {
+			n = read(gz->fd_in, s->in + len, GZIP_BLOCK - len);
+			if ((n < 0) && (errno == EINTR))
+				n = 0;
+			else if (n <= 0)
+				break;
+		   }
+
+		pthread_mutex_lock(&gz->lock);
+		if (n < 0)
+			gz->error = GRID_ERR_IO;
+		if ((len > 0) || (gz->next_fill == 0))
+		   {
+			s->in_len = len;
+			s->state = GZ_FILLED;
+			gz->next_fill++;
+		   }
+		if (len < GZIP_BLOCK)
+			gz->num_blocks = gz->next_fill;
+		pthread_cond_broadcast(&gz->change);
+		pthread_mutex_unlock(&gz->lock);
+		if (len < GZIP_BLOCK)
+			return NULL;
+	   }
+   }
+
+/******************************************************************************/
+/* FUNCTION: gzip_member()						      */
+/* PURPOSE:  Compresses the block in a slot into one gzip member.            */
+/******************************************************************************/
+static int gzip_member(struct gzip_slot *s, int level)
+   {
+	z_stream z;
+	size_t need;
+	int r;
+
+	memset(&z, 0, sizeof(z));
+	if (deflateInit2(&z, level, Z_DEFLATED, 15 + 16, 8, 
+			Z_DEFAULT_STRATEGY) != Z_OK)
+		return GRID_ERR_MEMORY;
+	need = deflateBound(&z, s->in_len);
+	if (s->out_size < need)
+	   {
+		free(s->out);
+		s->out = malloc(need);
+		s->out_size = (s->out != NULL) ? need : 0;
+	   }
+	if (s->out == NULL)
+	   {
+		deflateEnd(&z);
+		return GRID_ERR_MEMORY;
+	   }
+	z.next_in = (Bytef *) s->in;
+	z.avail_in = s->in_len;
+	z.next_out = (Bytef *) s->out;
+	z.avail_out = s->out_size;
+	r = deflate(&z, Z_FINISH);
+	s->out_len = z.total_out;
+	deflateEnd(&z);
+	return (r == Z_STREAM_END) ? GRID_OK : GRID_ERR_IO;
+   }
+
+/******************************************************************************/
+/* FUNCTION: gzip_compressor()						      */
+/* PURPOSE:  Compresses filled blocks, in any order, until the last one.     */
+/******************************************************************************/
+static void *gzip_compressor(void *arg)
+   {
+	struct grid_gzip *gz = arg;
+	struct gzip_slot *s;
+	int error;
+
+	pthread_mutex_lock(&gz->lock);
+	for (;;)
+	   {
+		while ((gz->next_compress >= gz->next_fill) && 
+				(gz->num_blocks < 0))
+			pthread_cond_wait(&gz->change, &gz->lock);
+		if (gz->next_compress >= gz->next_fill)
+			break;
+		s = &gz->slot[gz->next_compress++ % gz->num_slots];
+		s->state = GZ_BUSY;
+		pthread_mutex_unlock(&gz->lock);
+
+		error = gzip_member(s, gz->level);
+
+		pthread_mutex_lock(&gz->lock);
+		if (error != GRID_OK)
+		   {
+			gz->error = error;
+			s->out_len = 0;
+		   }
+		s->state = GZ_DONE;
+		pthread_cond_broadcast(&gz->change);
+	   }
+	pthread_mutex_unlock(&gz->lock);
+	return NULL;
+   }
+
+/******************************************************************************/
+/* FUNCTION: gzip_writer()						      */
+/* PURPOSE:  Writes the members to the output in block order.                */
+/******************************************************************************/
+static void *gzip_writer(void *arg)
+   {
+	struct grid_gzip *gz = arg;
+	struct gzip_slot *s;
+	size_t n;
+
+	pthread_mutex_lock(&gz->lock);
+	for (;;)
+	   {
+		s = &gz->slot[gz->next_write % gz->num_slots];
+		while ((s->state != GZ_DONE) && ((gz->num_blocks < 0) || 
+				(gz->next_write < gz->num_blocks)))
+			pthread_cond_wait(&gz->change, &gz->lock);
+		if (s->state != GZ_DONE)
+			break;
+		pthread_mutex_unlock(&gz->lock);
+
+		n = fwrite(s->out, 1, s->out_len, gz->fp_out);
+
+		pthread_mutex_lock(&gz->lock);
+		if (n != s->out_len)
+			gz->error = GRID_ERR_IO;
+		s->state = GZ_EMPTY;
+		gz->next_write++;
+		pthread_cond_broadcast(&gz->change);
+	   }
+	pthread_mutex_unlock(&gz->lock);
+	return NULL;
+   }
+
+/******************************************************************************/
+/* FUNCTION: grid_gzip_open()						      */
+/* PURPOSE:  Starts compressing into *fp_out with num_threads compressor     */
+/*           threads at a gzip level of 1-9, and replaces *fp_out with the   */
+/*           stream the grid is to be written to.  Finish with              */
+/*           grid_gzip_close().  Returns GRID_OK or a GRID_ERR_ value.       */
+/******************************************************************************/
+static int grid_gzip_open(struct grid_gzip **gzp, FILE **fp_out, 
+		int num_threads, int level)
+   {
+	struct grid_gzip *gz;
+	int fd[2], i, ok = 1;
+
+	*gzp = NULL;
+	gz = calloc(1, sizeof(*gz));
+	if (gz == NULL)
+		return GRID_ERR_MEMORY;
+	if (pipe(fd) != 0)
+	   {
+		free(gz);
+		return GRID_ERR_IO;
+	   }
+	gz->fd_in = fd[0];
+	gz->fd_pipe = fd[1];
+	gz->fp = fdopen(fd[1], "w");
+	gz->fp_out = *fp_out;
+	gz->level = (level >= 1 && level <= 9) ? level : 6;
+	gz->num_blocks = -1;
+	gz->error = GRID_OK;
+	gz->num_threads = 2 + ((num_threads > 1) ? num_threads : 1);
+	gz->num_slots = gz->num_threads;
+	pthread_mutex_init(&gz->lock, NULL);
+	pthread_cond_init(&gz->change, NULL);
+
+	gz->slot = calloc(gz->num_slots, sizeof(*gz->slot));
+	gz->tid = calloc(gz->num_threads, sizeof(*gz->tid));
+	gz->started = calloc(gz->num_threads, sizeof(*gz->started));
+	if ((gz->fp == NULL) || (gz->slot == NULL) || (gz->tid == NULL) || 
+			(gz->started == NULL))
+		ok = 0;
+	for (i=0; ok && (i < gz->num_slots); i++)
+		if ((gz->slot[i].in = malloc(GZIP_BLOCK)) == NULL)
+			ok = 0;
+
+	/* The reader goes last, so if a thread cannot be started */
+	/* the ones that were can be stopped by grid_gzip_close().  */
+	for (i=gz->num_threads-1; ok && (i >= 0); i--)
+	   {
+		gz->started[i] = (pthread_create(&gz->tid[i], NULL, 
+			(i == 0) ? gzip_reader : (i == 1) ? gzip_writer : 
+			gzip_compressor, gz) == 0);
+		ok = gz->started[i];
+	   }
+
+	if (!ok)
+	   {
+		gz->error = GRID_ERR_MEMORY;
+		grid_gzip_close(gz);
+		return GRID_ERR_MEMORY;
+	   }
+	*gzp = gz;
+	*fp_out = gz->fp;
+	return GRID_OK;
+   }
+
+/******************************************************************************/
+/* FUNCTION: grid_gzip_close()						      */
+/* PURPOSE:  Closes the writers' end of the pipe, waits for the last member  */
+/*           to be written and frees everything.  Returns GRID_OK or the     */
+/*           first error.                                                    */
+/******************************************************************************/
+static int grid_gzip_close(struct grid_gzip *gz)
+   {
+	int i, error;
+
+	if (gz->fp != NULL)
+	   {
+		if (fclose(gz->fp) != 0)
+			gz->error = GRID_ERR_IO;
+	   }
+	else
+		close(gz->fd_pipe);
+
+	/* Without a reader nothing else can finish. */
+	if ((gz->started == NULL) || !gz->started[0])
+	   {
+		pthread_mutex_lock(&gz->lock);
+		gz->num_blocks = gz->next_fill;
+		pthread_cond_broadcast(&gz->change);
+		pthread_mutex_unlock(&gz->lock);
+	   }
+	for (i=0; (gz->started != NULL) && (i < gz->num_threads); i++)
+		if (gz->started[i])
+			pthread_join(gz->tid[i], NULL);
+
+	if ((fflush(gz->fp_out) != 0) || ferror(gz->fp_out))
+		gz->error = GRID_ERR_IO;
+	error = gz->error;
+
+	close(gz->fd_in);
+	for (i=0; (gz->slot != NULL) && (i < gz->num_slots); i++)
+	   {
+		free(gz->slot[i].in);
+		free(gz->slot[i].out);
+	   }
+	pthread_cond_destroy(&gz->change);
+	pthread_mutex_destroy(&gz->lock);
+	free(gz->slot);
+	free(gz->tid);
+	free(gz->started);
+	free(gz);
+	return error;
+   }
+
+#else /* HAVE_ZLIB */
+
+static int grid_gzip_open(struct grid_gzip **gzp, FILE **fp_out, 
+		int num_threads, int level)
+   {
+	*gzp = NULL;
+	return GRID_ERR_COMPRESS;
+   }
+
+static int grid_gzip_close(struct grid_gzip *gz)
+   {
+	return GRID_ERR_COMPRESS;
+   }
+
+#endif /* HAVE_ZLIB */
+
+/******************************************************************************/
+/* Node coordinates.  The nodes are the tensor product of the axis           */
+/* coordinates, so each coordinate is converted to text once with %20.12g    */
+/* and every node line is put together from those strings.                   */
+/******************************************************************************/
+
+struct node_text {
+	int num_xnodes, num_ynodes, num_znodes;
+	char *xs, *ys, *zs;
+		/* Coordinates, COORD_WIDTH characters each. */
+	int left_justify;
+		/* Node number is %-11d for AVS, %11d for FEHM. */
+};
+
+/******************************************************************************/
+/* FUNCTION: format_axis()						      */
+/* PURPOSE:  Returns the coordinates of an axis formatted once each with     */
+/*           %20.12g, COORD_WIDTH characters per value and no separators.    */
+/*           The caller frees the result.  Returns NULL if out of memory.    */
+/******************************************************************************/
+static char *format_axis(const double *x, int num_nodes)
+   {
+	char *s, field[32];
+	int i;
+
+	s = malloc((size_t) num_nodes * COORD_WIDTH);
+	if (s == NULL)
+		return NULL;
+	for (i=0; i < num_nodes; i++)
+	   {
+		snprintf(field, sizeof(field), "%20.12g", x[i]);
+		memcpy(s + (size_t) i * COORD_WIDTH, field, COORD_WIDTH);
+	   }
+	return s;
+   }
+
+/******************************************************************************/
+/* FUNCTION: node_text_init()						      */
+/* PURPOSE:  Formats the axis coordinates.  Returns GRID_OK or               */
+/*           GRID_ERR_MEMORY.                                                */
+/******************************************************************************/
+static int node_text_init(struct node_text *t, const struct grid_out *out,
+		int num_xnodes, int num_ynodes, int num_znodes, int left_justify)
+   {
+	t->num_xnodes = num_xnodes;
+	t->num_ynodes = num_ynodes;
+	t->num_znodes = num_znodes;
+	t->left_justify = left_justify;
+	/* A dry run only needs node_bytes(). */
+	t->xs = t->ys = t->zs = NULL;
+	if (out->dry)
+		return GRID_OK;
+	t->xs = format_axis(out->coords[AXIS_X], num_xnodes);
+	t->ys = format_axis(out->coords[AXIS_Y], num_ynodes);
+	t->zs = format_axis(out->coords[AXIS_Z], num_znodes);
+	if ((t->xs == NULL) || (t->ys == NULL) || (t->zs == NULL))
+		return GRID_ERR_MEMORY;
+	return GRID_OK;
+   }
+
+static void node_text_free(struct node_text *t)
+   {
+	free(t->xs);
+	free(t->ys);
+	free(t->zs);
+	t->xs = t->ys = t->zs = NULL;
+   }
+
+/******************************************************************************/
+/* FUNCTION: node_bytes()						      */
+/* PURPOSE:  Size of the lines for nodes first ... first+count-1 (from 0).   */
+/*           Every line is the node number, at least 11 wide, and three      */
+/*           coordinates each after two spaces.                              */
+/******************************************************************************/
+static long long node_bytes(const void *ctx, long long first, long long count)
+   {
+	return digits_sum(first + 1, first + count, 11) +
+		count * (3 * (COORD_WIDTH + 2) + 1);
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_nodes()						      */
+/* PURPOSE:  Writes the lines for nodes first ... first+count-1 (from 0),    */
+/*           x fastest, then y, then z.                                      */
+/******************************************************************************/
+static void write_nodes(const void *ctx, long long first, long long count,
+		struct grid_buf *b)
+   {
+	const struct node_text *t = ctx;
+	char tail[3 * COORD_WIDTH];
+		/* "  y  z\n", the same for every node in a row. */
+	int tail_len = 2 * COORD_WIDTH + 5;
+	long long node = first;
+	long long last = first + count;
+	int i, j, k, len;
+	char *p;
+
+	i = node % t->num_xnodes;
+	j = (node / t->num_xnodes) % t->num_ynodes;
+	k = node / ((long long) t->num_xnodes * t->num_ynodes);
+
+	while (node < last)
+	   {
+		tail[0] = ' ';
+		tail[1] = ' ';
+		memcpy(tail + 2, t->ys + (size_t) j * COORD_WIDTH, COORD_WIDTH);
+		tail[COORD_WIDTH + 2] = ' ';
+		tail[COORD_WIDTH + 3] = ' ';
+		memcpy(tail + COORD_WIDTH + 4, t->zs + (size_t) k * COORD_WIDTH,
+			COORD_WIDTH);
+		tail[2 * COORD_WIDTH + 4] = '\n';
+
+		for (; (i < t->num_xnodes) && (node < last); i++, node++)
+		   {
+			p = grid_buf_reserve(b);
+			len = format_int(p, node + 1, 11, t->left_justify);
+			p[len++] = ' ';
+			p[len++] = ' ';
+			memcpy(p + len, t->xs + (size_t) i * COORD_WIDTH,
+				COORD_WIDTH);
+			len = len + COORD_WIDTH;
+			memcpy(p + len, tail, tail_len);
+			b->len = b->len + len + tail_len;
+		   }
+
+		i = 0;
+		if (++j == t->num_ynodes)
+		   {
+			j = 0;
+			k++;
+		   }
+	   }
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_node_coords()					      */
+/* PURPOSE:  Writes one line per node: the node number (left justified in    */
+/*           11 columns for AVS, right justified for FEHM) and the x, y and  */
+/*           z coordinates with %20.12g.  Returns GRID_OK or GRID_ERR_.      */
+/******************************************************************************/
+static int write_node_coords(int num_xnodes, int num_ynodes, int num_znodes,
+		int left_justify, struct grid_out *out)
+   {
+	struct node_text t;
+	struct grid_section sec;
+	int error;
+
+	error = node_text_init(&t, out, num_xnodes, num_ynodes, num_znodes, 
+		left_justify);
+	if (error == GRID_OK)
+	   {
+		sec.ctx = &t;
+		sec.count = (long long) num_xnodes * num_ynodes * num_znodes;
+		sec.size = node_bytes;
+		sec.record_size = 0;
+		sec.write = write_nodes;
+		error = write_section(out, &sec);
+	   }
+	node_text_free(&t);
+	return error;
+   }
+
+/******************************************************************************/
+/* FUNCTION: print_avs_coords() 					      */
+/* PURPOSE: Prints coordinates to file in AVS format.				      */
+/******************************************************************************/
+int print_avs_coords(num_xnodes, num_ynodes, num_znodes, num_elems, out)
+int num_xnodes;
+int num_ynodes;
+int num_znodes;
+long long num_elems;
+struct grid_out *out;
+   {
+	int num_axes = strlen(out->axes);
+
+/* Print to file according to AVS input number of nodes, number of elements, 
+   and number of regions as the number of material specifcations.
+   left justify first numbers, AVS doesn't like a space in first column. 
+   Node and cell data values are counted if spec.data asks for them. */
+
+	fprintf(out->fp, "%-lld %lld %d %d 0\n", 
+		(long long) num_xnodes*num_ynodes*num_znodes, num_elems,
+		(out->data & GRID_DATA_NODES) ? num_axes : 0,
+		(out->data & GRID_DATA_CELLS) ? num_axes + 1 : 0);
+
+/* Print coordinates to file. */
+	return write_node_coords(num_xnodes, num_ynodes, num_znodes, 1, out);
+
+   }
+
+/******************************************************************************/
+/* FUNCTION: print_fehm_coords() 					      */
+/* PURPOSE: Prints coordinates to file in FEHM format.				      */
+/******************************************************************************/
+int print_fehm_coords(num_xnodes, num_ynodes, num_znodes, num_elems, num_dimensions, out)
+int num_xnodes;
+int num_ynodes;
+int num_znodes;
+long long num_elems;
+int num_dimensions;
+struct grid_out *out;
+   {
+	FILE *fp_out = out->fp;
+	int error;
+
+/* Print to file according to AVS input number of nodes, number of elements, 
+   and number of regions as the number of material specifcations.
+   left justify first numbers, AVS doesn't like a space in first column. */
+
+        fprintf(fp_out, "%-s\n", "coor");
+	fprintf(fp_out, "%lld\n", (long long) num_xnodes*num_ynodes*num_znodes);
+
+/* Print coordinates to file. */
+	error = write_node_coords(num_xnodes, num_ynodes, num_znodes, 0, out);
+
+	fprintf(fp_out, "\n");
+	fprintf(fp_out, "%-s\n", "elem");
+	if (num_dimensions == 3) {
+	  fprintf(fp_out, "8 %lld\n", num_elems);
+	} else if  (num_dimensions == 2) {
+	  fprintf(fp_out, "4 %lld\n", num_elems);
+	} else {
+	  fprintf(fp_out, "2 %lld\n", num_elems);
+	}
+	return error;
+   }
+
+/******************************************************************************/
+/* Binary node coordinates.  Records are taken in node order, x fastest,    */
+/* and are either one float32 coordinate (AVS binary, axis 0-2) or the      */
+/* x, y and z of the node as little-endian float64 (raw, axis -1).          */
+/******************************************************************************/
+
+struct node_binary {
+	int num_xnodes, num_ynodes, num_znodes;
+	int axis;
+	const double *xcoords, *ycoords, *zcoords;
+};
+
+static void write_node_values(const void *ctx, long long first, 
+		long long count, struct grid_buf *b)
+   {
+	const struct node_binary *t = ctx;
+	const double *xcoords = t->xcoords;
+	const double *ycoords = t->ycoords;
+	const double *zcoords = t->zcoords;
+	long long node, last = first + count;
+	int i, j, k;
+	float f;
+	char *p;
+
+	i = first % t->num_xnodes;
+	j = (first / t->num_xnodes) % t->num_ynodes;
+	k = first / ((long long) t->num_xnodes * t->num_ynodes);
+
+	for (node=first; node < last; node++)
+	   {
+		p = grid_buf_reserve(b);
+		if (t->axis < 0)
+		   {
+			put_le_double(p, xcoords[i]);
+			put_le_double(p + 8, ycoords[j]);
+			put_le_double(p + 16, zcoords[k]);
+			b->len = b->len + 24;
+		   }
+		else
+		   {
+			if (t->axis == AXIS_X)
+				f = (float) xcoords[i];
+			else if (t->axis == AXIS_Y)
+				f = (float) ycoords[j];
+			else
+				f = (float) zcoords[k];
+			memcpy(p, &f, sizeof(f));
+			b->len = b->len + sizeof(f);
+		   }
+		if (++i == t->num_xnodes)
+		   {
+			i = 0;
+			if (++j == t->num_ynodes)
+			   {
+				j = 0;
+				k++;
+			   }
+		   }
+	   }
+   }
+
+/******************************************************************************/
+/* FUNCTION: print_binary_coords()					      */
+/* PURPOSE:  Writes the node coordinates of one axis as float32 (axis 0-2)   */
+/*           or of all three as float64 (axis -1).                           */
+/******************************************************************************/
+int print_binary_coords(int num_xnodes, int num_ynodes, int num_znodes,
+		int axis, struct grid_out *out)
+   {
+	struct node_binary t;
+	struct grid_section sec;
+
+	t.num_xnodes = num_xnodes;
+	t.num_ynodes = num_ynodes;
+	t.num_znodes = num_znodes;
+	t.axis = axis;
+	t.xcoords = out->coords[AXIS_X];
+	t.ycoords = out->coords[AXIS_Y];
+	t.zcoords = out->coords[AXIS_Z];
+	sec.ctx = &t;
+	sec.count = (long long) num_xnodes * num_ynodes * num_znodes;
+	sec.size = NULL;
+	sec.record_size = (axis < 0) ? 24 : sizeof(float);
+	sec.write = write_node_values;
+	return write_section(out, &sec);
+   }
+
+/******************************************************************************/
+/* FUNCTION: print_avs_binary_header()					      */
+/* PURPOSE:  Writes the header of an AVS binary UCD file: the magic byte 7   */
+/*           and the number of nodes, cells, node data, cell data, model    */
+/*           data and cell node list entries, in the byte order of the       */
+/*           machine as AVS expects.                                         */
+/******************************************************************************/
+int print_avs_binary_header(long long num_nodes, long long num_elems, 
+		int num_dimensions, FILE *fp_out)
+   {
+	int header[6];
+
+	/* gridder_spec_size() has checked these fit. */
+	header[0] = num_nodes;
+	header[1] = num_elems;
+	header[2] = 0;
+	header[3] = 0;
+	header[4] = 0;
+	header[5] = num_elems * elem_nodes(num_dimensions);
+	if ((fputc(7, fp_out) == EOF) || 
+			(fwrite(header, sizeof(int), 6, fp_out) != 6))
+		return GRID_ERR_IO;
+	return GRID_OK;
+   }
+
+/******************************************************************************/
+/* FUNCTION: print_raw_header()						      */
+/* PURPOSE:  Writes the 64 byte header of a raw binary grid file, see        */
+/*           OUTPUT_RAW in gridder.h.                                        */
+/******************************************************************************/
+int print_raw_header(long long num_nodes, long long num_elems, 
+		int num_dimensions, FILE *fp_out)
+   {
+	char header[GRID_RAW_HEADER];
+	int nodes_per_elem = elem_nodes(num_dimensions);
+	long long coord_offset = GRID_RAW_HEADER;
+	long long conn_offset = coord_offset + 24 * num_nodes;
+	long long zone_offset = conn_offset + 8 * nodes_per_elem * num_elems;
+
+	memcpy(header, GRID_RAW_MAGIC, 8);
+	put_le64(header + 8, num_nodes);
+	put_le64(header + 16, num_elems);
+	put_le32(header + 24, nodes_per_elem);
+	put_le32(header + 28, num_dimensions);
+	put_le64(header + 32, coord_offset);
+	put_le64(header + 40, conn_offset);
+	put_le64(header + 48, zone_offset);
+	put_le64(header + 56, zone_offset + 4 * num_elems);
+	if (fwrite(header, 1, GRID_RAW_HEADER, fp_out) != GRID_RAW_HEADER)
+		return GRID_ERR_IO;
+	return GRID_OK;
+   }
+
+/******************************************************************************/
+/* FUNCTION: print_vtr_header()						      */
+/* PURPOSE:  Writes a VTK XML RectilinearGrid file, see OUTPUT_VTR in        */
+/*           gridder.h, up to the zones: the XML with the offset of each     */
+/*           appended array, then the coordinates and the regions along each */
+/*           axis, and the byte count of the zones if they follow.  An axis  */
+/*           not used has one node, which VTK reads as a 1-D or 2-D grid.    */
+/*           Returns GRID_OK or GRID_ERR_IO.                                 */
+/******************************************************************************/
+int print_vtr_header(const struct grid *grid, struct grid_out *out)
+   {
+	static const char *axis_name = "xyz";
+	const char *axes = out->axes;
+	FILE *fp = out->fp;
+	long long offset = 0;
+	long long cells = grid->num_elems;
+	char value[8];
+	int a, i, r, n;
+
+	fprintf(fp, "<?xml version=\"1.0\"?>\n");
+	fprintf(fp, "<VTKFile type=\"RectilinearGrid\" version=\"1.0\" "
+		"byte_order=\"LittleEndian\" header_type=\"UInt64\">\n");
+	fprintf(fp, "  <RectilinearGrid WholeExtent=\"0 %d 0 %d 0 %d\">\n",
+		grid->num_nodes[AXIS_X] - 1, grid->num_nodes[AXIS_Y] - 1,
+		grid->num_nodes[AXIS_Z] - 1);
+
+	/* The coordinates come first in the appended data. */
+	for (a=AXIS_X; a <= AXIS_Z; a++)
+		offset = offset + 8 + 8 * (long long) grid->num_nodes[a];
+
+	fprintf(fp, "    <FieldData>\n");
+	for (i=0; axes[i] != '\0'; i++)
+	   {
+		n = grid->region_start[axes[i] - 'x'][grid->num_regions[
+			axes[i] - 'x']];
+		fprintf(fp, "      <DataArray type=\"Int32\" Name=\"region_%c\" "
+			"NumberOfTuples=\"%d\" format=\"appended\" "
+			"offset=\"%lld\"/>\n", axes[i], n, offset);
+		offset = offset + 8 + 4 * (long long) n;
+	   }
+	fprintf(fp, "    </FieldData>\n");
+
+	fprintf(fp, "    <Piece Extent=\"0 %d 0 %d 0 %d\">\n",
+		grid->num_nodes[AXIS_X] - 1, grid->num_nodes[AXIS_Y] - 1,
+		grid->num_nodes[AXIS_Z] - 1);
+	if (out->data & GRID_DATA_CELLS)
+	   {
+		fprintf(fp, "      <CellData Scalars=\"zone\">\n");
+		fprintf(fp, "        <DataArray type=\"Int32\" Name=\"zone\" "
+			"format=\"appended\" offset=\"%lld\"/>\n", offset);
+		fprintf(fp, "      </CellData>\n");
+	   }
+	fprintf(fp, "      <Coordinates>\n");
+	for (offset=0, a=AXIS_X; a <= AXIS_Z; a++)
+	   {
+		fprintf(fp, "        <DataArray type=\"Float64\" Name=\"%c\" "
+			"format=\"appended\" offset=\"%lld\"/>\n", axis_name[a],
+			offset);
+		offset = offset + 8 + 8 * (long long) grid->num_nodes[a];
+	   }
+	fprintf(fp, "      </Coordinates>\n");
+	fprintf(fp, "    </Piece>\n");
+	fprintf(fp, "  </RectilinearGrid>\n");
+	fprintf(fp, "  <AppendedData encoding=\"raw\">\n   _");
+
+	/* A dry run skips the coordinates and regions. */
+	if (out->dry)
+	   {
+		for (offset=0, a=AXIS_X; a <= AXIS_Z; a++)
+			offset = offset + 8 + 8 * 
+				(long long) grid->num_nodes[a];
+		for (i=0; axes[i] != '\0'; i++)
+		   {
+			a = axes[i] - 'x';
+			offset = offset + 8 + 4 * (long long) 
+				grid->region_start[a][grid->num_regions[a]];
+		   }
+		if (out_skip(out, offset) != GRID_OK)
+			return GRID_ERR_IO;
+	   }
+	for (a=AXIS_X; (a <= AXIS_Z) && !out->dry; a++)
+	   {
+		put_le64(value, 8 * (long long) grid->num_nodes[a]);
+		fwrite(value, 1, 8, fp);
+		for (i=0; i < grid->num_nodes[a]; i++)
+		   {
+			put_le_double(value, grid->coords[a][i]);
+			fwrite(value, 1, 8, fp);
+		   }
+	   }
+	for (i=0; (axes[i] != '\0') && !out->dry; i++)
+	   {
+		a = axes[i] - 'x';
+		put_le64(value, 4 * (long long) grid->region_start[a][
+			grid->num_regions[a]]);
+		fwrite(value, 1, 8, fp);
+		for (r=0; r < grid->num_regions[a]; r++)
+			for (n=grid->region_start[a][r]; 
+					n < grid->region_start[a][r + 1]; n++)
+			   {
+				put_le32(value, r + 1);
+				fwrite(value, 1, 4, fp);
+			   }
+	   }
+	if (out->data & GRID_DATA_CELLS)
+	   {
+		put_le64(value, 4 * cells);
+		fwrite(value, 1, 8, fp);
+	   }
+	return ferror(fp) ? GRID_ERR_IO : GRID_OK;
+   }
+
+/*****************************************************************************/
+/* FUNCTION: print_vectors_coords() 					     */
+/* PURPOSE: Prints coordinates to file in Vectors : x(i) y(j) z(k)	     */
+/* Writes no more than 10 values to each line.
+ * Note NX, NY, and NZ are at least 1
+ *
+ *      NX NY NZ
+ *    x(i) i = 1,nx
+ *    y(j) i = 1,ny
+ *    z(k) i = 1,nz
+ *
+ */
+/*****************************************************************************/
+void print_vectors_coords(num_xnodes, num_ynodes, num_znodes, out)
+int num_xnodes;
+int num_ynodes;
+int num_znodes;
+struct grid_out *out;
+   {
+     FILE *fp_out = out->fp;
+     const double *xcoords = out->coords[AXIS_X];
+     const double *ycoords = out->coords[AXIS_Y];
+     const double *zcoords = out->coords[AXIS_Z];
+
+
+     int i, n;
+     fprintf(fp_out, "%14d %14d %14d\n",num_xnodes,num_ynodes,num_znodes);
+
+/* A dry run skips the values, COORD_WIDTH + 1 bytes each. */
+     if (out->dry) {
+       for (i=0; i < 3; i++) {
+	 n = (i == 0) ? num_xnodes : (i == 1) ? num_ynodes : num_znodes;
+	 out_skip(out, (long long) n * (COORD_WIDTH + 1) + n / 10 + 
+	   (((n % 10) > 0) ? 1 : 0));
+       }
+       return;
+     }
+
+/* x(i)
+*/
+     for (i=0; i < num_xnodes; i++) {
+       fprintf(fp_out, "%20.12g ", xcoords[i]);
+       if (((i+1)%10) == 0) {
+	 fprintf(fp_out, "\n");
+       } 
+     }
+     /* don't put extra blank lines.  Flotran could freak out.  */
+     if ((num_xnodes > 0) && (num_xnodes % 10) > 0) {
+       fprintf(fp_out, "\n");
+     } 
+
+
+/* y(j)
+*/
+     for (i=0; i < num_ynodes; i++) {
+       fprintf(fp_out, "%20.12g ", ycoords[i]);
+       if (((i+1)%10) == 0) {
+	 fprintf(fp_out, "\n");
+       } 
+     }
+     /* don't put extra  blank lines.  Flotran could freak out.*/
+     if ((num_ynodes > 0) && (num_ynodes % 10) > 0) {
+       fprintf(fp_out, "\n");
+     } 
+
+
+/* z(k)
+*/
+     for (i=0; i < num_znodes; i++) {
+       fprintf(fp_out, "%20.12g ", zcoords[i]);   
+       if (((i+1)%10) == 0) {
+	 fprintf(fp_out, "\n");
+       } 
+     }
+     /* don't put extra  blank lines.  Flotran could freak out.*/
+     if ((num_znodes > 0) && (num_znodes % 10) > 0) {
+       fprintf(fp_out, "\n");
+     }
+
+   }
+
+/******************************************************************************/
+/* FUNCTION: print_tracer_coords         				      */
+/* PURPOSE: Prints coordinates to file in Tracer3d format.		      */
+/******************************************************************************/
+void print_tracer_coords(num_xnodes, num_ynodes, num_znodes, out)
+int num_xnodes;
+int num_ynodes;
+int num_znodes;
+struct grid_out *out;
+   {
+	FILE *fp_out = out->fp;
+	const double *xcoords = out->coords[AXIS_X];
+	const double *ycoords = out->coords[AXIS_Y];
+	const double *zcoords = out->coords[AXIS_Z];
+	int i;
+		/* Counter. */
+
+	/* A dry run skips the values, COORD_WIDTH + 3 bytes each, and */
+	/* the name and end of each line.                               */
+	if (out->dry)
+	   {
+		out_skip(out, ((long long) num_xnodes + num_ynodes + 
+			num_znodes) * (COORD_WIDTH + 3) + 3 * 3);
+		return;
+	   }
+
+	fprintf(fp_out, "rcm=");
+	for (i=0; i < num_xnodes-1; i++)
+	fprintf(fp_out, "%20.12g,1,", xcoords[i]);
+	fprintf(fp_out, "%20.12g,\n", xcoords[num_xnodes-1]);
+
+	fprintf(fp_out, "ycm=");
+	for (i=0; i < num_ynodes-1; i++)
+	fprintf(fp_out, "%20.12g,1,", ycoords[i]);
+	fprintf(fp_out, "%20.12g,\n", ycoords[num_ynodes-1]);
+
+	fprintf(fp_out, "zcm=");
+	for (i=0; i < num_znodes-1; i++)
+	fprintf(fp_out, "%20.12g,1,", zcoords[i]);
+	fprintf(fp_out, "%20.12g,\n", zcoords[num_znodes-1]);
+
+   }
+
+#ifndef GRIDDER_LIB
+/******************************************************************************/
+/* FUNCTION: print_spacing_info()						      */
+/* PURPOSE:  Prints out more info about spacing.			      */
+/******************************************************************************/
+void print_spacing_info()
+   {
+	int which_info;
+		/* Number describing which subject user would */
+		/* like more information about. */
+	int menu;
+		/* Allows user to return to menu when finished reading */
+		/* information. */
+	int error_count;
+		/* Counter */
+
+	error_count = 0;
+	printf("\n\nHELP MENU:\n\n");
+	do
+	   {
+		printf("Please input which subject you would like more ");
+		printf("information about: \n");
+		printf("0 = return to program.\n");
+	 	printf("1 = equally spaced nodes.\n");
+		printf("2 = geometric spacing of nodes.\n");
+		printf("3 = logarithmic spacing of nodes.\n");
+		scanf("%d", &which_info);
+		if ((which_info < 0) || (which_info > 3))
+		   {
+			printf("Please input a 0, 1, 2, or 3.\n\n");
+	             	error_count++;
+	             	if (error_count > ERR_LEVEL)
+	                   {
+	                	printf("You only get %d chances.\n",ERR_LEVEL);
+	                	printf("Program Exiting...\n");
+	                	exit(2);
+	                   }
+        	   }
+	   }
+	while ((which_info < 0)||(which_info > 3));
+
+	if (which_info == 0)
+		return;
+
+	if (which_info == 1)
+	   {
+		printf("\n\nEQUAL SPACING\n");
+		printf("\nIn a region with equal spacing, all of the nodes are equally spaced.  This distance between any two nodes in the region is equal to the length of the region divided by its number of divisions.  For example, if the user inputs a region 10 units long with 10 divisions, the distance between every pair of consecutive nodes in the region equals 1.  \n");
+
+	   }
+
+	else if(which_info == 2)
+	   {
+		printf("\n\nGEOMETRIC SPACING: \n\n");
+		printf("In a region with geometric spacing, the distance between each node increases by a factor inputted by the user.  (The user will be prompted for a geometric factor if he or she chooses geometric spacing of nodes.)  The length of any division in the region will be equal to the geometric factor times the length of the previous division.  Here is an example of a geometric series with a geometric factor of 2:\n");
+		printf("\n0, 1, 3, 7, 15, 31\n");
+		printf("\nHere, n1 = 0.  n2 = 1.  The geometric factor = 2. n3 is determined by the following formula: \nn3 = n2 + f*(n2 - n1)\nn3 = 1 + 2*(1-0) = 3\n\nn4 is determined similarly:\nn4 = n3 + f*(n3 - n2)/nn4 = 3 + 2*(3-1) = 7.  And so on for the rest of the nodes in the series. Geometric spacing is determined in the same fashion where the numbers in the series become the coordinates.\n\n");
+		printf("If the user wishes that the distance between each node decreases by a given factor, he or she should simply input as the geometric factor 1 divided by the factor of shrinkage desired. For example, to create a region where the distances between nodes becomes smaller by a factor of two, simply input as the geometric factor 0.5 = 1/2.\n");
+	   }
+
+	else if (which_info == 3)
+	   {
+		printf("\nLOGARTIHMIC SPACING: \n\n");
+		printf("In a region with logarithmically spaced nodes, the coordinates of the nodes are determined as a function of log base 10 of x.  Since by nature, this type of spacing results in smaller divisions towards the beginning of the region and larger divisions toward the end of the region, we have included as a separate spacing option a 'backwards' logarithmic spacing, where the the divisions are larger towards the beginning of the region and gradually become smaller (accordint to the funtion of log(x)) as they approach the end of the region. \n");
+	   }
+
+	printf("\nPress 1 to return to menu.\n");
+	scanf("%d", &menu);
+	if (menu == 1)
+		print_spacing_info();
+
+   }
+
+/******************************************************************************/
+/* FUNCTION: print_zone_bounds						      */
+/* PURPOSE:  Prints out which element numbers are in which zones.	      */
+/*           The bounds of each zone are looked up in the region start       */
+/*           tables of the grid.                                             */
+/******************************************************************************/
+
+
+void print_zone_bounds(grid)
+const struct grid *grid;
+   {
+	int first[3], last[3];
+		/* Node numbers at the bounds of a zone. */
+
+	int zone_num;
+		/* Zone number. */
+
+	for (zone_num=1; gridder_zone_bounds(grid, zone_num, first, last) == 
+			GRID_OK; zone_num++)
+	   {
+		printf("\nZone %d\n", zone_num);
+		printf("x boundaries: %20.12g", grid->coords[AXIS_X][first[AXIS_X]]);
+		printf("   %20.12g\n", grid->coords[AXIS_X][last[AXIS_X]]);
+		printf("y boundaries: %20.12g", grid->coords[AXIS_Y][first[AXIS_Y]]);
+		printf("   %20.12g\n", grid->coords[AXIS_Y][last[AXIS_Y]]);
+		printf("z boundaries: %20.12g", grid->coords[AXIS_Z][first[AXIS_Z]]);
+		printf("   %20.12g\n", grid->coords[AXIS_Z][last[AXIS_Z]]);
+	   }
+
+   }
+
+#endif /* GRIDDER_LIB */
+
+/****************************************************************************
+* Function: assign_elements_helper() 
+* Calls the assign_elements() with the arguments sorted depending on
+* the dimensions
+* 1: X
+* 2: XY
+* 3: XYZ
+* 4: Y
+* 5: Z
+* 6: XZ
+* 7: YZ
+* The region start tables are permuted with the nodes, so the zones are
+* numbered the same way for every option (x region fastest, then y, then
+* z, as print_zone_bounds() lists them).
+* Returns GRID_OK or a GRID_ERR_ value.
+****************************************************************************/
+int assign_elements_helper(num_xnodes, num_ynodes, num_znodes, 
+			  regionptrx, regionptry, regionptrz, 
+			  num_xregions, num_yregions, num_zregions, num_dimensions, 
+			  output, out)
+
+int num_xnodes;
+int num_ynodes;
+int num_znodes;
+int *regionptrx;
+int *regionptry;
+int *regionptrz;
+int num_xregions;
+int num_yregions;
+int num_zregions;
+int num_dimensions;
+int output;
+struct grid_out *out;
+{
+	if(DEBUG) printf("***>Nodes: x#: %d, y#: %d, z#: %d\n", num_xnodes, num_ynodes, num_znodes);
+	if(DEBUG) printf("***>Regions: x#: %d, y#: %d, z#: %d\n", num_xregions, num_yregions, num_zregions);
+  if(DEBUG) printf("**>NumDimensions in assign_element_helper: %d\n", num_dimensions);
+  switch(num_dimensions){
+	case 1:
+	case 2:
+	case 3:
+	  return assign_elements(num_xnodes, num_ynodes, num_znodes, 
+			  regionptrx, regionptry, regionptrz, 
+			  num_xregions, num_yregions, num_zregions, 
+			  num_dimensions, output, out);
+	case 4:
+	  return assign_elements(num_ynodes, num_xnodes, num_znodes, 
+			  regionptry, regionptrx, regionptrz, 
+			  num_yregions, num_xregions, num_zregions, 1, 
+			  output, out);
+	case 5:
+	  return assign_elements(num_znodes, num_xnodes, num_ynodes, 
+			  regionptrz, regionptrx, regionptry, 
+			  num_zregions, num_xregions, num_yregions, 1, 
+			  output, out);
+	case 6:
+	  return assign_elements(num_xnodes, num_znodes, num_ynodes, 
+			  regionptrx, regionptrz, regionptry, 
+			  num_xregions, num_zregions, num_yregions, 2, 
+			  output, out);
+	case 7:
+	  return assign_elements(num_ynodes, num_znodes, num_xnodes, 
+			  regionptry, regionptrz, regionptrx, 
+			  num_yregions, num_zregions, num_xregions, 2, 
+			  output, out);
+	default:
+	  return GRID_ERR_DIMENSION;
+  }
+}
+
+/******************************************************************************/
+/* Structured connectivity.  The elements of the grid are numbered with x    */
+/* fastest, then y, then z, so element e is (i,j,k) with                     */
+/*    e = i + j*(num_xnodes-1) + k*(num_xnodes-1)*(num_ynodes-1)             */
+/* and its first node is 1 + i + j*num_xnodes + k*num_xnodes*num_ynodes.     */
+/* The other nodes are fixed offsets from the first, and the zone is         */
+/* found from the region of i, j and k along each axis, so any element or    */
+/* range of elements can be produced on its own.  The regions come from the  */
+/* region start table of each axis (see struct grid): i through the region  */
+/* of every element along x, since it is needed for every element, and j    */
+/* and k by binary search once a row.                                        */
+/******************************************************************************/
+
+struct grid_elems {
+	int num_xnodes, num_ynodes, num_znodes;
+	int num_xelems, num_yelems, num_zelems;
+		/* Elements along each axis, 1 for an axis not used. */
+	long long num_elems;
+	int num_dimensions;
+		/* 1 = line, 2 = quad, 3 = hex. */
+	int nodes_per_elem;
+	long long offset[8];
+		/* Node numbers of an element minus its first node,   */
+		/* in the order they are written.  For a hex this is   */
+		/* the top of the hex then the bottom, counter         */
+		/* clockwise, as changed for AVS by tam Jul 2001.      */
+	int num_xregions, num_yregions, num_zregions;
+	const int *xstart, *ystart, *zstart;
+		/* First element of each region along each axis, */
+		/* and the number of elements at [num_regions].  */
+	int *xregion;
+		/* Region number (from 0) of each element along x. */
+	int output;
+		/* OUTPUT_AVS, OUTPUT_FEHM, OUTPUT_AVS_BINARY, OUTPUT_RAW, */
+		/* OUTPUT_VTR or OUTPUT_VTU.                               */
+};
+
+/******************************************************************************/
+/* FUNCTION: elem_regions()						      */
+/* PURPOSE:  Returns the region number (from 0) of each element along an     */
+/*           axis, from its table of region starts.  The caller frees the    */
+/*           result.                                                         */
+/******************************************************************************/
+static int *elem_regions(const int *start, int num_regions)
+   {
+	int *region;
+	int i, r;
+
+	region = malloc((size_t) (start[num_regions] > 0 ? start[num_regions] 
+		: 1) * sizeof(int));
+	if (region == NULL)
+		return NULL;
+
+	for (r=0; r < num_regions; r++)
+		for (i=start[r]; i < start[r + 1]; i++)
+			region[i] = r;
+	return region;
+   }
+
+static void grid_elems_free(struct grid_elems *g);
+
+/******************************************************************************/
+/* FUNCTION: grid_elems_init()						      */
+/* PURPOSE:  Sets up the connectivity of a grid.  Returns GRID_OK, or        */
+/*           GRID_ERR_MEMORY if the region tables cannot be allocated.       */
+/******************************************************************************/
+static int grid_elems_init(struct grid_elems *g, int num_xnodes, 
+		int num_ynodes, int num_znodes, const int *xstart, 
+		const int *ystart, const int *zstart, int num_xregions, 
+		int num_yregions, int num_zregions, int num_dimensions, 
+		int output)
+   {
+	long long nx = num_xnodes;
+	long long nxy = (long long) num_xnodes * num_ynodes;
+	int i;
+
+	g->num_xnodes = num_xnodes;
+	g->num_ynodes = num_ynodes;
+	g->num_znodes = num_znodes;
+	g->num_dimensions = num_dimensions;
+	g->num_xregions = num_xregions;
+	g->num_yregions = num_yregions;
+	g->num_zregions = num_zregions;
+	g->xstart = xstart;
+	g->ystart = ystart;
+	g->zstart = zstart;
+	g->output = output;
+
+	g->num_xelems = num_xnodes - 1;
+	g->num_yelems = (num_dimensions >= 2) ? num_ynodes - 1 : 1;
+	g->num_zelems = (num_dimensions >= 3) ? num_znodes - 1 : 1;
+	g->num_elems = (long long) g->num_xelems * g->num_yelems * g->num_zelems;
+
+	if (num_dimensions == 3)
+	   {
+		long long hex[8] = { nxy, nxy + 1, nxy + nx + 1, nxy + nx,
+				0, 1, nx + 1, nx };
+		g->nodes_per_elem = 8;
+		for (i=0; i < 8; i++)
+			g->offset[i] = hex[i];
+	   }
+	else if (num_dimensions == 2)
+	   {
+		long long quad[4] = { 0, 1, nx + 1, nx };
+		g->nodes_per_elem = 4;
+		for (i=0; i < 4; i++)
+			g->offset[i] = quad[i];
+	   }
+	else
+	   {
+		g->nodes_per_elem = 2;
+		g->offset[0] = 0;
+		g->offset[1] = 1;
+	   }
+
+	g->xregion = elem_regions(xstart, num_xregions);
+	if (g->xregion == NULL)
+		return GRID_ERR_MEMORY;
+	return GRID_OK;
+   }
+
+/******************************************************************************/
+/* FUNCTION: grid_elems_free()						      */
+/******************************************************************************/
+static void grid_elems_free(struct grid_elems *g)
+   {
+	free(g->xregion);
+	g->xregion = NULL;
+   }
+
+/******************************************************************************/
+/* FUNCTION: elem_position()						      */
+/* PURPOSE:  Finds i, j, k of element e (from 0), its first node and the    */
+/*           zone of the element at i = 0 of its row.                        */
+/******************************************************************************/
+static void elem_position(const struct grid_elems *g, long long e, int *i,
+		long long *node, int *zone_row)
+   {
+	int j, k;
+
+	*i = e % g->num_xelems;
+	j = (e / g->num_xelems) % g->num_yelems;
+	k = e / ((long long) g->num_xelems * g->num_yelems);
+	*node = 1 + *i + (long long) j * g->num_xnodes + 
+		(long long) k * g->num_xnodes * g->num_ynodes;
+	*zone_row = (region_of(g->ystart, g->num_yregions, j) + 
+		region_of(g->zstart, g->num_zregions, k) * g->num_yregions) * 
+		g->num_xregions + 1;
+   }
+
+static const char *elem_type_name[] = { "", " line ", " quad ", " hex " };
+
+/******************************************************************************/
+/* FUNCTION: elems_bytes()						      */
+/* PURPOSE:  Size of the connectivity lines of elements first ...            */
+/*           first+count-1 (from 0).  The element numbers are consecutive,  */
+/*           the node numbers and zones are counted a decade at a time by    */
+/*           strided_digits() and zone_digits().                             */
+/******************************************************************************/
+static long long elems_bytes(const void *ctx, long long first, 
+		long long count)
+   {
+	const struct grid_elems *g = ctx;
+	const int n[3] = { g->num_xelems, g->num_yelems, g->num_zelems };
+	const int *start[3] = { g->xstart, g->ystart, g->zstart };
+	const int num_regions[3] = { g->num_xregions, g->num_yregions, 
+		g->num_zregions };
+	static const int origin[3] = { 0, 0, 0 };
+	long long last = first + count, total;
+	int m;
+
+	/* Element number, nodes each "%4d ", newline. */
+	total = digits_sum(first + 1, last, 0) + count;
+	for (m=0; m < g->nodes_per_elem; m++)
+		total = total + count + strided_digits(n, first, last, 
+			1 + g->offset[m], g->num_xnodes, 
+			(long long) g->num_xnodes * g->num_ynodes, 4);
+
+	/* "   zone type" for AVS, a blank after the number for FEHM. */
+	if (g->output == OUTPUT_AVS)
+		total = total + count * (3 + strlen(elem_type_name[
+			g->num_dimensions])) + zone_digits(n, first, last, 
+			start, num_regions, origin);
+	else
+		total = total + count;
+	return total;
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_elements()						      */
+/* PURPOSE:  Writes the connectivity of elements first ... first+count-1     */
+/*           (from 0) to the buffer in AVS (output 1) or FEHM (output 4)     */
+/*           format.  Whole rows of x are written at a time; the zone along  */
+/*           a row only changes with the x region.                           */
+/******************************************************************************/
+static void write_elements(const void *ctx, long long first, long long count,
+		struct grid_buf *b)
+   {
+	const struct grid_elems *g = ctx;
+	int output = g->output;
+	const char *type = elem_type_name[g->num_dimensions];
+	int type_len = strlen(type);
+	int npe = g->nodes_per_elem;
+	long long e, last, row_end, node;
+	int i, m, zone_row, len;
+	char *p;
+
+	e = first;
+	last = first + count;
+	while (e < last)
+	   {
+		elem_position(g, e, &i, &node, &zone_row);
+		row_end = e - i + g->num_xelems;
+		if (row_end > last)
+			row_end = last;
+
+		for (; e < row_end; e++, i++, node++)
+		   {
+			p = grid_buf_reserve(b);
+			len = format_int(p, e + 1, 0, 0);
+			if (output == OUTPUT_AVS)
+			   {
+				p[len++] = ' ';
+				p[len++] = ' ';
+				p[len++] = ' ';
+				len = len + format_int(p + len, 
+					zone_row + g->xregion[i], 0, 0);
+				memcpy(p + len, type, type_len);
+				len = len + type_len;
+			   }
+			else
+				p[len++] = ' ';
+			for (m=0; m < npe; m++)
+			   {
+				len = len + format_int(p + len, 
+					node + g->offset[m], 4, 0);
+				p[len++] = ' ';
+			   }
+			p[len++] = '\n';
+			b->len = b->len + len;
+		   }
+	   }
+   }
+
+/******************************************************************************/
+/* Binary connectivity.  Each of these writes elements first ...            */
+/* first+count-1 (from 0) as fixed size records, see OUTPUT_AVS_BINARY and   */
+/* OUTPUT_RAW in gridder.h.                                                  */
+/******************************************************************************/
+
+/* AVS UCD cell types of a line, quad and hex. */
+static const int avs_cell_type[] = { 0, 1, 3, 7 };
+
+/* Cell information: cell id, material id (the zone), nodes, cell type. */
+static void write_avsb_cells(const void *ctx, long long first, 
+		long long count, struct grid_buf *b)
+   {
+	const struct grid_elems *g = ctx;
+	long long e, last = first + count, node;
+	int i, zone_row, rec[4];
+
+	rec[2] = g->nodes_per_elem;
+	rec[3] = avs_cell_type[g->num_dimensions];
+	for (e=first; e < last; e++, i++)
+	   {
+		if ((e == first) || (i == g->num_xelems))
+			elem_position(g, e, &i, &node, &zone_row);
+		rec[0] = e + 1;
+		rec[1] = zone_row + g->xregion[i];
+		memcpy(grid_buf_reserve(b), rec, sizeof(rec));
+		b->len = b->len + sizeof(rec);
+	   }
+   }
+
+/* Node list in the same order as the AVS text output. */
+static void write_avsb_nlist(const void *ctx, long long first, 
+		long long count, struct grid_buf *b)
+   {
+	const struct grid_elems *g = ctx;
+	long long e, last = first + count, node;
+	int i, m, zone_row, rec[8];
+	size_t rec_len = g->nodes_per_elem * sizeof(int);
+
+	for (e=first; e < last; e++, i++, node++)
+	   {
+		if ((e == first) || (i == g->num_xelems))
+			elem_position(g, e, &i, &node, &zone_row);
+		for (m=0; m < g->nodes_per_elem; m++)
+			rec[m] = node + g->offset[m];
+		memcpy(grid_buf_reserve(b), rec, rec_len);
+		b->len = b->len + rec_len;
+	   }
+   }
+
+/* Node numbers (from 1) as little-endian int64. */
+static void write_raw_nodes(const void *ctx, long long first, 
+		long long count, struct grid_buf *b)
+   {
+	const struct grid_elems *g = ctx;
+	long long e, last = first + count, node;
+	int i, m, zone_row;
+	char *p;
+
+	for (e=first; e < last; e++, i++, node++)
+	   {
+		if ((e == first) || (i == g->num_xelems))
+			elem_position(g, e, &i, &node, &zone_row);
+		p = grid_buf_reserve(b);
+		for (m=0; m < g->nodes_per_elem; m++)
+			put_le64(p + 8 * m, node + g->offset[m]);
+		b->len = b->len + 8 * g->nodes_per_elem;
+	   }
+   }
+
+/* Zones as little-endian int32. */
+static void write_raw_zones(const void *ctx, long long first, 
+		long long count, struct grid_buf *b)
+   {
+	const struct grid_elems *g = ctx;
+	long long e, last = first + count, node;
+	int i, zone_row;
+
+	for (e=first; e < last; e++, i++)
+	   {
+		if ((e == first) || (i == g->num_xelems))
+			elem_position(g, e, &i, &node, &zone_row);
+		put_le32(grid_buf_reserve(b), zone_row + g->xregion[i]);
+		b->len = b->len + 4;
+	   }
+   }
+
+/******************************************************************************/
+/* AVS node and cell data (spec.data), written after the connectivity.      */
+/* Each line is the node or element number and its values: the region       */
+/* (from 1) along each axis used for a node, the zone and then the same     */
+/* regions for an element.  The y and z regions are constant along a row   */
+/* of x and the x region only changes at the region starts, so the size of  */
+/* a row is summed a region at a time, like elems_bytes().                  */
+/******************************************************************************/
+
+struct grid_data {
+	const struct grid_elems *g;
+	int cells;
+		/* 1 for cell data, 0 for node data. */
+	int nx, ny, nz;
+		/* Nodes or elements along x, y and z of g. */
+	int num_values;
+		/* Values on each line. */
+	const int *start[3];
+	int num_regions[3], origin[3];
+		/* Region tables of the whole grid along x, y and z of g, and */
+		/* the node of it where g starts (a block, see write_blocks). */
+};
+
+/******************************************************************************/
+/* FUNCTION: data_position()						      */
+/* PURPOSE:  Finds i of record r (from 0) along its row, the regions (from  */
+/*           0) of its row along y and z, and the zone of the row at the     */
+/*           first x region.                                                 */
+/******************************************************************************/
+static void data_position(const struct grid_data *d, long long r, int *i,
+		int *ry, int *rz, int *zone_row)
+   {
+	*i = r % d->nx;
+	*ry = region_of(d->start[1], d->num_regions[1], 
+		d->origin[1] + (int) ((r / d->nx) % d->ny));
+	*rz = region_of(d->start[2], d->num_regions[2], 
+		d->origin[2] + (int) (r / ((long long) d->nx * d->ny)));
+	*zone_row = (*ry + *rz * d->num_regions[1]) * d->num_regions[0] + 1;
+   }
+
+/******************************************************************************/
+/* FUNCTION: data_x_region()						      */
+/* PURPOSE:  Region (from 0) along x of node or element i, and in seg_end   */
+/*           the first i past the end of that region.  The last node of the  */
+/*           axis belongs to the last region.  Regions are those of the     */
+/*           whole grid, so a node shared by two blocks has one region.     */
+/******************************************************************************/
+static int data_x_region(const struct grid_data *d, int i, int *seg_end)
+   {
+	int r = region_of(d->start[0], d->num_regions[0], d->origin[0] + i);
+
+	*seg_end = (r == d->num_regions[0] - 1) ? d->nx : 
+		d->start[0][r + 1] - d->origin[0];
+	if (*seg_end > d->nx)
+		*seg_end = d->nx;
+	return r;
+   }
+
+/******************************************************************************/
+/* FUNCTION: data_bytes()						      */
+/* PURPOSE:  Size of the data lines of records first ... first+count-1.     */
+/******************************************************************************/
+static long long data_bytes(const void *ctx, long long first, 
+		long long count)
+   {
+	const struct grid_data *d = ctx;
+	const int n[3] = { d->nx, d->ny, d->nz };
+	int dims = d->g->num_dimensions;
+	long long last = first + count, total;
+	int a;
+
+	/* Number, a blank before each value, newline. */
+	total = digits_sum(first + 1, last, 0) + count * (d->num_values + 1);
+	if (d->cells)
+		total = total + zone_digits(n, first, last, d->start, 
+			d->num_regions, d->origin);
+	for (a=0; a < dims; a++)
+		total = total + region_digits(n, first, last, a, d->start[a], 
+			d->num_regions[a], d->origin[a]);
+	return total;
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_data()						      */
+/* PURPOSE:  Writes the data lines of records first ... first+count-1.      */
+/******************************************************************************/
+static void write_data(const void *ctx, long long first, long long count,
+		struct grid_buf *b)
+   {
+	const struct grid_data *d = ctx;
+	int dims = d->g->num_dimensions;
+	long long e = first, last = first + count, row_end;
+	int i, r, ry, rz, seg_end, zone_row, len;
+	char *p;
+
+	while (e < last)
+	   {
+		data_position(d, e, &i, &ry, &rz, &zone_row);
+		row_end = e - i + d->nx;
+		if (row_end > last)
+			row_end = last;
+
+		r = data_x_region(d, i, &seg_end);
+		for (; e < row_end; e++, i++)
+		   {
+			if (i == seg_end)
+				r = data_x_region(d, i, &seg_end);
+			p = grid_buf_reserve(b);
+			len = format_int(p, e + 1, 0, 0);
+			if (d->cells)
+			   {
+				p[len++] = ' ';
+				len = len + format_int(p + len, zone_row + r, 
+					0, 0);
+			   }
+			p[len++] = ' ';
+			len = len + format_int(p + len, r + 1, 0, 0);
+			if (dims >= 2)
+			   {
+				p[len++] = ' ';
+				len = len + format_int(p + len, ry + 1, 0, 0);
+			   }
+			if (dims >= 3)
+			   {
+				p[len++] = ' ';
+				len = len + format_int(p + len, rz + 1, 0, 0);
+			   }
+			p[len++] = '\n';
+			b->len = b->len + len;
+		   }
+	   }
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_avs_data()						      */
+/* PURPOSE:  Writes the node data and then the cell data spec.data asks     */
+/*           for: the UCD component line, a label for each value and the    */
+/*           data lines.  Returns GRID_OK or GRID_ERR_.                      */
+/******************************************************************************/
+static int write_avs_data(const struct grid_elems *g, struct grid_out *out)
+   {
+	struct grid_data d;
+	struct grid_section sec;
+	static const int one_region[2] = { 0, 1 };
+	int a, num_axes = strlen(out->axes);
+	int error = GRID_OK;
+
+	d.g = g;
+	for (a=0; a < 3; a++)
+	   {
+		int axis = (a < num_axes) ? out->axes[a] - 'x' : -1;
+
+		d.start[a] = (axis >= 0) ? out->whole->region_start[axis] : 
+			one_region;
+		d.num_regions[a] = (axis >= 0) ? 
+			out->whole->num_regions[axis] : 1;
+		d.origin[a] = (axis >= 0) ? out->origin[axis] : 0;
+	   }
+	sec.ctx = &d;
+	sec.size = data_bytes;
+	sec.record_size = 0;
+	sec.write = write_data;
+	for (d.cells=0; (d.cells <= 1) && (error == GRID_OK); d.cells++)
+	   {
+		if (!(out->data & (d.cells ? GRID_DATA_CELLS : GRID_DATA_NODES)))
+			continue;
+		d.nx = d.cells ? g->num_xelems : g->num_xnodes;
+		d.ny = d.cells ? g->num_yelems : g->num_ynodes;
+		d.nz = d.cells ? g->num_zelems : g->num_znodes;
+		d.num_values = num_axes + d.cells;
+		sec.count = d.cells ? g->num_elems : 
+			(long long) g->num_xnodes * g->num_ynodes * g->num_znodes;
+
+		fprintf(out->fp, "%d", d.num_values);
+		for (a=0; a < d.num_values; a++)
+			fprintf(out->fp, " 1");
+		fprintf(out->fp, "\n");
+		if (d.cells)
+			fprintf(out->fp, "zone, integer\n");
+		for (a=0; a < num_axes; a++)
+			fprintf(out->fp, "region_%c, integer\n", out->axes[a]);
+		error = write_section(out, &sec);
+	   }
+	return error;
+   }
+
+/******************************************************************************/
+/* VTK unstructured pieces (OUTPUT_VTU).  The grid is cut into slabs of     */
+/* whole layers of elements along its last axis, so the elements of a slab  */
+/* and its nodes are each a run of consecutive numbers of the whole grid,   */
+/* and the connectivity of a piece is that of assign_elements() less the    */
+/* first node of the piece.  Each piece is a file of its own, written by    */
+/* one of the threads.                                                      */
+/******************************************************************************/
+
+/* VTK cell types of a line, quad and hex. */
+static const int vtk_cell_type[] = { 0, 3, 9, 12 };
+
+struct vtu_piece {
+	const struct grid_elems *g;
+	struct node_binary nodes;
+		/* x y z of the nodes of the whole grid. */
+	long long first_elem, num_elems;
+	long long first_node, num_nodes;
+	long long offset[8];
+		/* Node offsets in VTK order: a hex is the bottom, then */
+		/* the top, where AVS has the top first.                */
+};
+
+struct vtu_job {
+	const struct grid_elems *g;
+	const struct grid_out *out;
+	pthread_mutex_t lock;
+	int error;
+};
+
+/******************************************************************************/
+/* FUNCTION: vtu_piece_init()						      */
+/* PURPOSE:  Sets up piece p of out->num_pieces: its elements and nodes.    */
+/******************************************************************************/
+static void vtu_piece_init(struct vtu_piece *piece, const struct grid_elems *g,
+		const struct grid_out *out, int p)
+   {
+	long long layers, layer_elems, layer_nodes, l0, l1;
+	int m, n[3];
+
+	/* The nodes in the order of the axes of the grid, not of g. */
+	n[AXIS_X] = n[AXIS_Y] = n[AXIS_Z] = 1;
+	n[out->axes[0] - 'x'] = g->num_xnodes;
+	if (g->num_dimensions >= 2)
+		n[out->axes[1] - 'x'] = g->num_ynodes;
+	if (g->num_dimensions >= 3)
+		n[out->axes[2] - 'x'] = g->num_znodes;
+	piece->g = g;
+	piece->nodes.num_xnodes = n[AXIS_X];
+	piece->nodes.num_ynodes = n[AXIS_Y];
+	piece->nodes.num_znodes = n[AXIS_Z];
+	piece->nodes.axis = -1;
+	piece->nodes.xcoords = out->coords[AXIS_X];
+	piece->nodes.ycoords = out->coords[AXIS_Y];
+	piece->nodes.zcoords = out->coords[AXIS_Z];
+
+	if (g->num_dimensions == 3)
+	   {
+		layers = g->num_zelems;
+		layer_nodes = (long long) g->num_xnodes * g->num_ynodes;
+	   }
+	else if (g->num_dimensions == 2)
+	   {
+		layers = g->num_yelems;
+		layer_nodes = g->num_xnodes;
+	   }
+	else
+	   {
+		layers = g->num_xelems;
+		layer_nodes = 1;
+	   }
+	layer_elems = g->num_elems / layers;
+	l0 = layers * p / out->num_pieces;
+	l1 = layers * (p + 1) / out->num_pieces;
+	piece->first_elem = l0 * layer_elems;
+	piece->num_elems = (l1 - l0) * layer_elems;
+	piece->first_node = l0 * layer_nodes;
+	piece->num_nodes = (l1 - l0 + 1) * layer_nodes;
+
+	for (m=0; m < g->nodes_per_elem; m++)
+		piece->offset[m] = (g->nodes_per_elem == 8) ? 
+			g->offset[(m + 4) % 8] : g->offset[m];
+   }
+
+/* Each of these writes records first ... first+count-1 of a piece. */
+
+/* x y z of the nodes. */
+static void write_vtu_points(const void *ctx, long long first, 
+		long long count, struct grid_buf *b)
+   {
+	const struct vtu_piece *piece = ctx;
+
+	write_node_values(&piece->nodes, piece->first_node + first, count, b);
+   }
+
+/* Node numbers (from 0 in the piece) of each element. */
+static void write_vtu_cells(const void *ctx, long long first, 
+		long long count, struct grid_buf *b)
+   {
+	const struct vtu_piece *piece = ctx;
+	const struct grid_elems *g = piece->g;
+	long long e, last, node, base = piece->first_node + 1;
+	int i, m, zone_row;
+	char *p;
+
+	first = first + piece->first_elem;
+	last = first + count;
+	for (e=first; e < last; e++, i++, node++)
+	   {
+		if ((e == first) || (i == g->num_xelems))
+			elem_position(g, e, &i, &node, &zone_row);
+		p = grid_buf_reserve(b);
+		for (m=0; m < g->nodes_per_elem; m++)
+			put_le64(p + 8 * m, node + piece->offset[m] - base);
+		b->len = b->len + 8 * g->nodes_per_elem;
+	   }
+   }
+
+/* End of the node list of each element. */
+static void write_vtu_offsets(const void *ctx, long long first, 
+		long long count, struct grid_buf *b)
+   {
+	const struct vtu_piece *piece = ctx;
+	long long e;
+
+	for (e=first; e < first + count; e++)
+	   {
+		put_le64(grid_buf_reserve(b), 
+			(e + 1) * piece->g->nodes_per_elem);
+		b->len = b->len + 8;
+	   }
+   }
+
+/* Cell type of each element. */
+static void write_vtu_types(const void *ctx, long long first, 
+		long long count, struct grid_buf *b)
+   {
+	const struct vtu_piece *piece = ctx;
+	long long e;
+
+	for (e=0; e < count; e++)
+	   {
+		*grid_buf_reserve(b) = 
+			(char) vtk_cell_type[piece->g->num_dimensions];
+		b->len = b->len + 1;
+	   }
+   }
+
+/* Zone of each element. */
+static void write_vtu_zones(const void *ctx, long long first, 
+		long long count, struct grid_buf *b)
+   {
+	const struct vtu_piece *piece = ctx;
+
+	write_raw_zones(piece->g, piece->first_elem + first, count, b);
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_vtu_piece()						      */
+/* PURPOSE:  Writes piece p to out->fp: the XML with the offset of each     */
+/*           array, then the arrays as raw appended data.  Returns GRID_OK  */
+/*           or GRID_ERR_.                                                   */
+/******************************************************************************/
+static int write_vtu_piece(const struct grid_elems *g, struct grid_out *out,
+		int p)
+   {
+	static const char *name[] = { "Float64\" NumberOfComponents=\"3",
+		"Int64\" Name=\"connectivity", "Int64\" Name=\"offsets",
+		"UInt8\" Name=\"types", "Int32\" Name=\"zone" };
+	struct vtu_piece piece;
+	struct grid_section sec[5];
+	long long offset[5];
+	char count[8];
+	FILE *fp = out->fp;
+	int a, error = GRID_OK;
+
+	vtu_piece_init(&piece, g, out, p);
+	for (a=0; a < 5; a++)
+	   {
+		sec[a].ctx = &piece;
+		sec[a].count = piece.num_elems;
+		sec[a].size = NULL;
+	   }
+	sec[0].count = piece.num_nodes;
+	sec[0].record_size = 24;
+	sec[0].write = write_vtu_points;
+	sec[1].record_size = 8 * g->nodes_per_elem;
+	sec[1].write = write_vtu_cells;
+	sec[2].record_size = 8;
+	sec[2].write = write_vtu_offsets;
+	sec[3].record_size = 1;
+	sec[3].write = write_vtu_types;
+	sec[4].record_size = 4;
+	sec[4].write = write_vtu_zones;
+	offset[0] = 0;
+	for (a=1; a < 5; a++)
+		offset[a] = offset[a - 1] + 8 + 
+			sec[a - 1].count * sec[a - 1].record_size;
+
+	fprintf(fp, "<?xml version=\"1.0\"?>\n");
+	fprintf(fp, "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" "
+		"byte_order=\"LittleEndian\" header_type=\"UInt64\">\n");
+	fprintf(fp, "  <UnstructuredGrid>\n");
+	fprintf(fp, "    <Piece NumberOfPoints=\"%lld\" NumberOfCells=\"%lld\">\n",
+		piece.num_nodes, piece.num_elems);
+	for (a=0; a < 5; a++)
+	   {
+		if (a == 0)
+			fprintf(fp, "      <Points>\n");
+		else if (a == 1)
+			fprintf(fp, "      <Cells>\n");
+		else if (a == 4)
+			fprintf(fp, "      <CellData Scalars=\"zone\">\n");
+		fprintf(fp, "        <DataArray type=\"%s\" format=\"appended\" "
+			"offset=\"%lld\"/>\n", name[a], offset[a]);
+		if (a == 0)
+			fprintf(fp, "      </Points>\n");
+		else if (a == 3)
+			fprintf(fp, "      </Cells>\n");
+		else if (a == 4)
+			fprintf(fp, "      </CellData>\n");
+	   }
+	fprintf(fp, "    </Piece>\n");
+	fprintf(fp, "  </UnstructuredGrid>\n");
+	fprintf(fp, "  <AppendedData encoding=\"raw\">\n   _");
+
+	for (a=0; (a < 5) && (error == GRID_OK); a++)
+	   {
+		put_le64(count, sec[a].count * sec[a].record_size);
+		if (fwrite(count, 1, 8, fp) != 8)
+			error = GRID_ERR_IO;
+		else
+			error = write_section(out, &sec[a]);
+	   }
+	fprintf(fp, "\n  </AppendedData>\n</VTKFile>\n");
+	if ((error == GRID_OK) && (fflush(fp) != 0 || ferror(fp)))
+		error = GRID_ERR_IO;
+	return error;
+   }
+
+/******************************************************************************/
+/* FUNCTION: vtu_piece_work()						      */
+/* PURPOSE:  Writes piece item to its own file, for run_threads().          */
+/******************************************************************************/
+static void vtu_piece_work(void *arg, long long item, int thread)
+   {
+	struct vtu_job *job = arg;
+	struct grid_out out = *job->out;
+	char path[4096];
+	int error = GRID_OK;
+
+	/* The piece has this thread to itself. */
+	out.num_threads = 1;
+	out.stats = NULL;
+	out.bytes = 0;
+	if (snprintf(path, sizeof(path), "%s_%lld.vtu", out.piece_name, 
+			item) >= (int) sizeof(path))
+		error = GRID_ERR_IO;
+	else if ((out.fp = fopen(path, out.map ? "w+" : "w")) == NULL)
+		error = GRID_ERR_IO;
+	else
+	   {
+		error = write_vtu_piece(job->g, &out, item);
+		if ((fclose(out.fp) != 0) && (error == GRID_OK))
+			error = GRID_ERR_IO;
+	   }
+
+	pthread_mutex_lock(&job->lock);
+	if (job->error == GRID_OK)
+		job->error = error;
+	pthread_mutex_unlock(&job->lock);
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_vtu()						      */
+/* PURPOSE:  Writes the .pvtu listing the pieces to out->fp and the pieces  */
+/*           on the threads.  A dry run writes the pieces after the .pvtu   */
+/*           in out->fp instead, so its size is that of all of them.        */
+/*           Returns GRID_OK or GRID_ERR_.                                   */
+/******************************************************************************/
+static int write_vtu(const struct grid_elems *g, struct grid_out *out)
+   {
+	struct vtu_job job;
+	const char *source = strrchr(out->piece_name, '/');
+	long long layers;
+	int p, error = GRID_OK;
+
+	/* No more pieces than layers of elements. */
+	layers = (g->num_dimensions == 3) ? g->num_zelems : 
+		(g->num_dimensions == 2) ? g->num_yelems : g->num_xelems;
+	if (out->num_pieces > layers)
+		out->num_pieces = layers;
+	source = (source != NULL) ? source + 1 : out->piece_name;
+
+	fprintf(out->fp, "<?xml version=\"1.0\"?>\n");
+	fprintf(out->fp, "<VTKFile type=\"PUnstructuredGrid\" version=\"1.0\" "
+		"byte_order=\"LittleEndian\" header_type=\"UInt64\">\n");
+	fprintf(out->fp, "  <PUnstructuredGrid GhostLevel=\"0\">\n");
+	fprintf(out->fp, "    <PPoints>\n");
+	fprintf(out->fp, "      <PDataArray type=\"Float64\" "
+		"NumberOfComponents=\"3\"/>\n");
+	fprintf(out->fp, "    </PPoints>\n");
+	fprintf(out->fp, "    <PCellData Scalars=\"zone\">\n");
+	fprintf(out->fp, "      <PDataArray type=\"Int32\" Name=\"zone\"/>\n");
+	fprintf(out->fp, "    </PCellData>\n");
+	for (p=0; p < out->num_pieces; p++)
+		fprintf(out->fp, "    <Piece Source=\"%s_%d.vtu\"/>\n", source, p);
+	fprintf(out->fp, "  </PUnstructuredGrid>\n");
+	fprintf(out->fp, "</VTKFile>\n");
+
+	if (out->dry)
+	   {
+		for (p=0; (p < out->num_pieces) && (error == GRID_OK); p++)
+			error = write_vtu_piece(g, out, p);
+		return error;
+	   }
+
+	job.g = g;
+	job.out = out;
+	job.error = GRID_OK;
+	pthread_mutex_init(&job.lock, NULL);
+	run_threads(out->num_threads, out->num_pieces, vtu_piece_work, &job);
+	pthread_mutex_destroy(&job.lock);
+	return job.error;
+   }
+
+/******************************************************************************/
+/* FEHM zone files (spec.zones), written by the FEHM writer next to the      */
+/* grid file.  Every zone is a box of nodes: a face of the grid is the box   */
+/* with one node along its axis, and a region is the box of the node ranges  */
+/* of its regions along x, y and z.  The lists are written as sections, so   */
+/* they are sized and formatted a row of x at a time and never scanned.      */
+/******************************************************************************/
+
+/* Nodes per line of a zone list. */
+#define ZONE_LINE 10
+
+/* The nodes of a zone, x fastest, as numbered in the grid file. */
+struct zone_box {
+	int nx, ny;
+		/* Nodes of the grid along x and y. */
+	int first[3], n[3];
+		/* First node (from 0) and nodes of the box along x, y, z. */
+	long long count;
+};
+
+/******************************************************************************/
+/* FUNCTION: zone_box_node()						      */
+/* PURPOSE:  Number (from 1) of node r of a box, and in i its position      */
+/*           along the row of x.                                             */
+/******************************************************************************/
+static long long zone_box_node(const struct zone_box *z, long long r, int *i)
+   {
+	long long row = r / z->n[0];
+
+	*i = r % z->n[0];
+	return 1 + z->first[0] + *i + (long long) z->nx * 
+		(z->first[1] + row % z->n[1] + (long long) z->ny * 
+		(z->first[2] + row / z->n[1]));
+   }
+
+/******************************************************************************/
+/* FUNCTION: zone_box_bytes()						      */
+/* PURPOSE:  Size of nodes first ... first+count-1 of a zone list: " %10d"  */
+/*           each and a newline after every ZONE_LINE and the last.          */
+/******************************************************************************/
+static long long zone_box_bytes(const void *ctx, long long first, 
+		long long count)
+   {
+	const struct zone_box *z = ctx;
+	long long last = first + count, total;
+
+	total = count + strided_digits(z->n, first, last, 1 + z->first[0] + 
+		(long long) z->nx * (z->first[1] + (long long) z->ny * 
+		z->first[2]), z->nx, (long long) z->nx * z->ny, 10);
+	total = total + last / ZONE_LINE - first / ZONE_LINE;
+	if ((z->count % ZONE_LINE != 0) && (last == z->count))
+		total++;
+	return total;
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_zone_box()						      */
+/* PURPOSE:  Writes nodes first ... first+count-1 of a zone list.           */
+/******************************************************************************/
+static void write_zone_box(const void *ctx, long long first, 
+		long long count, struct grid_buf *b)
+   {
+	const struct zone_box *z = ctx;
+	long long r, last = first + count, node = 0;
+	int i = 0, len;
+	char *p;
+
+	for (r=first; r < last; r++, i++, node++)
+	   {
+		if ((r == first) || (i == z->n[0]))
+			node = zone_box_node(z, r, &i);
+		p = grid_buf_reserve(b);
+		p[0] = ' ';
+		len = 1 + format_int(p + 1, node, 10, 0);
+		if ((r % ZONE_LINE == ZONE_LINE - 1) || (r == z->count - 1))
+			p[len++] = '\n';
+		b->len = b->len + len;
+	   }
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_zone()						      */
+/* PURPOSE:  Writes one zone of a zone or zonn macro: its number and name,  */
+/*           and the nodes of the box of the whole grid from lo to hi along */
+/*           each axis, as far as it lies in the grid written.  A zone with  */
+/*           no nodes there is left out.  Returns GRID_OK or GRID_ERR_.      */
+/******************************************************************************/
+static int write_zone(const struct grid *grid, struct grid_out *out, 
+		int zone, const char *name, const int lo[3], const int hi[3])
+   {
+	struct zone_box z;
+	struct grid_section sec;
+	int a, first, last;
+
+	z.count = 1;
+	for (a=AXIS_X; a <= AXIS_Z; a++)
+	   {
+		first = (lo[a] > out->origin[a]) ? lo[a] : out->origin[a];
+		last = out->origin[a] + grid->num_nodes[a] - 1;
+		if (hi[a] < last)
+			last = hi[a];
+		if (last < first)
+			return GRID_OK;
+		z.first[a] = first - out->origin[a];
+		z.n[a] = last - first + 1;
+		z.count = z.count * z.n[a];
+	   }
+	z.nx = grid->num_nodes[AXIS_X];
+	z.ny = grid->num_nodes[AXIS_Y];
+
+	if (name != NULL)
+		fprintf(out->fp, "%05d  %s\n", zone, name);
+	else
+		fprintf(out->fp, "%05d\n", zone);
+	fprintf(out->fp, "nnum\n%10lld\n", z.count);
+
+	sec.ctx = &z;
+	sec.count = z.count;
+	sec.size = zone_box_bytes;
+	sec.record_size = 0;
+	sec.write = write_zone_box;
+	return write_section(out, &sec);
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_outside_zones()					      */
+/* PURPOSE:  Writes the faces of the whole grid as a zonn macro, numbered   */
+/*           and named as LaGriT does: 1 top (z max), 2 bottom (z min),      */
+/*           3 left_w (x min), 4 front_n (y max), 5 right_e (x max) and      */
+/*           6 back_s (y min).  Faces across an unused axis are left out.    */
+/******************************************************************************/
+static int write_outside_zones(const struct grid *grid, struct grid_out *out)
+   {
+	static const char *name[6] = { "top", "bottom", "left_w", "front_n",
+		"right_e", "back_s" };
+	static const int axis[6] = { AXIS_Z, AXIS_Z, AXIS_X, AXIS_Y, AXIS_X,
+		AXIS_Y };
+	static const int high[6] = { 1, 0, 0, 1, 1, 0 };
+	const struct grid *whole = out->whole;
+	int lo[3], hi[3], a, f;
+	int error = GRID_OK;
+
+	fprintf(out->fp, "zonn\n");
+	for (f=0; (f < 6) && (error == GRID_OK); f++)
+	   {
+		if (whole->num_nodes[axis[f]] == 1)
+			continue;
+		for (a=AXIS_X; a <= AXIS_Z; a++)
+		   {
+			lo[a] = 0;
+			hi[a] = whole->num_nodes[a] - 1;
+		   }
+		if (high[f])
+			lo[axis[f]] = hi[axis[f]];
+		else
+			hi[axis[f]] = lo[axis[f]];
+		error = write_zone(grid, out, f + 1, name[f], lo, hi);
+	   }
+	fprintf(out->fp, "\nstop\n");
+	return error;
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_material_zones()					      */
+/* PURPOSE:  Writes a zone macro with the nodes of every zone of the grid,  */
+/*           numbered as the zones of the elements.  A node on the boundary */
+/*           of two regions is in the one that starts there, as in the AVS  */
+/*           node data, so every node is in one zone.                        */
+/******************************************************************************/
+static int write_material_zones(const struct grid *grid, struct grid_out *out)
+   {
+	const struct grid *whole = out->whole;
+	int r[3], lo[3], hi[3], a, zone = 1;
+	int error = GRID_OK;
+
+	fprintf(out->fp, "zone\n");
+	for (r[2]=0; r[2] < whole->num_regions[AXIS_Z]; r[2]++)
+	  for (r[1]=0; r[1] < whole->num_regions[AXIS_Y]; r[1]++)
+	    for (r[0]=0; (r[0] < whole->num_regions[AXIS_X]) && 
+			(error == GRID_OK); r[0]++, zone++)
+	       {
+		for (a=AXIS_X; a <= AXIS_Z; a++)
+		   {
+			lo[a] = whole->region_start[a][r[a]];
+			hi[a] = (r[a] == whole->num_regions[a] - 1) ? 
+				whole->num_nodes[a] - 1 : 
+				whole->region_start[a][r[a] + 1] - 1;
+		   }
+		error = write_zone(grid, out, zone, NULL, lo, hi);
+	       }
+	fprintf(out->fp, "\nstop\n");
+	return error;
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_fehm_zones()						      */
+/* PURPOSE:  Writes the zone files spec.zones asks for to                    */
+/*           <piece_name>_outside.zone and <piece_name>_material.zone, or   */
+/*           with dry set skips over them in out->fp.  Returns GRID_OK or    */
+/*           GRID_ERR_.                                                      */
+/******************************************************************************/
+static int write_fehm_zones(const struct grid *grid, 
+		const struct grid_spec *spec, const struct grid_out *out)
+   {
+	static const char *kind[2] = { "outside", "material" };
+	struct grid_out zout;
+	char path[4096];
+	int f, error = GRID_OK;
+
+	for (f=0; (f < 2) && (error == GRID_OK); f++)
+	   {
+		if (!(spec->zones & (f ? GRID_ZONES_MATERIAL : 
+				GRID_ZONES_OUTSIDE)))
+			continue;
+		zout = *out;
+		if (!out->dry)
+		   {
+			if (snprintf(path, sizeof(path), "%s_%s.zone", 
+					out->piece_name, kind[f]) >= 
+					(int) sizeof(path))
+				return GRID_ERR_IO;
+			zout.fp = fopen(path, out->map ? "w+" : "w");
+			if (zout.fp == NULL)
+				return GRID_ERR_IO;
+		   }
+
+		out_phase_begin(&zout, GRID_PHASE_ZONES);
+		error = f ? write_material_zones(grid, &zout) : 
+			write_outside_zones(grid, &zout);
+		if ((error == GRID_OK) && (fflush(zout.fp) != 0 || 
+				ferror(zout.fp)))
+			error = GRID_ERR_IO;
+		out_phase_end(&zout, 0);
+		if (!out->dry && (fclose(zout.fp) != 0) && (error == GRID_OK))
+			error = GRID_ERR_IO;
+	   }
+	return error;
+   }
+
+/******************************************************************************/
+/* FEHM sparse matrix file (spec.stor), written by the FEHM writer next to   */
+/* the grid file.  The control volume of a node of an orthogonal grid is    */
+/* the product of its half spacings along the axes used, and the face to a  */
+/* neighbor along an axis has the area of the product along the other axes, */
+/* so the whole matrix of the 7-point stencil follows from the coordinates. */
+/* Row p holds its neighbors along z, y and x below it, itself and those    */
+/* above it, in order.  The entries of the rows before node p are counted   */
+/* in closed form (stor_row_start()), so every array is a section that any  */
+/* thread can start anywhere, and only the half spacings are kept.          */
+/******************************************************************************/
+
+/* Values on each line of the .stor file. */
+#define STOR_LINE 5
+
+/* The arrays of the file, in order. */
+#define STOR_VOLUMES  0	/* volume of each node                        */
+#define STOR_ROWS     1	/* row pointers, then the column of each entry */
+#define STOR_POINTERS 2	/* coefficient used by each entry            */
+#define STOR_PADDING  3	/* neq+1 zeros                                */
+#define STOR_DIAGONAL 4	/* position of each diagonal entry            */
+#define STOR_COEFS    5	/* -area/distance of each entry               */
+
+struct stor {
+	int n[3];
+		/* Nodes along x, y and z. */
+	long long neq, ncoef;
+		/* Nodes and entries of the matrix. */
+	const double *coords[3];
+	double *half[3];
+		/* Half the Voronoi length of each node along each axis, 1 */
+		/* along an unused one.                                   */
+};
+
+/* One array of the file, see write_section(). */
+struct stor_part {
+	const struct stor *s;
+	int kind;
+	long long count;
+};
+
+/* An entry of the matrix and the row it is in. */
+struct stor_entry {
+	long long row;
+	int pos[3];
+		/* Node (from 0) of the row and its i, j, k. */
+	int num, m;
+		/* Entries in the row and the one t is at. */
+	long long col[7];
+	int axis[7], link[7];
+		/* Column (from 0) of each entry, and the axis and the */
+		/* lower node along it of its link, axis -1 for the    */
+		/* diagonal.                                           */
+};
+
+/******************************************************************************/
+/* FUNCTION: stor_links(), stor_links_before()				      */
+/* PURPOSE:  Neighbors of node i along an axis of n nodes, and the sum of   */
+/*           them over nodes 0 ... m-1.                                      */
+/******************************************************************************/
+static int stor_links(int n, int i)
+   {
+	return (n < 2) ? 0 : 2 - (i == 0) - (i == n - 1);
+   }
+
+static long long stor_links_before(int n, int m)
+   {
+	return (n < 2) ? 0 : 2LL * m - (m >= 1) - (m >= n);
+   }
+
+/******************************************************************************/
+/* FUNCTION: stor_row_start()						      */
+/* PURPOSE:  Entries in the rows of nodes 0 ... p-1; p = neq gives ncoef.   */
+/******************************************************************************/
+static long long stor_row_start(const struct stor *s, long long p)
+   {
+	long long nx = s->n[0], ny = s->n[1];
+	int i = p % nx;
+	int j = (p / nx) % ny;
+	int k = p / (nx * ny);
+
+	return p + (k * ny + j) * stor_links_before(s->n[0], s->n[0]) + 
+		stor_links_before(s->n[0], i) + 
+		k * nx * stor_links_before(s->n[1], s->n[1]) + 
+		nx * stor_links_before(s->n[1], j) + 
+		i * stor_links(s->n[1], j) + 
+		nx * ny * stor_links_before(s->n[2], k) + 
+		(j * nx + i) * stor_links(s->n[2], k);
+   }
+
+/******************************************************************************/
+/* FUNCTION: stor_row()							      */
+/* PURPOSE:  Sets t to the first entry of row p.                             */
+/******************************************************************************/
+static void stor_row(const struct stor *s, long long p, struct stor_entry *t)
+   {
+	long long step[3];
+	int a;
+
+	step[0] = 1;
+	step[1] = s->n[0];
+	step[2] = (long long) s->n[0] * s->n[1];
+	t->row = p;
+	t->pos[0] = p % s->n[0];
+	t->pos[1] = (p / s->n[0]) % s->n[1];
+	t->pos[2] = p / step[2];
+	t->num = 0;
+	t->m = 0;
+	for (a=AXIS_Z; a >= AXIS_X; a--)
+		if (t->pos[a] > 0)
+		   {
+			t->col[t->num] = p - step[a];
+			t->axis[t->num] = a;
+			t->link[t->num++] = t->pos[a] - 1;
+		   }
+	t->col[t->num] = p;
+	t->axis[t->num++] = -1;
+	for (a=AXIS_X; a <= AXIS_Z; a++)
+		if (t->pos[a] < s->n[a] - 1)
+		   {
+			t->col[t->num] = p + step[a];
+			t->axis[t->num] = a;
+			t->link[t->num++] = t->pos[a];
+		   }
+   }
+
+/******************************************************************************/
+/* FUNCTION: stor_seek(), stor_next()					      */
+/* PURPOSE:  Sets t to entry e (from 0) of the matrix, or steps it to the   */
+/*           next one.                                                       */
+/******************************************************************************/
+static void stor_seek(const struct stor *s, long long e, struct stor_entry *t)
+   {
+	long long lo = 0, hi = s->neq - 1, mid;
+
+	while (lo < hi)
+	   {
+		mid = lo + (hi - lo + 1) / 2;
+		if (stor_row_start(s, mid) <= e)
+			lo = mid;
+		else
+			hi = mid - 1;
+	   }
+	stor_row(s, lo, t);
+	t->m = (int) (e - stor_row_start(s, lo));
+   }
+
+static void stor_next(const struct stor *s, struct stor_entry *t)
+   {
+	if (++t->m == t->num)
+		stor_row(s, t->row + 1, t);
+   }
+
+/******************************************************************************/
+/* FUNCTION: stor_coef()						      */
+/* PURPOSE:  -area/distance of the link of an entry, 0 on the diagonal.     */
+/******************************************************************************/
+static double stor_coef(const struct stor *s, const struct stor_entry *t)
+   {
+	int a = t->axis[t->m], b;
+	double area = 1.0;
+
+	if (a < 0)
+		return 0.0;
+	for (b=0; b < 3; b++)
+		if (b != a)
+			area = area * s->half[b][t->pos[b]];
+	return -area / (s->coords[a][t->link[t->m] + 1] - 
+		s->coords[a][t->link[t->m]]);
+   }
+
+/******************************************************************************/
+/* FUNCTION: stor_bytes()						      */
+/* PURPOSE:  Size of records first ... first+count-1 of an array: 20       */
+/*           characters a real, 10 an integer, and a newline after every    */
+/*           STOR_LINE and the last.                                         */
+/******************************************************************************/
+static long long stor_bytes(const void *ctx, long long first, long long count)
+   {
+	const struct stor_part *part = ctx;
+	long long last = first + count;
+	int width = ((part->kind == STOR_VOLUMES) || 
+		(part->kind == STOR_COEFS)) ? 20 : 10;
+
+	return count * width + last / STOR_LINE - first / STOR_LINE + 
+		((part->count % STOR_LINE != 0) && (last == part->count));
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_stor()						      */
+/* PURPOSE:  Writes records first ... first+count-1 of an array, reals as   */
+/*           %20.12E and integers as %10d.                                   */
+/******************************************************************************/
+static void write_stor(const void *ctx, long long first, long long count,
+		struct grid_buf *b)
+   {
+	const struct stor_part *part = ctx;
+	const struct stor *s = part->s;
+	struct stor_entry t;
+	long long r, last = first + count, value = 0;
+	double x = 0.0;
+	int len, real = 0;
+	char *p, rec[32];
+
+	if (part->kind == STOR_COEFS)
+		stor_seek(s, first, &t);
+	else if ((part->kind == STOR_ROWS) && (last > s->neq + 1))
+		stor_seek(s, (first > s->neq) ? first - s->neq - 1 : 0, &t);
+
+	for (r=first; r < last; r++)
+	   {
+		switch (part->kind)
+		   {
+			case STOR_VOLUMES:
+				stor_row(s, r, &t);
+				x = s->half[0][t.pos[0]] * s->half[1][t.pos[1]] * 
+					s->half[2][t.pos[2]];
+				real = 1;
+				break;
+			case STOR_ROWS:
+				if (r <= s->neq)
+					value = s->neq + 1 + stor_row_start(s, r);
+				else
+				   {
+					value = t.col[t.m] + 1;
+					stor_next(s, &t);
+				   }
+				break;
+			case STOR_POINTERS:
+				value = r + 1;
+				break;
+			case STOR_PADDING:
+				value = 0;
+				break;
+			case STOR_DIAGONAL:
+				stor_row(s, r, &t);
+				value = s->neq + 2 + stor_row_start(s, r) + 
+					(t.pos[0] > 0) + (t.pos[1] > 0) + 
+					(t.pos[2] > 0);
+				break;
+			case STOR_COEFS:
+				x = stor_coef(s, &t);
+				real = 1;
+				stor_next(s, &t);
+				break;
+		   }
+		p = grid_buf_reserve(b);
+		/* snprintf() ends with a NUL, which past the last record of */
+		/* a chunk in a mapping would land on the next chunk.         */
+		if (real)
+		   {
+			len = snprintf(rec, sizeof(rec), "%20.12E", x);
+			memcpy(p, rec, len);
+		   }
+		else
+			len = format_int(p, value, 10, 0);
+		if ((r % STOR_LINE == STOR_LINE - 1) || (r == part->count - 1))
+			p[len++] = '\n';
+		b->len = b->len + len;
+	   }
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_fehm_stor()						      */
+/* PURPOSE:  Writes the .stor file of spec.stor to <piece_name>.stor, or    */
+/*           with dry set skips over it in out->fp.  The half spacings are   */
+/*           those of the whole grid, so a block keeps the volumes of its    */
+/*           nodes in the whole grid but only the links inside it.  Returns */
+/*           GRID_OK or GRID_ERR_.                                           */
+/******************************************************************************/
+static int write_fehm_stor(const struct grid *grid, 
+		const struct grid_spec *spec, const struct grid_out *out)
+   {
+	const struct grid *whole = out->whole;
+	struct stor s;
+	struct stor_part part[6];
+	struct grid_out sout = *out;
+	char path[4096], date[32];
+	const double *x;
+	time_t now;
+	struct tm tm;
+	int a, i, g, n, ncon_max = 1;
+	int error = GRID_OK;
+
+	s.neq = 1;
+	for (a=AXIS_X; a <= AXIS_Z; a++)
+	   {
+		s.n[a] = grid->num_nodes[a];
+		s.coords[a] = grid->coords[a];
+		s.neq = s.neq * s.n[a];
+		ncon_max = ncon_max + ((s.n[a] > 2) ? 2 : s.n[a] - 1);
+	   }
+	s.ncoef = stor_row_start(&s, s.neq);
+	if (s.neq + 1 + s.ncoef > 9999999999LL)
+		return GRID_ERR_TOO_LARGE;
+
+	/* A dry run only needs stor_bytes(). */
+	for (a=AXIS_X; a <= AXIS_Z; a++)
+		s.half[a] = NULL;
+	for (a=AXIS_X; (a <= AXIS_Z) && !out->dry; a++)
+	   {
+		s.half[a] = malloc((size_t) s.n[a] * sizeof(double));
+		if (s.half[a] == NULL)
+			error = GRID_ERR_MEMORY;
+		else
+		   {
+			x = whole->coords[a];
+			n = whole->num_nodes[a];
+			for (i=0; i < s.n[a]; i++)
+			   {
+				g = out->origin[a] + i;
+				s.half[a][i] = (n < 2) ? 1.0 : 
+					0.5 * (((g < n - 1) ? x[g + 1] : x[g]) - 
+					((g > 0) ? x[g - 1] : x[g]));
+			   }
+		   }
+	   }
+
+	if ((error == GRID_OK) && !out->dry)
+	   {
+		if (snprintf(path, sizeof(path), "%s.stor", out->piece_name) >= 
+				(int) sizeof(path))
+			error = GRID_ERR_IO;
+		else if ((sout.fp = fopen(path, out->map ? "w+" : "w")) == NULL)
+			error = GRID_ERR_IO;
+	   }
+	if (error != GRID_OK)
+	   {
+		for (a=AXIS_X; a <= AXIS_Z; a++)
+			free(s.half[a]);
+		return error;
+	   }
+
+	out_phase_begin(&sout, GRID_PHASE_ELEMS);
+	/* The title lines LaGriT writes, for the tools that check them. */
+	now = time(NULL);
+	if ((localtime_r(&now, &tm) == NULL) || 
+			(strftime(date, sizeof(date), "%a %b %e %H:%M:%S %Y", 
+			&tm) != 24))
+		strcpy(date, "Thu Jan  1 00:00:00 1970");
+	fprintf(sout.fp, "%s LaGriT Sparse Matrix Voronoi Coefficients\n", 
+		GRID_STOR_FORMAT);
+	fprintf(sout.fp, "%s %d-D Linear Diffusion Model (matbld3d_astor)\n", 
+		date, (int) strlen(gridder_axes(spec->num_dimensions)));
+	fprintf(sout.fp, "%10lld%10lld%10lld%10d%10d\n", s.ncoef, s.neq, 
+		s.ncoef + s.neq + 1, 1, ncon_max);
+	for (a=0; a < 6; a++)
+	   {
+		part[a].s = &s;
+		part[a].kind = a;
+		part[a].count = (a == STOR_VOLUMES) ? s.neq : 
+			(a == STOR_ROWS) ? s.neq + 1 + s.ncoef : 
+			(a == STOR_PADDING) ? s.neq + 1 : 
+			(a == STOR_DIAGONAL) ? s.neq : s.ncoef;
+	   }
+	for (a=0; (a < 6) && (error == GRID_OK); a++)
+	   {
+		struct grid_section sec;
+
+		sec.ctx = &part[a];
+		sec.count = part[a].count;
+		sec.size = stor_bytes;
+		sec.record_size = 0;
+		sec.write = write_stor;
+		error = write_section(&sout, &sec);
+	   }
+	if ((error == GRID_OK) && (fflush(sout.fp) != 0 || ferror(sout.fp)))
+		error = GRID_ERR_IO;
+	out_phase_end(&sout, 0);
+	if (!out->dry && (fclose(sout.fp) != 0) && (error == GRID_OK))
+		error = GRID_ERR_IO;
+	for (a=AXIS_X; a <= AXIS_Z; a++)
+		free(s.half[a]);
+	return error;
+   }
+
+/******************************************************************************/
+/* Block decomposition (spec.blocks).  Block (p, q, r) of Px*Py*Pz owns the  */
+/* elements n*p/Px ... n*(p+1)/Px-1 of the n along x, and so on, and is      */
+/* written with spec.ghost more layers of elements on each side that lie in  */
+/* the grid.  A block is a grid of its own: its coordinates point into the   */
+/* whole grid and its region tables are those of the whole grid cut to the   */
+/* block, with the regions outside it left empty, so the writers number its  */
+/* nodes and elements from 1 and give them the zones of the whole grid.  The */
+/* ids and owners in the maps are worked out from the position alone.        */
+/******************************************************************************/
+
+struct block_set {
+	const struct grid *grid;
+	const struct grid_spec *spec;
+		/* Spec each block is written with: no blocks, one thread. */
+	const char *name;
+		/* Blocks go to name_<n><extension> and name_<n>.map. */
+	int dry;
+	FILE *fp;
+		/* With dry set every block goes to fp instead. */
+	int num_blocks[3], num_elems[3];
+		/* Blocks and layers of elements along x, y and z. */
+	int num_block_files, ghost;
+	pthread_mutex_t lock;
+	int error;
+	long long bytes;
+		/* Written to the block files, for the stats. */
+};
+
+/* Nodes or elements of a block, for its map. */
+struct block_ids {
+	const struct block_set *set;
+	int first[3], size[3];
+		/* First node or element (from 0) along x, y and z, and how many. */
+	int total[3];
+		/* Nodes or elements of the whole grid along x, y and z. */
+};
+
+/******************************************************************************/
+/* FUNCTION: spec_num_blocks()						      */
+/* PURPOSE:  Number of blocks spec.blocks asks for, 1 for none, INT_MAX if  */
+/*           that does not fit in an int.                                    */
+/******************************************************************************/
+static int spec_num_blocks(const struct grid_spec *spec)
+   {
+	long long n = 1;
+	int a;
+
+	for (a=AXIS_X; a <= AXIS_Z; a++)
+		if (spec->blocks[a] > 1)
+			n = (n * spec->blocks[a] > INT_MAX) ? INT_MAX : 
+				n * spec->blocks[a];
+	return (int) n;
+   }
+
+/******************************************************************************/
+/* FUNCTION: block_of()							      */
+/* PURPOSE:  Block (from 0) along an axis of n elements in p blocks owning  */
+/*           element e.  Node e is owned with element e, the last node with */
+/*           the last element.                                               */
+/******************************************************************************/
+static int block_of(long long e, int n, int p)
+   {
+	if (e >= n)
+		e = n - 1;
+	return (int) (((e + 1) * p - 1) / n);
+   }
+
+/******************************************************************************/
+/* FUNCTION: block_extent()						      */
+/* PURPOSE:  The elements block position p along axis a owns, and the       */
+/*           first node and number of nodes written with its ghosts.         */
+/******************************************************************************/
+static void block_extent(const struct block_set *set, int a, int p,
+		int *own_first, int *own_count, int *first, int *nodes)
+   {
+	long long n = set->num_elems[a];
+	int w0, w1;
+
+	*own_first = (int) (n * p / set->num_blocks[a]);
+	*own_count = (int) (n * (p + 1) / set->num_blocks[a]) - *own_first;
+	w0 = *own_first - set->ghost;
+	w1 = *own_first + *own_count + set->ghost;
+	*first = (w0 > 0) ? w0 : 0;
+	*nodes = ((w1 < n) ? w1 : (int) n) - *first + 1;
+
+	/* An unused axis has one node and one layer of elements. */
+	if (set->grid->num_nodes[a] == 1)
+		*nodes = 1;
+   }
+
+/******************************************************************************/
+/* FUNCTION: block_position()						      */
+/* PURPOSE:  Position along x, y and z in the whole grid of record n of     */
+/*           the nodes or elements of a block.                               */
+/******************************************************************************/
+static void block_position(const struct block_ids *ids, long long n, 
+		int pos[3])
+   {
+	pos[0] = ids->first[0] + (int) (n % ids->size[0]);
+	n = n / ids->size[0];
+	pos[1] = ids->first[1] + (int) (n % ids->size[1]);
+	pos[2] = ids->first[2] + (int) (n / ids->size[1]);
+   }
+
+/******************************************************************************/
+/* FUNCTION: block_next()						      */
+/* PURPOSE:  Steps pos to the next record, x fastest.                        */
+/******************************************************************************/
+static void block_next(const struct block_ids *ids, int pos[3])
+   {
+	int a;
+
+	for (a=0; a < 2; a++)
+	   {
+		if (++pos[a] < ids->first[a] + ids->size[a])
+			return;
+		pos[a] = ids->first[a];
+	   }
+	pos[2]++;
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_block_ids()						      */
+/* PURPOSE:  Writes the global numbers (from 1) of records first ...        */
+/*           first+count-1 of a block as int64.                              */
+/******************************************************************************/
+static void write_block_ids(const void *ctx, long long first, 
+		long long count, struct grid_buf *b)
+   {
+	const struct block_ids *ids = ctx;
+	long long n;
+	int pos[3];
+
+	block_position(ids, first, pos);
+	for (n=0; n < count; n++)
+	   {
+		put_le64(grid_buf_reserve(b), 1 + pos[0] + ids->total[0] * 
+			(pos[1] + (long long) ids->total[1] * pos[2]));
+		b->len = b->len + 8;
+		block_next(ids, pos);
+	   }
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_block_owners()					      */
+/* PURPOSE:  Writes the block (from 0) owning records first ...             */
+/*           first+count-1 of a block as int32.                              */
+/******************************************************************************/
+static void write_block_owners(const void *ctx, long long first, 
+		long long count, struct grid_buf *b)
+   {
+	const struct block_ids *ids = ctx;
+	const struct block_set *set = ids->set;
+	long long n;
+	int pos[3], owner[3], a;
+
+	block_position(ids, first, pos);
+	for (n=0; n < count; n++)
+	   {
+		for (a=0; a < 3; a++)
+			owner[a] = block_of(pos[a], set->num_elems[a], 
+				set->num_blocks[a]);
+		put_le32(grid_buf_reserve(b), owner[0] + set->num_blocks[0] * 
+			(owner[1] + set->num_blocks[1] * owner[2]));
+		b->len = b->len + 4;
+		block_next(ids, pos);
+	   }
+   }
+
+/******************************************************************************/
+/* FUNCTION: block_ids_count()						      */
+/******************************************************************************/
+static long long block_ids_count(const struct block_ids *ids)
+   {
+	return (long long) ids->size[0] * ids->size[1] * ids->size[2];
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_block_map()						      */
+/* PURPOSE:  Writes the map of block n, see GRID_MAP_MAGIC.  Returns GRID_OK */
+/*           or GRID_ERR_.                                                   */
+/******************************************************************************/
+static int write_block_map(const struct block_set *set, int n, 
+		const int first[3], const int nodes[3], FILE *fp)
+   {
+	const struct grid *grid = set->grid;
+	struct block_ids node_ids, elem_ids;
+	struct grid_section sec[4];
+	struct grid_out out;
+	char head[GRID_MAP_HEADER];
+	int a, error = GRID_OK;
+
+	for (a=AXIS_X; a <= AXIS_Z; a++)
+	   {
+		node_ids.first[a] = elem_ids.first[a] = first[a];
+		node_ids.size[a] = nodes[a];
+		node_ids.total[a] = grid->num_nodes[a];
+		elem_ids.size[a] = (nodes[a] > 1) ? nodes[a] - 1 : 1;
+		elem_ids.total[a] = set->num_elems[a];
+	   }
+	node_ids.set = elem_ids.set = set;
+	for (a=0; a < 4; a++)
+	   {
+		sec[a].ctx = (a % 2 == 0) ? &node_ids : &elem_ids;
+		sec[a].count = block_ids_count(sec[a].ctx);
+		sec[a].size = NULL;
+		sec[a].record_size = (a < 2) ? 8 : 4;
+		sec[a].write = (a < 2) ? write_block_ids : write_block_owners;
+	   }
+
+	memset(head, 0, sizeof(head));
+	memcpy(head, GRID_MAP_MAGIC, 8);
+	put_le64(head + 8, sec[0].count);
+	put_le64(head + 16, sec[1].count);
+	put_le32(head + 24, n);
+	put_le32(head + 28, set->num_block_files);
+	for (a=AXIS_X; a <= AXIS_Z; a++)
+	   {
+		put_le32(head + 32 + 4 * a, first[a]);
+		put_le32(head + 44 + 4 * a, nodes[a]);
+	   }
+	put_le32(head + 56, set->ghost);
+	if (fwrite(head, 1, sizeof(head), fp) != sizeof(head))
+		return GRID_ERR_IO;
+
+	memset(&out, 0, sizeof(out));
+	out.fp = fp;
+	out.num_threads = 1;
+	out.map = set->spec->map && !set->dry;
+	out.dry = set->dry;
+	for (a=0; (a < 4) && (error == GRID_OK); a++)
+		error = write_section(&out, &sec[a]);
+	if ((error == GRID_OK) && (fflush(fp) != 0 || ferror(fp)))
+		error = GRID_ERR_IO;
+	return error;
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_block()						      */
+/* PURPOSE:  Writes block n to fp_grid in the output format and its map to   */
+/*           fp_map.  Returns GRID_OK or GRID_ERR_.                          */
+/******************************************************************************/
+static int write_block(const struct block_set *set, int n, FILE *fp_grid, 
+		FILE *fp_map)
+   {
+	const struct grid *grid = set->grid;
+	struct grid_spec spec = *set->spec;
+	struct grid block;
+	char name[4096];
+	int first[3], nodes[3], own_first, own_count, elems, start;
+	int a, r, p = n, num_tables = 0;
+	int *table;
+	int error;
+
+	for (a=AXIS_X; a <= AXIS_Z; a++)
+		num_tables = num_tables + 2 * grid->num_regions[a] + 1;
+	table = malloc((size_t) num_tables * sizeof(int));
+	if (table == NULL)
+		return GRID_ERR_MEMORY;
+
+	block.num_elems = 1;
+	for (a=AXIS_X; a <= AXIS_Z; a++)
+	   {
+		block_extent(set, a, p % set->num_blocks[a], &own_first, 
+			&own_count, &first[a], &nodes[a]);
+		p = p / set->num_blocks[a];
+		elems = (nodes[a] > 1) ? nodes[a] - 1 : 1;
+
+		block.num_nodes[a] = nodes[a];
+		block.num_regions[a] = grid->num_regions[a];
+		block.region_start[a] = table;
+		block.num_elems_per_region[a] = table + grid->num_regions[a] + 1;
+		table = table + 2 * grid->num_regions[a] + 1;
+		for (r=0; r <= grid->num_regions[a]; r++)
+		   {
+			start = grid->region_start[a][r] - first[a];
+			block.region_start[a][r] = (start < 0) ? 0 : 
+				(start > elems) ? elems : start;
+		   }
+		for (r=0; r < grid->num_regions[a]; r++)
+			block.num_elems_per_region[a][r] = 
+				block.region_start[a][r + 1] - 
+				block.region_start[a][r];
+		block.coords[a] = set->dry ? grid->coords[a] : 
+			grid->coords[a] + first[a];
+		block.max_nodes[a] = 0;
+		block.max_regions[a] = 0;
+		block.num_elems = block.num_elems * elems;
+	   }
+
+	/* Zone files of a block are named after it. */
+	snprintf(name, sizeof(name), "%s_%d", set->name, n);
+	spec.piece_name = name;
+	error = grid_write_part(&block, grid, first, &spec, fp_grid, 
+		set->dry);
+	if (error == GRID_OK)
+		error = write_block_map(set, n, first, nodes, fp_map);
+	free(block.region_start[AXIS_X]);
+	return error;
+   }
+
+/******************************************************************************/
+/* FUNCTION: block_work()						      */
+/* PURPOSE:  Writes block item to its own files, see run_threads().         */
+/******************************************************************************/
+static void block_work(void *arg, long long item, int thread)
+   {
+	struct block_set *set = arg;
+	const char *mode = set->spec->map ? "w+" : "w";
+	FILE *fp_grid = NULL, *fp_map = NULL;
+	char path[4096];
+	long long bytes = 0;
+	int error = GRID_OK;
+
+	if (snprintf(path, sizeof(path), "%s_%lld%s", set->name, item, 
+			gridder_extension(set->spec->output)) >= 
+			(int) sizeof(path))
+		error = GRID_ERR_IO;
+	else if ((fp_grid = fopen(path, mode)) == NULL)
+		error = GRID_ERR_IO;
+	else if (snprintf(path, sizeof(path), "%s_%lld.map", set->name, 
+			item) >= (int) sizeof(path))
+		error = GRID_ERR_IO;
+	else if ((fp_map = fopen(path, mode)) == NULL)
+		error = GRID_ERR_IO;
+	else
+	   {
+		error = write_block(set, (int) item, fp_grid, fp_map);
+		bytes = ftello(fp_grid) + ftello(fp_map);
+	   }
+	if ((fp_grid != NULL) && (fclose(fp_grid) != 0) && (error == GRID_OK))
+		error = GRID_ERR_IO;
+	if ((fp_map != NULL) && (fclose(fp_map) != 0) && (error == GRID_OK))
+		error = GRID_ERR_IO;
+
+	pthread_mutex_lock(&set->lock);
+	if (set->error == GRID_OK)
+		set->error = error;
+	set->bytes = set->bytes + bytes;
+	pthread_mutex_unlock(&set->lock);
+   }
+
+/******************************************************************************/
+/* FUNCTION: write_blocks()						      */
+/* PURPOSE:  Writes the blocks of spec.blocks, a block to a thread, and     */
+/*           lists them in fp_out.  With dry set the blocks are skipped over */
+/*           in fp_out after the list instead.  Returns GRID_OK or          */
+/*           GRID_ERR_.                                                      */
+/******************************************************************************/
+static int write_blocks(const struct grid *grid, const struct grid_spec *spec,
+		FILE *fp_out, int dry)
+   {
+	struct grid_spec block_spec = *spec;
+	struct block_set set;
+	struct grid_out out;
+	const char *source;
+	long long num_blocks = 1;
+	int own_first[3], own_count[3], first[3], nodes[3];
+	int a, n, p;
+	int error = GRID_OK;
+
+	if ((spec->output < OUTPUT_AVS) || (spec->output > OUTPUT_LAST))
+		return GRID_ERR_OUTPUT;
+
+	/* No more blocks along an axis than layers of elements. */
+	set.grid = grid;
+	set.spec = &block_spec;
+	set.name = (spec->piece_name != NULL) ? spec->piece_name : "grid";
+	set.dry = dry;
+	set.fp = fp_out;
+	set.ghost = (spec->ghost > 0) ? spec->ghost : 0;
+	for (a=AXIS_X; a <= AXIS_Z; a++)
+	   {
+		set.num_elems[a] = grid->region_start[a][grid->num_regions[a]];
+		set.num_blocks[a] = (spec->blocks[a] < 1) ? 1 : 
+			(spec->blocks[a] > set.num_elems[a]) ? 
+			set.num_elems[a] : spec->blocks[a];
+		num_blocks = num_blocks * set.num_blocks[a];
+	   }
+	if (num_blocks > INT_MAX)
+		return GRID_ERR_TOO_LARGE;
+	set.num_block_files = (int) num_blocks;
+	set.error = GRID_OK;
+	set.bytes = 0;
+
+	/* Each block is one grid, written by one thread and not compressed. */
+	for (a=AXIS_X; a <= AXIS_Z; a++)
+		block_spec.blocks[a] = 0;
+	block_spec.num_threads = 1;
+	block_spec.stats = NULL;
+	block_spec.compress = 0;
+	block_spec.cache = NULL;
+
+	source = strrchr(set.name, '/');
+	source = (source != NULL) ? source + 1 : set.name;
+	fprintf(fp_out, "# gridder blocks: block, grid file, id map, first node "
+		"(from 0) and nodes\n");
+	fprintf(fp_out, "# along x y z, first element owned (from 0) and "
+		"elements owned along x y z.\n");
+	fprintf(fp_out, "blocks %d %d %d %d ghost %d\n", set.num_block_files, 
+		set.num_blocks[0], set.num_blocks[1], set.num_blocks[2], 
+		set.ghost);
+	fprintf(fp_out, "nodes %d %d %d\n", grid->num_nodes[0], 
+		grid->num_nodes[1], grid->num_nodes[2]);
+	for (n=0; n < set.num_block_files; n++)
+	   {
+		for (a=AXIS_X, p=n; a <= AXIS_Z; a++)
+		   {
+			block_extent(&set, a, p % set.num_blocks[a], 
+				&own_first[a], &own_count[a], &first[a], 
+				&nodes[a]);
+			p = p / set.num_blocks[a];
+		   }
+		fprintf(fp_out, "%d %s_%d%s %s_%d.map %d %d %d %d %d %d "
+			"%d %d %d %d %d %d\n", n, source, n, 
+			gridder_extension(spec->output), source, n, 
+			first[0], first[1], first[2], nodes[0], nodes[1], 
+			nodes[2], own_first[0], own_first[1], own_first[2], 
+			own_count[0], own_count[1], own_count[2]);
+	   }
+	if (fflush(fp_out) != 0 || ferror(fp_out))
+		return GRID_ERR_IO;
+
+	memset(&out, 0, sizeof(out));
+	out.fp = fp_out;
+	out.stats = spec->stats;
+	out_phase_begin(&out, GRID_PHASE_ELEMS);
+	if (dry)
+	   {
+		for (n=0; (n < set.num_block_files) && (error == GRID_OK); n++)
+			error = write_block(&set, n, fp_out, fp_out);
+	   }
+	else
+	   {
+		pthread_mutex_init(&set.lock, NULL);
+		run_threads((spec->num_threads > 1) ? spec->num_threads : 1, 
+			set.num_block_files, block_work, &set);
+		pthread_mutex_destroy(&set.lock);
+		error = set.error;
+	   }
+	out.phase_start = -1;
+	out.bytes = set.bytes;
+	out_phase_end(&out, grid->num_elems);
+	return error;
+   }
+
+/******************************************************************************/
+/* FUNCTION: visit_elements()						      */
+/* PURPOSE:  Hands the connectivity and zones to a grid_visitor a block at   */
+/*           a time.  Returns GRID_OK, GRID_ERR_MEMORY or the value the      */
+/*           visitor returned to stop.                                       */
+/******************************************************************************/
+static int visit_elements(const struct grid_elems *g, 
+		const struct grid_visitor *v)
+   {
+	long long block = (v->block > 0) ? v->block : GRID_VISIT_BLOCK;
+	long long first, count, e, node, *nodes;
+	int i, m, n, zone_row, *zones;
+	int error = GRID_OK;
+
+	if (v->elems == NULL)
+		return GRID_OK;
+	if (block > g->num_elems)
+		block = g->num_elems;
+	nodes = malloc((size_t) block * g->nodes_per_elem * sizeof(long long));
+	zones = malloc((size_t) block * sizeof(int));
+
+	if ((nodes == NULL) || (zones == NULL))
+		error = GRID_ERR_MEMORY;
+	for (first=0; (error == GRID_OK) && (first < g->num_elems); 
+			first += count)
+	   {
+		count = g->num_elems - first;
+		if (count > block)
+			count = block;
+		for (n=0, e=first; n < count; n++, e++, i++, node++)
+		   {
+			if ((n == 0) || (i == g->num_xelems))
+				elem_position(g, e, &i, &node, &zone_row);
+			for (m=0; m < g->nodes_per_elem; m++)
+				nodes[(long long) n * g->nodes_per_elem + m] = 
+					node + g->offset[m];
+			zones[n] = zone_row + g->xregion[i];
+		   }
+		error = v->elems(v->arg, first, count, g->nodes_per_elem, 
+			nodes, zones);
+	   }
+
+	free(nodes);
+	free(zones);
+	return error;
+   }
+
+/******************************************************************************/
+/* FUNCTION: assign_elements						      */
+/* PURPOSE:  Calculates connectivity.					      */
+/******************************************************************************/
+
+int assign_elements( num_xnodes, num_ynodes, num_znodes, 
+                xstart, ystart, zstart, num_xregions, 
+                num_yregions, num_zregions, num_dimensions, output, out)
+int num_xnodes;
+int num_ynodes;
+int num_znodes;
+int *xstart;
+int *ystart;
+int *zstart;
+int num_xregions;
+int num_yregions;
+int num_zregions;
+int num_dimensions;
+int output;
+struct grid_out *out;
+   {
+	struct grid_elems g;
+		/* Connectivity of the grid. */
+
+	struct grid_section sec;
+	int error;
+
+	error = grid_elems_init(&g, num_xnodes, num_ynodes, num_znodes, 
+			xstart, ystart, zstart, num_xregions, num_yregions, 
+			num_zregions, num_dimensions, output);
+	if (error != GRID_OK)
+		return error;
+	if(DEBUG) printf("**>Num elements: %lld\n", g.num_elems);
+
+	if (out->visitor != NULL)
+	   {
+		error = visit_elements(&g, out->visitor);
+		grid_elems_free(&g);
+		return error;
+	   }
+
+	sec.ctx = &g;
+	sec.count = g.num_elems;
+	sec.size = NULL;
+	switch (output) {
+	  case OUTPUT_AVS_BINARY:
+		/* Cell information, then the node list of every cell. */
+		sec.record_size = 4 * sizeof(int);
+		sec.write = write_avsb_cells;
+		error = write_section(out, &sec);
+		sec.record_size = g.nodes_per_elem * sizeof(int);
+		sec.write = write_avsb_nlist;
+		if (error == GRID_OK)
+			error = write_section(out, &sec);
+		break;
+
+	  case OUTPUT_RAW:
+		/* Connectivity, then the zone of every element. */
+		sec.record_size = g.nodes_per_elem * 8;
+		sec.write = write_raw_nodes;
+		error = write_section(out, &sec);
+		sec.record_size = 4;
+		sec.write = write_raw_zones;
+		if (error == GRID_OK)
+			error = write_section(out, &sec);
+		break;
+
+	  case OUTPUT_VTR:
+		/* Zone cell data, in the same order and form as raw. */
+		sec.record_size = 4;
+		sec.write = write_raw_zones;
+		error = write_section(out, &sec);
+		break;
+
+	  case OUTPUT_VTU:
+		error = write_vtu(&g, out);
+		break;
+
+	  default:
+		sec.size = elems_bytes;
+		sec.record_size = 0;
+		sec.write = write_elements;
+		error = write_section(out, &sec);
+		if ((error == GRID_OK) && (output == OUTPUT_AVS) && out->data)
+			error = write_avs_data(&g, out);
+		break;
+	}
 
-                node_ident++;        
-           }	
+	grid_elems_free(&g);
+	return error;
    }
 
 /* end gridder.c */
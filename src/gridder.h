@@ -0,0 +1,389 @@
+/* gridder.h */
+
+/**************************************************************/
+/*              GRIDDER V3 - Simple Grid Generator            */
+/**************************************************************/
+
+/*
+Los Alamos National Security, LLC (LANS) owns the copyright to gridder,
+which it identifies internally as LA-CC-15-082. The license is BSD with
+a "modifications must be indicated" clause.
+See LICENSE.md for the full text.
+*/
+
+/************************************************************************/
+/*  Non-interactive interface to the gridder engine.                    */
+/*									*/
+/*  A grid is completely described by a grid_spec: the dimension and    */
+/*  direction option (same numbers as the interactive menu), the        */
+/*  regions of each axis and the output format.  gridder_build() turns  */
+/*  a spec into a grid file and never prompts or prints, so it can be   */
+/*  called from other programs.  Compile gridder.c with -DGRIDDER_LIB   */
+/*  to leave out the interactive main() and link it with your driver:   */
+/*									*/
+/*     gcc -c -DGRIDDER_LIB gridder.c                                   */
+/*     gcc mydriver.c gridder.o -lm -lpthread                           */
+/*									*/
+/*  Add -DHAVE_ZLIB and -lz for compressed output (spec.compress).      */
+/*									*/
+/*  The regions of an axis are allocated by gridder_spec_regions(),     */
+/*  which sets num_regions; release them with gridder_spec_free().      */
+/*									*/
+/*  gridder_read_spec() reads a grid_spec from the numbers the          */
+/*  interactive gridder saves in input.grid.                            */
+/*									*/
+/*  The interactive gridder is a front end that fills in a grid_spec    */
+/*  from the prompts and then calls the same engine functions.          */
+/************************************************************************/
+
+#ifndef GRIDDER_H
+#define GRIDDER_H
+
+#include <stdio.h>
+
+/* Limits on the size of a grid.  The coordinate and region arrays are */
+/* allocated as big as each grid needs, these only keep node, region   */
+/* and zone counts inside an int.                                      */
+#define MAXNODES (1 << 30)	/* nodes along one axis            */
+#define MAXZONES (1 << 30)	/* regions of an axis, and zones   */
+
+/* Spacing of the nodes in a region, same numbers as the spacing menu. */
+#define SPACING_EQUAL      1
+#define SPACING_GEOMETRIC  2
+#define SPACING_LOG_SMALL  3	/* logarithmic, small spacing to large */
+#define SPACING_LOG_LARGE  4	/* logarithmic, large spacing to small */
+
+/* Output formats, same numbers as the output menu. */
+#define OUTPUT_AVS      1
+#define OUTPUT_TRACER   2
+#define OUTPUT_VECTORS  3
+#define OUTPUT_FEHM     4
+#define OUTPUT_AVS_BINARY 5	/* AVS binary UCD, machine byte order */
+#define OUTPUT_RAW      6	/* raw little-endian arrays, see below */
+#define OUTPUT_VTR      7	/* VTK XML RectilinearGrid, see below  */
+#define OUTPUT_VTU      8	/* VTK XML UnstructuredGrid pieces     */
+#define OUTPUT_LAST     OUTPUT_VTU
+
+/* Layout of an OUTPUT_RAW file.  All numbers are little-endian and     */
+/* every block starts on an 8 byte boundary, so the file can be mmap'd  */
+/* and the blocks used as arrays:                                       */
+/*									*/
+/*   offset  0  char[8]  "GRIDRAW1"                                     */
+/*           8  int64    number of nodes                                */
+/*          16  int64    number of elements                             */
+/*          24  int32    nodes per element (2 line, 4 quad, 8 hex)      */
+/*          28  int32    dimension option 1-7                           */
+/*          32  int64    offset of the coordinates                      */
+/*          40  int64    offset of the connectivity                     */
+/*          48  int64    offset of the zones                            */
+/*          56  int64    size of the file                               */
+/*          64  float64  x, y, z of each node, x fastest                */
+/*              int64    node numbers (from 1) of each element, in the  */
+/*                       same order as the AVS output                   */
+/*              int32    zone of each element                           */
+#define GRID_RAW_MAGIC  "GRIDRAW1"
+#define GRID_RAW_HEADER 64
+
+/* An OUTPUT_VTR file is a VTK XML RectilinearGrid with its arrays in   */
+/* raw little-endian appended data, each after a UInt64 byte count:     */
+/* the Float64 coordinates of each axis, the Int32 region (from 1) of   */
+/* each element along each axis used, as FieldData region_x, region_y   */
+/* and region_z, and with GRID_DATA_CELLS the Int32 zone of every cell. */
+/* The zone of a cell is region_x + nrx*(region_y-1 + nry*(region_z-1)) */
+/* for nrx and nry regions along x and y, so the region arrays hold it  */
+/* in nx+ny+nz numbers.                                                 */
+
+/* OUTPUT_VTU cuts the grid into num_pieces slabs of whole layers of    */
+/* elements along the last axis used and writes each as a VTK XML       */
+/* UnstructuredGrid file <piece_name>_<n>.vtu (n from 0), with raw      */
+/* little-endian appended data after UInt64 byte counts: Float64 x y z */
+/* of the points, Int64 connectivity (from 0 in the piece), Int64       */
+/* offsets, UInt8 cell types and the Int32 zone of each cell as cell   */
+/* data.  The nodes between two slabs are in both pieces.  The grid    */
+/* file is the .pvtu that lists the pieces by their names without the  */
+/* directory, so it goes in the same directory as them.                 */
+
+/* With spec.blocks the grid is cut into Px*Py*Pz blocks, numbered x   */
+/* fastest.  Block (p, q, r) owns the elements n*p/Px ... n*(p+1)/Px-1  */
+/* of the n along x, and so on along y and z, and is written with       */
+/* spec.ghost more layers of elements on each side, as far as the grid  */
+/* goes.  Each block is a grid file <piece_name>_<n><ext> in the output */
+/* format, ext from gridder_extension(), not compressed, with nodes and */
+/* elements numbered from 1 in the block and the zones of the whole     */
+/* grid, and a map <piece_name>_<n>.map from them to the whole grid:    */
+/*									*/
+/*   offset  0  char[8]  "GRIDMAP1"                                     */
+/*           8  int64    number of nodes of the block                   */
+/*          16  int64    number of elements of the block                */
+/*          24  int32    block number                                   */
+/*          28  int32    number of blocks                               */
+/*          32  int32[3] first node of the block along x, y, z (from 0) */
+/*          44  int32[3] nodes of the block along x, y, z               */
+/*          56  int32    ghost layers                                   */
+/*          60  int32    0                                              */
+/*          64  int64    node number (from 1) in the whole grid of each */
+/*                       node of the block                              */
+/*              int64    element number (from 1) of each element        */
+/*              int32    block owning each node                         */
+/*              int32    block owning each element                      */
+/*									*/
+/* A node is owned with the element it is the first node of, the last   */
+/* node of an axis with the last element; those of other blocks are    */
+/* ghosts.  The grid file lists the blocks as text.  OUTPUT_VTU keeps   */
+/* its own pieces and ignores spec.blocks.                              */
+#define GRID_MAP_MAGIC  "GRIDMAP1"
+#define GRID_MAP_HEADER 64
+
+/* The batched spacing kernels put every node within this many units */
+/* in the last place of the one-libm-call-per-node formulas.         */
+#define GRID_VEC_ULP 8
+
+/* Axis index into grid_spec.axis[] and grid.num_nodes[]. */
+#define AXIS_X 0
+#define AXIS_Y 1
+#define AXIS_Z 2
+
+/* Return values of the engine functions. */
+#define GRID_OK                   0
+#define GRID_ERR_DIMENSION       -1	/* dimension option not 1-7        */
+#define GRID_ERR_REGIONS         -2	/* axis has no regions or too many */
+#define GRID_ERR_BOUNDS          -3	/* END not greater than BEGIN      */
+#define GRID_ERR_DIVISIONS       -4	/* bad number of divisions or dx   */
+#define GRID_ERR_SPACING         -5	/* spacing option not 1-4          */
+#define GRID_ERR_GEOM_FACTOR     -6	/* geometric factor not positive   */
+#define GRID_ERR_TOO_MANY_NODES  -7	/* more than MAXNODES in an axis   */
+#define GRID_ERR_TOO_MANY_ZONES  -8	/* more than MAXZONES in the grid  */
+#define GRID_ERR_OUTPUT          -9	/* output option not 1-8           */
+#define GRID_ERR_IO             -10	/* error writing the grid file     */
+#define GRID_ERR_MEMORY         -11	/* out of memory                   */
+#define GRID_ERR_TOO_LARGE      -12	/* ids too big for output format   */
+#define GRID_ERR_COMPRESS       -13	/* built without zlib              */
+#define GRID_ERR_INPUT          -14	/* grid description cut short      */
+
+/* One region of an axis.  The region begins where the previous region */
+/* ended (or at grid_axis_spec.begin for the first region).            */
+struct grid_region {
+	double end;		/* END coordinate of the region.        */
+	int num_divisions;	/* Number of divisions, 0 to use dx.    */
+	double dx;		/* Smallest dx if num_divisions is 0.   */
+	int spacing;		/* SPACING_EQUAL ... SPACING_LOG_LARGE. */
+	double geom_factor;	/* Growth factor for SPACING_GEOMETRIC. */
+};
+
+/* region[] is allocated by gridder_spec_regions(). */
+struct grid_axis_spec {
+	int num_regions;
+	double begin;		/* BEGIN coordinate of region 1.  */
+	struct grid_region *region;
+	int max_regions;	/* Entries allocated in region[]. */
+};
+
+struct grid_stats;
+
+struct grid_spec {
+	int num_dimensions;	/* 1-7, see dimension menu.           */
+	struct grid_axis_spec axis[3];	/* x, y, z; unused axes ignored. */
+	int output;		/* OUTPUT_AVS ... OUTPUT_LAST.        */
+	int num_threads;	/* Threads used to write the grid.    */
+	struct grid_stats *stats;	/* Phase timing, NULL for none. */
+	int compress;		/* gzip level 1-9, 0 for none.        */
+	const char *cache;	/* Cache directory, NULL for none.    */
+	int map;		/* Fill the file through mmap(); it   */
+				/* must be opened "w+".               */
+	int data;		/* GRID_DATA_ flags, AVS and VTR.     */
+	int num_pieces;		/* OUTPUT_VTU slabs, 0 for one a      */
+				/* thread.                            */
+	const char *piece_name;	/* OUTPUT_VTU pieces are written to   */
+				/* piece_name_<n>.vtu, grid_<n>.vtu   */
+				/* if NULL, and blocks to             */
+				/* piece_name_<n>.<ext> and .map.     */
+	int blocks[3];		/* Blocks along x, y and z, 0 or 1    */
+				/* each for one grid file; see        */
+				/* GRID_MAP_MAGIC.                    */
+	int ghost;		/* Layers of ghost elements around    */
+				/* each block.                        */
+	int zones;		/* GRID_ZONES_ flags, FEHM.           */
+	int stor;		/* Nonzero for <piece_name>.stor,     */
+				/* FEHM; see GRID_STOR_FORMAT.        */
+};
+
+/* Node and cell data written after the connectivity (spec.data).     */
+/* Regions are numbered from 1 along each axis used, in the order of  */
+/* gridder_axes().  A node on the boundary of two regions is in the   */
+/* one that starts there, the last node of an axis in the last one.   */
+#define GRID_DATA_NODES 1	/* region along each axis of a node    */
+#define GRID_DATA_CELLS 2	/* zone and regions of an element      */
+
+/* FEHM zone files written next to the grid file (spec.zones), as     */
+/* <piece_name>_outside.zone and <piece_name>_material.zone.  Each     */
+/* zone is "nnum", the number of nodes and the nodes, 10 a line.  The  */
+/* outside file is a zonn macro of the faces of the grid, numbered as  */
+/* LaGriT does: 1 top (z max), 2 bottom (z min), 3 left_w (x min),     */
+/* 4 front_n (y max), 5 right_e (x max), 6 back_s (y min); faces       */
+/* across an unused axis are left out.  The material file is a zone   */
+/* macro with the nodes of every zone of the grid, a node on the       */
+/* boundary of two regions in the one that starts there.  The files of */
+/* a block keep the faces of the whole grid and the zones with nodes  */
+/* in the block, in the node numbers of the block.                     */
+#define GRID_ZONES_OUTSIDE  1	/* faces of the grid, zonn             */
+#define GRID_ZONES_MATERIAL 2	/* nodes of each zone, zone            */
+
+/* FEHM sparse matrix file written next to the grid file (spec.stor),  */
+/* as <piece_name>.stor with the title lines LaGriT writes,            */
+/* "fehmstor ascir8i4 LaGriT Sparse Matrix Voronoi Coefficients" and   */
+/* the date followed by "3-D Linear Diffusion Model (matbld3d_astor)"  */
+/* (the dimensions of the grid), then the number of entries, of nodes */
+/* and of row pointers plus columns, 1 area coefficient a link and the */
+/* most entries in a row, as %10d.                                      */
+/* The arrays follow, each from a new line, 5 values a line: the      */
+/* volume of each node (%20.12E), the neq+1 row pointers followed by  */
+/* the column of each entry, the coefficient of each entry, neq+1      */
+/* zeros and the position of each diagonal entry (%10d, from 1), and   */
+/* the coefficient -area/distance of each entry, 0 on the diagonal     */
+/* (%20.12E).  The matrix is that of the 7-point stencil: a row holds  */
+/* the neighbors along z, y and x below the node, the node and those   */
+/* above it.  A node's volume is the product of its half spacings and */
+/* a face's area that along the other axes, 1 along an unused axis.   */
+/* A block keeps the volumes of its nodes in the whole grid and the    */
+/* links inside it.                                                     */
+#define GRID_STOR_FORMAT "fehmstor ascir8i4"
+
+/* Result of gridder_coords().  Unused axes have one node at 0.0.  */
+/* The arrays grow as needed; set up a grid with gridder_grid_init() */
+/* and release it with gridder_grid_free().                          */
+struct grid {
+	int num_nodes[3];		/* Nodes in each axis.            */
+	int num_regions[3];		/* Regions in each axis.          */
+	int *num_elems_per_region[3];	/* Divisions per region.          */
+	int *region_start[3];		/* First element of each region,  */
+					/* num_regions+1 entries.         */
+	long long num_elems;		/* Elements in the grid.          */
+	double *coords[3];		/* Node coordinates.              */
+	int max_nodes[3];		/* Entries allocated in coords[]. */
+	int max_regions[3];		/* And in num_elems_per_region[]. */
+};
+
+/* Names of the axes used by a dimension option, e.g. "xz" for 6. */
+const char *gridder_axes(int num_dimensions);
+
+/* File name extension of an output format, e.g. ".vtr" for         */
+/* OUTPUT_VTR: .inp for AVS and AVS binary, .dat for Tracer3d and   */
+/* Vectors, .fehm, .raw, .vtr and .vtu.                              */
+const char *gridder_extension(int output);
+
+void gridder_spec_init(struct grid_spec *spec);
+int gridder_spec_regions(struct grid_spec *spec, int axis, int num_regions);
+void gridder_spec_free(struct grid_spec *spec);
+int gridder_check_spec(const struct grid_spec *spec);
+int gridder_spec_size(const struct grid_spec *spec, long long *num_nodes,
+		long long *num_elems);
+int gridder_read_spec(struct grid_spec *spec, FILE *fp);
+
+int gridder_grid_init(struct grid *grid);
+void gridder_grid_free(struct grid *grid);
+int gridder_region_divisions(const struct grid_region *region, double begin);
+int gridder_region_coords(const struct grid_region *region, double begin,
+		double *x, int max_divisions);
+int gridder_axis_coords(struct grid *grid, const struct grid_spec *spec,
+		int axis);
+int gridder_coords(struct grid *grid, const struct grid_spec *spec);
+int gridder_write(const struct grid *grid, const struct grid_spec *spec,
+		FILE *fp_out);
+int gridder_build(const struct grid_spec *spec, FILE *fp_out);
+
+/* Zones are numbered from 1, x region fastest, then y, then z, for  */
+/* every dimension option.  gridder_zone() is the zone of the element */
+/* starting at node (i, j, k) (from 0); gridder_zone_bounds() gives   */
+/* the first and last node along each axis of a zone.  Both look the  */
+/* regions up in grid.region_start[], so they can be called in any    */
+/* order and from any thread.                                         */
+int gridder_zone(const struct grid *grid, int i, int j, int k);
+int gridder_zone_bounds(const struct grid *grid, int zone, int first[3],
+		int last[3]);
+long long gridder_zone_elems(const struct grid *grid, int zone);
+
+/* What gridder_dry_run() works out about a grid without writing it. */
+struct grid_size {
+	long long num_nodes, num_elems, num_zones;
+	long long bytes[OUTPUT_LAST + 1];
+		/* File size of each output format, by OUTPUT_ number,  */
+		/* or -1 if its ids cannot hold the grid (AVS binary,    */
+		/* the .stor of spec.stor) or the size passes 64 bits.   */
+};
+
+int gridder_dry_run(struct grid *grid, const struct grid_spec *spec,
+		struct grid_size *size);
+
+/* Receives a grid from gridder_visit() a block at a time.  The arrays  */
+/* are only valid during the call.  Either function may be NULL; a      */
+/* nonzero return stops the walk and is returned by gridder_visit().   */
+struct grid_visitor {
+	void *arg;		/* Passed to the functions.           */
+	long long block;	/* Records per block, 0 for default.  */
+
+	/* Nodes first ... first+count-1 (from 0), x fastest:   */
+	/* xyz holds x, y, z of each node.                       */
+	int (*nodes)(void *arg, long long first, long long count,
+		const double *xyz);
+
+	/* Elements first ... first+count-1 (from 0): node      */
+	/* numbers (from 1) of each element, nodes_per_elem of   */
+	/* them in the AVS order, and the zone of each element.  */
+	int (*elems)(void *arg, long long first, long long count,
+		int nodes_per_elem, const long long *nodes, const int *zones);
+};
+
+/* Default records per block handed to a grid_visitor. */
+#define GRID_VISIT_BLOCK 65536
+
+int gridder_visit(const struct grid *grid, const struct grid_spec *spec,
+		const struct grid_visitor *visitor);
+
+const char *gridder_error_string(int error);
+
+/* One grid of a gridder_batch().  Fill in spec and path; the rest is */
+/* set by gridder_batch().                                            */
+struct grid_batch_job {
+	struct grid_spec spec;
+	const char *path;	/* File the grid is written to.   */
+	int error;		/* GRID_OK or why it failed.      */
+	long long num_nodes, num_elems;
+	long long bytes;	/* Size of the file.              */
+	double seconds;		/* Time to write it.              */
+};
+
+int gridder_batch(struct grid_batch_job *job, int num_jobs, int num_threads);
+
+/* Phases of building a grid, timed by a grid_stats. */
+#define GRID_PHASE_COORDS 0	/* coordinates of the axes     */
+#define GRID_PHASE_NODES  1	/* node output, with headers   */
+#define GRID_PHASE_ZONES  2	/* zone bounds listing         */
+#define GRID_PHASE_ELEMS  3	/* connectivity                */
+#define GRID_NUM_PHASES   4
+
+/* Time, CPU time (all threads), bytes and records of each phase,  */
+/* added up over every grid built with spec.stats pointing to it.  */
+/* Set up with gridder_stats_init().  If progress is not NULL a     */
+/* line with the records done, throughput and ETA is printed to it  */
+/* every progress_interval seconds while a section is written.      */
+struct grid_stats {
+	double wall[GRID_NUM_PHASES];	/* Seconds.                  */
+	double cpu[GRID_NUM_PHASES];	/* CPU seconds.              */
+	long long bytes[GRID_NUM_PHASES];
+	long long records[GRID_NUM_PHASES];
+	long peak_rss_kb;		/* Peak resident set size.   */
+	FILE *progress;
+	double progress_interval;
+
+	/* Used by gridder_stats_begin(), _end() and the writers. */
+	double wall_start[GRID_NUM_PHASES], cpu_start[GRID_NUM_PHASES];
+	double last_progress;
+};
+
+void gridder_stats_init(struct grid_stats *stats);
+void gridder_stats_begin(struct grid_stats *stats, int phase);
+void gridder_stats_end(struct grid_stats *stats, int phase);
+void gridder_stats_print(const struct grid_stats *stats, FILE *fp);
+int gridder_stats_json(const struct grid_stats *stats, FILE *fp);
+
+#endif /* GRIDDER_H */